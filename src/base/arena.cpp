@@ -0,0 +1,43 @@
+#include "arena.hpp"
+#include <cstring>
+
+namespace blvm {
+namespace base {
+
+    Arena::Arena(size_t chunk_size) :
+            cursor_(nullptr), limit_(nullptr), chunk_size_(chunk_size), reserved_size_(0) {}
+
+    Arena::~Arena() {
+        for (char* chunk : chunks_)
+            delete[] chunk;
+    }
+
+    void* Arena::AllocateSlow(size_t size, size_t alignment) {
+        // oversized requests get a chunk of their own, the current chunk stays open for small ones
+        size_t needed = size + alignment - 1;
+        if (needed > chunk_size_ / 4) {
+            char* chunk = new char[needed];
+            chunks_.push_back(chunk);
+            reserved_size_ += needed;
+            uintptr_t aligned = (reinterpret_cast<uintptr_t>(chunk) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        char* chunk = new char[chunk_size_];
+        chunks_.push_back(chunk);
+        reserved_size_ += chunk_size_;
+        cursor_ = chunk;
+        limit_ = chunk + chunk_size_;
+        return Allocate(size, alignment);
+    }
+
+    const char* Arena::CopyString(const char* data, size_t length) {
+        char* copy = NewArray<char>(length + 1);
+        if (length != 0)
+            memcpy(copy, data, length);
+        copy[length] = '\0';
+        return copy;
+    }
+
+}
+}
@@ -0,0 +1,68 @@
+#ifndef _BLVM_BASE_ARENA_HPP
+#define _BLVM_BASE_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "noncopyable.hpp"
+
+namespace blvm {
+namespace base {
+
+    // Bump-pointer allocator. Memory is released all at once when the arena dies and destructors are
+    // never run, so only trivially destructible objects may be placed in it.
+    class Arena {
+    public:
+        explicit Arena(size_t chunk_size = 64 * 1024);
+        ~Arena();
+
+        void* Allocate(size_t size, size_t alignment) {
+            uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            if (aligned + size > reinterpret_cast<uintptr_t>(limit_))
+                return AllocateSlow(size, alignment);
+
+            cursor_ = reinterpret_cast<char*>(aligned + size);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        template <typename T, typename... Args>
+        T* New(Args&&... args) {
+            static_assert(std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+            return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Uninitialized storage for count elements.
+        template <typename T>
+        T* NewArray(size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+            if (count == 0)
+                return nullptr;
+            return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        // Copy of [data, data + length) followed by a '\0'.
+        const char* CopyString(const char* data, size_t length);
+
+        // Bytes reserved from the system so far, including unused chunk tails.
+        size_t GetReservedSize() const {
+            return reserved_size_;
+        }
+    private:
+        void* AllocateSlow(size_t size, size_t alignment);
+    private:
+        char* cursor_;
+        char* limit_;
+        size_t chunk_size_;
+        size_t reserved_size_;
+        std::vector<char*> chunks_;
+
+        DISALLOW_COPY_AND_ASSIGN(Arena);
+    };
+
+}
+}
+
+#endif // _BLVM_BASE_ARENA_HPP
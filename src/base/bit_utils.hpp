@@ -0,0 +1,49 @@
+#ifndef _BLVM_BASE_BIT_UTILS_HPP
+#define _BLVM_BASE_BIT_UTILS_HPP
+
+#include <cstdint>
+
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+    #include <immintrin.h>
+    #define BLVM_HAS_PEXT 1
+#else
+    #define BLVM_HAS_PEXT 0
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+namespace blvm {
+namespace base {
+
+    // Undefined for value == 0.
+    inline uint32_t CountTrailingZeros64(uint64_t value) {
+#if defined(__GNUC__)
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+#elif defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        uint32_t count = 0;
+        while ((value & 1) == 0) {
+            value >>= 1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+#if BLVM_HAS_PEXT
+    // Gather the bits of value selected by mask into the low bits of the result.
+    // Only available when the target has BMI2, callers provide their own fallback.
+    inline uint64_t ParallelBitExtract64(uint64_t value, uint64_t mask) {
+        return _pext_u64(value, mask);
+    }
+#endif
+
+}
+}
+
+#endif // _BLVM_BASE_BIT_UTILS_HPP
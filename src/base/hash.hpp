@@ -0,0 +1,65 @@
+#ifndef _BLVM_BASE_HASH_HPP
+#define _BLVM_BASE_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace blvm {
+namespace base {
+
+    // 64-bit finalizer from MurmurHash3, spreads every input bit over the whole result.
+    inline uint64_t HashMix64(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    inline uint64_t HashCombine(uint64_t seed, uint64_t value) {
+        return HashMix64(seed ^ (value + 0x9E3779B97F4A7C15ULL + (seed << 6) + (seed >> 2)));
+    }
+
+    inline uint64_t HashPointer(const void* pointer) {
+        return HashMix64(reinterpret_cast<uintptr_t>(pointer));
+    }
+
+    // Content hash of a byte range. Four independent multiply-rotate lanes over 32-byte stripes (the xxHash64
+    // round) keep it near memory speed for whole files. Not a cryptographic hash, compare contents on a match.
+    inline uint64_t HashBytes(const void* data, size_t size) {
+        static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+        static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+        auto round = [](uint64_t lane, uint64_t word) {
+            lane += word * kPrime2;
+            return ((lane << 31) | (lane >> 33)) * kPrime1;
+        };
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t lanes[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+        size_t i = 0;
+        for (; i + 4 * sizeof(uint64_t) <= size; i += 4 * sizeof(uint64_t)) {
+            uint64_t words[4];
+            memcpy(words, bytes + i, sizeof(words));
+            for (int lane = 0; lane < 4; lane++)
+                lanes[lane] = round(lanes[lane], words[lane]);
+        }
+
+        uint64_t hash = HashMix64(size);
+        for (int lane = 0; lane < 4; lane++)
+            hash = HashCombine(hash, lanes[lane]);
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            hash = HashCombine(hash, word);
+        }
+        uint64_t tail = 0;
+        memcpy(&tail, bytes + i, size - i);
+        return HashCombine(hash, tail);
+    }
+
+}
+}
+
+#endif // _BLVM_BASE_HASH_HPP
@@ -2,19 +2,28 @@
 #include <cassert>
 #include <cstring>
 
+#ifdef _WIN32
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
 namespace blvm {
 namespace base {
 
     MemoryBuffer::MemoryBuffer(int allocate_method, uint8_t* existing_address, size_t size) :
             begin_(existing_address), end_(existing_address + size) {
         assert(allocate_method == kAllocatedMemory);
-        allocate_internal_ = false;
+        allocate_method_ = kAllocatedMemory;
     }
 
     MemoryBuffer::MemoryBuffer(int allocate_method, uint8_t* begin, uint8_t* end) :
             begin_(begin), end_(end) {
         assert(allocate_method == kAllocatedMemory);
-        allocate_internal_ = false;
+        allocate_method_ = kAllocatedMemory;
     }
 
     MemoryBuffer::MemoryBuffer(int allocate_method, size_t allocate_size) {
@@ -23,17 +32,128 @@ namespace base {
         begin_ = new uint8_t[allocate_size];
         memset(begin_, 0, allocate_size);
         end_ = begin_ + allocate_size;
-        allocate_internal_ = true;
+        allocate_method_ = kAllocateInternally;
     }
 
     MemoryBuffer::~MemoryBuffer() {
-        if (allocate_internal_) {
+        Release();
+    }
+
+    void MemoryBuffer::Release() {
+        if (allocate_method_ == kAllocateInternally) {
             delete [] begin_;
-            begin_ = end_ = nullptr;
-            allocate_internal_ = false;
+        } else if (allocate_method_ == kMappedFile && begin_) {
+#ifdef _WIN32
+            UnmapViewOfFile(begin_);
+#else
+            munmap(begin_, size());
+#endif
+        }
+        begin_ = end_ = nullptr;
+        allocate_method_ = kAllocatedMemory;
+    }
+
+#ifdef _WIN32
+
+    MemoryBuffer MemoryBuffer::OpenFile(const char* filename) {
+        MemoryBuffer buffer;
+
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return buffer;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) {
+            CloseHandle(file);
+            return buffer;
+        }
+        size_t size = static_cast<size_t>(file_size.QuadPart);
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (address) {
+                CloseHandle(file);
+                buffer.begin_ = static_cast<uint8_t*>(address);
+                buffer.end_ = buffer.begin_ + size;
+                buffer.allocate_method_ = kMappedFile;
+                return buffer;
+            }
+        }
+
+        // Mapping failed, read the content instead. Skip the zero-filling, it would be overwritten anyway.
+        uint8_t* data = new uint8_t[size];
+        size_t offset = 0;
+        while (offset < size) {
+            DWORD chunk = (size - offset) > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size - offset);
+            DWORD bytes_read = 0;
+            if (!ReadFile(file, data + offset, chunk, &bytes_read, nullptr) || bytes_read == 0)
+                break;
+            offset += bytes_read;
+        }
+        CloseHandle(file);
+
+        if (offset != size) {
+            delete [] data;
+            return buffer;
         }
+        buffer.begin_ = data;
+        buffer.end_ = data + size;
+        buffer.allocate_method_ = kAllocateInternally;
+        return buffer;
     }
 
+#else
+
+    MemoryBuffer MemoryBuffer::OpenFile(const char* filename) {
+        MemoryBuffer buffer;
+
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0)
+            return buffer;
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+            close(fd);
+            return buffer;
+        }
+        size_t size = static_cast<size_t>(file_stat.st_size);
+
+        void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            close(fd);
+            madvise(address, size, MADV_SEQUENTIAL);
+            buffer.begin_ = static_cast<uint8_t*>(address);
+            buffer.end_ = buffer.begin_ + size;
+            buffer.allocate_method_ = kMappedFile;
+            return buffer;
+        }
+
+        // Mapping failed, read the content instead. Skip the zero-filling, it would be overwritten anyway.
+        uint8_t* data = new uint8_t[size];
+        size_t offset = 0;
+        while (offset < size) {
+            ssize_t bytes_read = read(fd, data + offset, size - offset);
+            if (bytes_read <= 0)
+                break;
+            offset += static_cast<size_t>(bytes_read);
+        }
+        close(fd);
+
+        if (offset != size) {
+            delete [] data;
+            return buffer;
+        }
+        buffer.begin_ = data;
+        buffer.end_ = data + size;
+        buffer.allocate_method_ = kAllocateInternally;
+        return buffer;
+    }
+
+#endif
+
     size_t MemoryBuffer::ReadBytes(uint8_t* dest, size_t begin_offset, size_t length) const {
         uint8_t* src_begin = begin_ + begin_offset;
         uint8_t* expect_end = src_begin + length;
@@ -57,4 +177,4 @@ namespace base {
     }
 
 }
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #ifndef _BLVM_BASE_MEMORY_BUFFER_HPP
 #define _BLVM_BASE_MEMORY_BUFFER_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 #include "noncopyable.hpp"
@@ -12,28 +13,41 @@ namespace base {
     public:
         enum : int {
             kAllocatedMemory = 0,
-            kAllocateInternally = 1
+            kAllocateInternally = 1,
+            kMappedFile = 2
         };
     public:
         MemoryBuffer(int allocate_method, uint8_t* existing_address, size_t size);
         MemoryBuffer(int allocate_method, uint8_t* begin, uint8_t* end);
         MemoryBuffer(int allocate_method, size_t allocate_size);
-        MemoryBuffer(MemoryBuffer&& rhs) {
+        MemoryBuffer(MemoryBuffer&& rhs) : begin_(nullptr), end_(nullptr), allocate_method_(kAllocatedMemory) {
             operator=(std::move(rhs));
         }
         ~MemoryBuffer();
 
         MemoryBuffer& operator=(MemoryBuffer&& rhs) {
-            begin_ = rhs.begin_; rhs.begin_ = nullptr;
-            end_ = rhs.end_; rhs.end_ = nullptr;
-            allocate_internal_ = rhs.allocate_internal_; rhs.allocate_internal_ = false;
+            if (this != &rhs) {
+                Release();
+                begin_ = rhs.begin_; rhs.begin_ = nullptr;
+                end_ = rhs.end_; rhs.end_ = nullptr;
+                allocate_method_ = rhs.allocate_method_; rhs.allocate_method_ = kAllocatedMemory;
+            }
             return *this;
         }
 
+        // Map the whole file read-only (kMappedFile), hinted for sequential access.
+        // Falls back to reading into an internal allocation if the file cannot be mapped.
+        // Returns an invalid (empty) buffer on failure, check it with IsValid().
+        static MemoryBuffer OpenFile(const char* filename);
+
         size_t ReadBytes(uint8_t* dest, size_t begin_offset, size_t length) const;
 
         const uint8_t* GetAddressAt(size_t offset) const;
 
+        bool IsValid() const {
+            return begin_ != nullptr;
+        }
+
         const uint8_t* begin() const {
             return begin_;
         }
@@ -45,10 +59,13 @@ namespace base {
         size_t size() const {
             return static_cast<size_t>(end_ - begin_);
         }
+    private:
+        MemoryBuffer() : begin_(nullptr), end_(nullptr), allocate_method_(kAllocatedMemory) {}
+        void Release();
     private:
         uint8_t* begin_;
         uint8_t* end_;
-        bool allocate_internal_;
+        int allocate_method_;
 
         DISALLOW_COPY_AND_ASSIGN(MemoryBuffer);
     };
@@ -0,0 +1,164 @@
+#include "stream_input.hpp"
+#include <algorithm>
+#include <utility>
+#include "error_handling.hpp"
+
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace blvm {
+namespace base {
+
+    namespace {
+
+        // Bytes read, 0 at the end of the stream, -1 on error.
+        long ReadFromFd(int fd, uint8_t* dest, size_t size) {
+#ifdef _WIN32
+            return _read(fd, dest, (unsigned int)std::min<size_t>(size, 0x40000000));
+#else
+            while (true) {
+                ssize_t bytes_read = read(fd, dest, size);
+                if (bytes_read >= 0 || errno != EINTR)
+                    return (long)bytes_read;
+            }
+#endif
+        }
+
+        void CloseFd(int fd) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+
+    }
+
+    StreamInput::StreamInput(int fd, bool owns_fd, size_t chunk_size, size_t max_queued_chunks) :
+            fd_(fd), owns_fd_(owns_fd), chunk_size_(chunk_size), max_queued_chunks_(max_queued_chunks),
+            window_begin_(0), next_offset_(0), is_complete_(false), peak_window_size_(0), queued_bytes_(0),
+            peak_queued_bytes_(0), producer_done_(false), has_error_(false), stopping_(false) {
+        producer_ = std::thread(&StreamInput::ProducerMain, this);
+    }
+
+    StreamInput::~StreamInput() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        space_ready_.notify_all();
+        producer_.join();
+        if (owns_fd_)
+            CloseFd(fd_);
+    }
+
+    std::unique_ptr<StreamInput> StreamInput::OpenFile(const char* filename) {
+#ifdef _WIN32
+        int fd = _open(filename, _O_RDONLY | _O_BINARY);
+#else
+        int fd = open(filename, O_RDONLY);
+#endif
+        if (fd < 0)
+            return nullptr;
+        return std::unique_ptr<StreamInput>(new StreamInput(fd, true));
+    }
+
+    bool StreamInput::Load(uint64_t begin, uint64_t end) {
+        DCHECK(begin >= window_begin_);
+
+        if (begin > window_begin_) {
+            uint64_t drop = std::min(begin, GetWindowEnd()) - window_begin_;
+            window_.erase(window_.begin(), window_.begin() + (size_t)drop);
+            window_begin_ = window_.empty() ? begin : window_begin_ + drop;
+            // give back what an oversized request (a big blob) left behind
+            if (window_.capacity() > chunk_size_ * 4 && window_.size() < window_.capacity() / 4)
+                window_.shrink_to_fit();
+        }
+
+        // A non-empty window always ends at next_offset_. An empty one may start past it, after a forward
+        // skip: the chunks up to window_begin_ are dropped without being copied.
+        while (GetWindowEnd() < end) {
+            if (is_complete_)
+                return false;
+
+            std::vector<uint8_t> chunk = PopChunk();
+            if (chunk.empty()) {
+                is_complete_ = true;
+                if (window_.empty())
+                    window_begin_ = std::min(window_begin_, next_offset_);
+                return false;
+            }
+
+            uint64_t chunk_begin = next_offset_;
+            next_offset_ += chunk.size();
+            if (next_offset_ <= window_begin_)
+                continue;
+
+            size_t skip = window_begin_ > chunk_begin ? (size_t)(window_begin_ - chunk_begin) : 0;
+            window_.insert(window_.end(), chunk.begin() + skip, chunk.end());
+            peak_window_size_ = std::max(peak_window_size_, window_.capacity());
+        }
+        return true;
+    }
+
+    bool StreamInput::HasError() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return has_error_;
+    }
+
+    size_t StreamInput::GetPeakResidentSize() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return peak_window_size_ + peak_queued_bytes_;
+    }
+
+    std::vector<uint8_t> StreamInput::PopChunk() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        chunk_ready_.wait(lock, [this] { return !chunks_.empty() || producer_done_; });
+        if (chunks_.empty())
+            return std::vector<uint8_t>();
+
+        std::vector<uint8_t> chunk = std::move(chunks_.front());
+        chunks_.pop_front();
+        queued_bytes_ -= chunk.capacity();
+        space_ready_.notify_one();
+        return chunk;
+    }
+
+    void StreamInput::ProducerMain() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                space_ready_.wait(lock, [this] { return stopping_ || chunks_.size() < max_queued_chunks_; });
+                if (stopping_)
+                    break;
+            }
+
+            // Handed over after every read(), so that the consumer starts on the first bytes that arrive.
+            std::vector<uint8_t> chunk(chunk_size_);
+            long bytes_read = ReadFromFd(fd_, chunk.data(), chunk.size());
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (bytes_read <= 0) {
+                has_error_ = bytes_read < 0;
+                break;
+            }
+            chunk.resize((size_t)bytes_read);
+            queued_bytes_ += chunk.capacity();
+            peak_queued_bytes_ = std::max(peak_queued_bytes_, queued_bytes_);
+            chunks_.push_back(std::move(chunk));
+            chunk_ready_.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        producer_done_ = true;
+        chunk_ready_.notify_all();
+    }
+
+}
+}
@@ -0,0 +1,98 @@
+#ifndef _BLVM_BASE_STREAM_INPUT_HPP
+#define _BLVM_BASE_STREAM_INPUT_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "noncopyable.hpp"
+
+namespace blvm {
+namespace base {
+
+    // Sequential input from a file descriptor that cannot be mapped or seeked (a pipe, a socket).
+    // A producer thread reads ahead into a bounded queue of chunks while the consumer works, and the consumer
+    // sees one contiguous window that only slides forward: bytes before it are released. Memory stays at
+    // the queue bound plus whatever the consumer asks to keep in the window.
+    class StreamInput {
+    public:
+        static const size_t kDefaultChunkSize = 256 * 1024;
+        static const size_t kDefaultMaxQueuedChunks = 8;
+
+        StreamInput(int fd, bool owns_fd, size_t chunk_size = kDefaultChunkSize,
+                    size_t max_queued_chunks = kDefaultMaxQueuedChunks);
+        // Stops the producer. It finishes the read() it may be blocked in first, so the writer has to make
+        // progress or close its end.
+        ~StreamInput();
+
+        // nullptr if the file cannot be opened.
+        static std::unique_ptr<StreamInput> OpenFile(const char* filename);
+
+        // Makes [begin, end) of the stream resident in the window, waiting for the producer as needed.
+        // Everything before begin is released, begin must not be before the current window. Returns false if
+        // the stream ends (or fails) first, the window then reaches to the end of the stream.
+        bool Load(uint64_t begin, uint64_t end);
+
+        const uint8_t* GetWindowData() const {
+            return window_.data();
+        }
+
+        // Stream offset of GetWindowData()[0].
+        uint64_t GetWindowBegin() const {
+            return window_begin_;
+        }
+
+        uint64_t GetWindowEnd() const {
+            return window_begin_ + window_.size();
+        }
+
+        // True once the last byte of the stream has been moved into the window, GetWindowEnd() is the size then.
+        bool IsComplete() const {
+            return is_complete_;
+        }
+
+        bool HasError() const;
+
+        // Upper bound of the memory held at any time: the high-water marks of the window and of the queue.
+        size_t GetPeakResidentSize() const;
+    private:
+        void ProducerMain();
+        // Waits for the next chunk, an empty one at the end of the stream.
+        std::vector<uint8_t> PopChunk();
+    private:
+        int fd_;
+        bool owns_fd_;
+        size_t chunk_size_;
+        size_t max_queued_chunks_;
+
+        // consumer side
+        std::vector<uint8_t> window_;
+        uint64_t window_begin_;
+        uint64_t next_offset_;  // stream offset of the next queued byte
+        bool is_complete_;
+        size_t peak_window_size_;
+
+        // shared with the producer
+        mutable std::mutex mutex_;
+        std::condition_variable chunk_ready_;
+        std::condition_variable space_ready_;
+        std::deque<std::vector<uint8_t>> chunks_;
+        size_t queued_bytes_;
+        size_t peak_queued_bytes_;
+        bool producer_done_;
+        bool has_error_;
+        bool stopping_;
+
+        std::thread producer_;
+
+        DISALLOW_COPY_AND_ASSIGN(StreamInput);
+    };
+
+}
+}
+
+#endif // _BLVM_BASE_STREAM_INPUT_HPP
@@ -0,0 +1,58 @@
+#include "string_interner.hpp"
+#include <cstddef>
+#include <cstring>
+#include "hash.hpp"
+
+namespace blvm {
+namespace base {
+
+    namespace {
+
+        const size_t kInitialSlotCount = 64;
+
+    }
+
+    StringInterner::StringInterner() : arena_(16 * 1024), slots_(kInitialSlotCount, nullptr), count_(0) {}
+
+    InternedString StringInterner::Intern(StringPiece str) {
+        if (str.empty())
+            return InternedString();
+
+        uint64_t hash = HashBytes(str.data(), str.size());
+        size_t mask = slots_.size() - 1;
+        size_t index = (size_t)hash & mask;
+        for (; slots_[index] != nullptr; index = (index + 1) & mask) {
+            const Entry* entry = slots_[index];
+            if (entry->hash == hash && entry->size == str.size() && memcmp(entry->data, str.data(), str.size()) == 0)
+                return InternedString(entry);
+        }
+
+        Entry* entry = static_cast<Entry*>(arena_.Allocate(offsetof(Entry, data) + str.size() + 1, alignof(Entry)));
+        entry->hash = hash;
+        entry->size = str.size();
+        memcpy(entry->data, str.data(), str.size());
+        entry->data[str.size()] = '\0';
+
+        slots_[index] = entry;
+        // at most half full, probe sequences stay short
+        if (++count_ * 2 > slots_.size())
+            Grow();
+        return InternedString(entry);
+    }
+
+    void StringInterner::Grow() {
+        std::vector<const Entry*> slots(slots_.size() * 2, nullptr);
+        size_t mask = slots.size() - 1;
+        for (const Entry* entry : slots_) {
+            if (entry == nullptr)
+                continue;
+            size_t index = (size_t)entry->hash & mask;
+            while (slots[index] != nullptr)
+                index = (index + 1) & mask;
+            slots[index] = entry;
+        }
+        slots_.swap(slots);
+    }
+
+}
+}
@@ -0,0 +1,97 @@
+#ifndef _BLVM_BASE_STRING_INTERNER_HPP
+#define _BLVM_BASE_STRING_INTERNER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "noncopyable.hpp"
+#include "arena.hpp"
+#include "string_piece.hpp"
+
+namespace blvm {
+namespace base {
+
+    // Handle to a string owned by a StringInterner. Handles from the same interner are equal exactly when
+    // their contents are, so comparing them is a pointer compare. The default handle is the empty string.
+    class InternedString {
+    public:
+        InternedString() : entry_(nullptr) {}
+
+        const char* c_str() const {
+            return entry_ ? entry_->data : "";
+        }
+
+        size_t size() const {
+            return entry_ ? entry_->size : 0;
+        }
+
+        bool empty() const {
+            return entry_ == nullptr;
+        }
+
+        StringPiece ToStringPiece() const {
+            return StringPiece(c_str(), size());
+        }
+
+        std::string ToString() const {
+            return std::string(c_str(), size());
+        }
+
+        bool operator==(const InternedString& rhs) const {
+            return entry_ == rhs.entry_;
+        }
+
+        bool operator!=(const InternedString& rhs) const {
+            return entry_ != rhs.entry_;
+        }
+    private:
+        // Followed by the characters and a '\0' in the arena.
+        struct Entry {
+            uint64_t hash;
+            size_t size;
+            char data[1];
+        };
+
+        explicit InternedString(const Entry* entry) : entry_(entry) {}
+
+        const Entry* entry_;
+
+        friend class StringInterner;
+    };
+
+
+    // Uniques strings into an arena, the strings live as long as the interner. Open addressing over the
+    // arena entries, lookups take a StringPiece and copy nothing when the string is already there.
+    // Not thread safe.
+    class StringInterner {
+    public:
+        StringInterner();
+        ~StringInterner() = default;
+
+        InternedString Intern(StringPiece str);
+
+        size_t GetCount() const {
+            return count_;
+        }
+
+        // Bytes reserved by the arena, the table not included.
+        size_t GetArenaSize() const {
+            return arena_.GetReservedSize();
+        }
+    private:
+        typedef InternedString::Entry Entry;
+
+        void Grow();
+    private:
+        Arena arena_;
+        std::vector<const Entry*> slots_;  // power of two, nullptr for a free slot
+        size_t count_;
+
+        DISALLOW_COPY_AND_ASSIGN(StringInterner);
+    };
+
+}
+}
+
+#endif // _BLVM_BASE_STRING_INTERNER_HPP
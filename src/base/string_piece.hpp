@@ -0,0 +1,66 @@
+#ifndef _BLVM_BASE_STRING_PIECE_HPP
+#define _BLVM_BASE_STRING_PIECE_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace blvm {
+namespace base {
+
+    // A non-owning view of a character range, the owner has to outlive it. Not null-terminated.
+    class StringPiece {
+    public:
+        StringPiece() : data_(nullptr), size_(0) {}
+        StringPiece(const char* data, size_t size) : data_(data), size_(size) {}
+        StringPiece(const std::string& str) : data_(str.data()), size_(str.size()) {}
+
+        const char* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        const char* begin() const {
+            return data_;
+        }
+
+        const char* end() const {
+            return data_ + size_;
+        }
+
+        char operator[](size_t index) const {
+            return data_[index];
+        }
+
+        bool StartsWith(const char* prefix) const {
+            size_t length = strlen(prefix);
+            return size_ >= length && memcmp(data_, prefix, length) == 0;
+        }
+
+        std::string ToString() const {
+            return std::string(data_, size_);
+        }
+
+        bool operator==(const StringPiece& rhs) const {
+            return size_ == rhs.size_ && (size_ == 0 || memcmp(data_, rhs.data_, size_) == 0);
+        }
+
+        bool operator!=(const StringPiece& rhs) const {
+            return !operator==(rhs);
+        }
+    private:
+        const char* data_;
+        size_t size_;
+    };
+
+}
+}
+
+#endif // _BLVM_BASE_STRING_PIECE_HPP
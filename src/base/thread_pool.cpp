@@ -0,0 +1,78 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace blvm {
+namespace base {
+
+    ThreadPool::ThreadPool(size_t thread_count) :
+            task_(nullptr), item_count_(0), next_item_(0), batch_size_(1), busy_workers_(0), generation_(0),
+            stopping_(false) {
+        if (thread_count == 0)
+            thread_count = GetDefaultThreadCount();
+
+        workers_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; i++)
+            workers_.push_back(std::thread(&ThreadPool::WorkerMain, this, i));
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_available_.notify_all();
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    size_t ThreadPool::GetDefaultThreadCount() {
+        size_t count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    void ThreadPool::ParallelFor(size_t item_count, const std::function<void(size_t, size_t)>& task) {
+        if (item_count == 0)
+            return;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_ = &task;
+        item_count_ = item_count;
+        next_item_ = 0;
+        // small batches keep the lock out of the per-item path but still balance uneven items
+        batch_size_ = std::max<size_t>(1, item_count / (workers_.size() * 16));
+        busy_workers_ = workers_.size();
+        generation_++;
+        work_available_.notify_all();
+
+        work_done_.wait(lock, [this] { return busy_workers_ == 0; });
+        task_ = nullptr;
+    }
+
+    void ThreadPool::WorkerMain(size_t worker_index) {
+        size_t seen_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (true) {
+            work_available_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_)
+                return;
+            seen_generation = generation_;
+
+            while (next_item_ < item_count_) {
+                size_t first = next_item_;
+                size_t last = std::min(item_count_, first + batch_size_);
+                next_item_ = last;
+                const std::function<void(size_t, size_t)>& task = *task_;
+                lock.unlock();
+                for (size_t item = first; item < last; item++)
+                    task(worker_index, item);
+                lock.lock();
+            }
+
+            if (--busy_workers_ == 0)
+                work_done_.notify_one();
+        }
+    }
+
+}
+}
@@ -0,0 +1,54 @@
+#ifndef _BLVM_BASE_THREAD_POOL_HPP
+#define _BLVM_BASE_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "noncopyable.hpp"
+
+namespace blvm {
+namespace base {
+
+    // Fixed set of worker threads running one ParallelFor() at a time.
+    class ThreadPool {
+    public:
+        // thread_count == 0: one thread per hardware thread.
+        explicit ThreadPool(size_t thread_count = 0);
+        ~ThreadPool();
+
+        size_t GetThreadCount() const {
+            return workers_.size();
+        }
+
+        // Calls task(worker_index, item_index) for every item_index in [0, item_count) and waits for all of them.
+        // Items are handed out dynamically, worker_index is in [0, GetThreadCount()) and identifies the calling
+        // thread, so per-worker state can be kept in a vector indexed by it. Tasks must not throw.
+        void ParallelFor(size_t item_count, const std::function<void(size_t, size_t)>& task);
+
+        static size_t GetDefaultThreadCount();
+    private:
+        void WorkerMain(size_t worker_index);
+    private:
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable work_available_;
+        std::condition_variable work_done_;
+
+        const std::function<void(size_t, size_t)>* task_;
+        size_t item_count_;
+        size_t next_item_;
+        size_t batch_size_;
+        size_t busy_workers_;
+        size_t generation_;
+        bool stopping_;
+
+        DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+    };
+
+}
+}
+
+#endif // _BLVM_BASE_THREAD_POOL_HPP
@@ -0,0 +1,123 @@
+#include "bitcode_base.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    namespace {
+
+        const uint32_t kMaxFixedWidth = 64;
+        const uint32_t kMaxVBRWidth = 32;
+
+        bool IsScalarEncoding(AbbrevOp::Encoding encoding) {
+            return encoding == AbbrevOp::Encoding::kFixed ||
+                   encoding == AbbrevOp::Encoding::kVBR ||
+                   encoding == AbbrevOp::Encoding::kChar6;
+        }
+
+        bool MakeScalarStep(const AbbrevOp& op, AbbrevStep::Kind fixed, AbbrevStep::Kind vbr, AbbrevStep::Kind char6,
+                            std::vector<AbbrevStep>& program) {
+            if (op.IsLiteral()) {
+                program.push_back(AbbrevStep(AbbrevStep::Kind::kLiteral, 0, op.GetLiteralValue()));
+                return true;
+            }
+
+            uint64_t width = op.GetEncodingExtraData();
+            switch (op.GetEncoding()) {
+                case AbbrevOp::Encoding::kFixed:
+                    if (width > kMaxFixedWidth)
+                        return false;
+                    program.push_back(AbbrevStep(fixed, (uint32_t)width));
+                    return true;
+                case AbbrevOp::Encoding::kVBR:
+                    if (width > kMaxVBRWidth)
+                        return false;
+                    program.push_back(AbbrevStep(vbr, (uint32_t)width));
+                    return true;
+                case AbbrevOp::Encoding::kChar6:
+                    program.push_back(AbbrevStep(char6, 6));
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // Merges runs of adjacent fixed fields into kFixedRun headers, as long as the run fits one 64-bit read.
+        void FuseFixedRuns(std::vector<AbbrevStep>& program) {
+            std::vector<AbbrevStep> fused;
+            fused.reserve(program.size() * 2);
+            fused.push_back(program.front());
+
+            size_t i = 1;
+            while (i < program.size()) {
+                if (program[i].kind != AbbrevStep::Kind::kFixed) {
+                    fused.push_back(program[i++]);
+                    continue;
+                }
+
+                size_t run_end = i;
+                uint32_t total_width = 0;
+                while (run_end < program.size() && program[run_end].kind == AbbrevStep::Kind::kFixed &&
+                       total_width + program[run_end].width <= kMaxFixedWidth) {
+                    total_width += program[run_end].width;
+                    run_end++;
+                }
+
+                if (run_end - i >= 2) {
+                    AbbrevStep run(AbbrevStep::Kind::kFixedRun, total_width);
+                    run.count = (uint32_t)(run_end - i);
+                    fused.push_back(run);
+                }
+                fused.insert(fused.end(), program.begin() + i, program.begin() + run_end);
+                i = run_end;
+            }
+            program.swap(fused);
+        }
+
+    }
+
+    bool Abbreviation::Compile() {
+        using Kind = AbbrevStep::Kind;
+
+        program_.clear();
+        scalar_operand_count_ = 0;
+        size_t op_count = operand_list_.size();
+        if (op_count == 0)
+            return false;
+
+        // record code
+        if (!MakeScalarStep(operand_list_[0], Kind::kFixed, Kind::kVBR, Kind::kChar6, program_))
+            return false;
+
+        for (size_t i = 1; i < op_count; i++) {
+            const AbbrevOp& op = operand_list_[i];
+            if (op.IsLiteral() || IsScalarEncoding(op.GetEncoding())) {
+                if (!MakeScalarStep(op, Kind::kFixed, Kind::kVBR, Kind::kChar6, program_))
+                    return false;
+                scalar_operand_count_++;
+                continue;
+            }
+
+            if (op.GetEncoding() == AbbrevOp::Encoding::kArray) {
+                // the element type is the last operand
+                if (i + 2 != op_count)
+                    return false;
+                const AbbrevOp& element = operand_list_[++i];
+                if (element.IsLiteral())
+                    return false;
+                if (!MakeScalarStep(element, Kind::kArrayFixed, Kind::kArrayVBR, Kind::kArrayChar6, program_))
+                    return false;
+                continue;
+            }
+
+            DCHECK(op.GetEncoding() == AbbrevOp::Encoding::kBlob);
+            if (i + 1 != op_count)
+                return false;
+            program_.push_back(AbbrevStep(Kind::kBlob, 8));
+        }
+
+        FuseFixedRuns(program_);
+        return true;
+    }
+
+}
+}
@@ -56,40 +56,75 @@ namespace bitcode {
         DISALLOW_COPY_AND_ASSIGN(BlockInfo);
     };
 
+    // One level of the reader's scope stack. Abbrev ids resolve first against the BLOCKINFO abbrevs
+    // registered for the block (shared, never copied), then against the DEFINE_ABBREVs of the block itself,
+    // which live in the reader's local abbrev list from local_abbrev_begin on.
     struct Block {
         uint32_t block_id;
         uint32_t block_size;
         uint32_t abbrevid_length;
-        std::vector<AbbrevRef> abbrevs;
+        uint32_t blockinfo_abbrev_count;  // snapshot at entry, BLOCKINFO abbrevs added later stay invisible
+        const BlockInfo* block_info;
+        size_t local_abbrev_begin;
+        size_t body_bit_begin;  // first bit after the block size word
+    };
 
-        Block() : block_id(0), block_size(0), abbrevid_length(0) {}
-        explicit Block(int abbrevid_len) : block_id(0), block_size(0), abbrevid_length(abbrevid_len) {}
+    class AbbrevOp;
 
-        Block(Block&& rhs) {
-            operator=(std::move(rhs));
-        }
+    // One instruction of a compiled abbreviation, see Abbreviation::Compile().
+    struct AbbrevStep {
+        enum class Kind : uint32_t {
+            kLiteral,
+            kFixed,
+            kFixedRun,      // one wide read, split into the `count` kFixed steps that follow
+            kVBR,
+            kChar6,
+            kArrayFixed,
+            kArrayVBR,
+            kArrayChar6,
+            kBlob
+        };
 
-        Block& operator=(Block&& rhs) {
-            if (this != &rhs) {
-                block_id = rhs.block_id;  rhs.block_id = 0;
-                block_size = rhs.block_size;  rhs.block_size = 0;
-                abbrevid_length = rhs.abbrevid_length;  rhs.abbrevid_length = 0;
-                abbrevs = std::move(rhs.abbrevs);
-            }
-            return *this;
-        }
-    };
+        Kind kind;
+        uint32_t width;     // field width, total width for kFixedRun, element width for arrays
+        uint32_t count;     // kFixedRun: number of fused fields
+        uint64_t value;     // kLiteral: precomputed value
 
-    class AbbrevOp;
+        AbbrevStep(Kind _kind, uint32_t _width, uint64_t _value = 0) :
+                kind(_kind), width(_width), count(0), value(_value) {}
+    };
 
     class Abbreviation : public base::RefCounted<Abbreviation> {
     public:
-        Abbreviation() {
+        Abbreviation() : scalar_operand_count_(0) {
             operand_list_.reserve(32);
         }
 
         ~Abbreviation() = default;
 
+        // Flattens the operand list into a decode program, once per definition instead of once per record.
+        // Returns false if the operand list is malformed (array/blob misplaced, too wide fields).
+        bool Compile();
+
+        // The record code step, never an array or blob.
+        const AbbrevStep& GetCodeStep() const {
+            return program_.front();
+        }
+
+        // Operand steps, excluding the record code.
+        const AbbrevStep* GetProgramBegin() const {
+            return program_.data() + 1;
+        }
+
+        const AbbrevStep* GetProgramEnd() const {
+            return program_.data() + program_.size();
+        }
+
+        // Number of non-array operands, an upper bound of what a record writes before its array or blob.
+        size_t GetScalarOperandCount() const {
+            return scalar_operand_count_;
+        }
+
         size_t GetOperandCount() const {
             return operand_list_.size();
         }
@@ -107,6 +142,8 @@ namespace bitcode {
         }
     private:
         std::vector<AbbrevOp> operand_list_;
+        std::vector<AbbrevStep> program_;
+        size_t scalar_operand_count_;
     };
 
     class AbbrevOp {
@@ -188,16 +225,9 @@ namespace bitcode {
         }
 
         static char DecodeChar6(unsigned input) {
-            if (input <= 25)
-                return input + 'a';
-            if (input <= 51)
-                return input - 26 + 'A';
-            if (input <= 61)
-                return input - 52 + '0';
-            if (input == 62)
-                return '.';
-            if (input == 63)
-                return '_';
+            static const char kChar6Table[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._";
+            if (input < 64)
+                return kChar6Table[input];
             BLVM_UNREACHABLE("Cannot be decode by char6");
             return '\0';
         }
@@ -15,7 +15,7 @@ namespace bitcode {
         kConstantBlock,
         kFunctionBlock,
 
-        kUnusedId1,
+        kIdentificationBlock,
 
         kValueSymtabBlock,
         kMetadataBlock,
@@ -23,7 +23,18 @@ namespace bitcode {
 
         kTypeBlock,
 
-        kUselistBlock
+        kUselistBlock,
+
+        kModuleStrtabBlock,
+        kGlobalValSummaryBlock,
+
+        kOperandBundleTagsBlock,
+        kMetadataKindBlock,
+
+        kStrtabBlock,
+        kFullLtoGlobalValSummaryBlock,
+        kSymtabBlock,
+        kSyncScopeNamesBlock
     };
 
     enum ModuleCodes {
@@ -38,13 +49,210 @@ namespace bitcode {
 
         kGlobalVar = 7,
         kFunction = 8,
-        kAlias = 9,
+        kAlias_Old = 9,
         kPurgeVals = 10,
 
         kGcName = 11,
-        kComdat = 12
+        kComdat = 12,
+
+        kVSTOffset = 13,
+        kAlias = 14,
+        kMetadataValuesUnused = 15,
+        kSourceFilename = 16,
+        kHash = 17,
+        kIFunc = 18
+    };
+
+    enum ValueSymtabCodes {
+        kVSTEntry = 1,
+        kVSTBBEntry = 2,
+        kVSTFnEntry = 3,
+        kVSTCombinedEntry = 5
+    };
+
+    enum StrtabCodes {
+        kStrtabBlob = 1
+    };
+
+    enum SymtabCodes {
+        kSymtabBlob = 1
     };
 
+    enum class FunctionCodes : uint32_t {
+        kDeclareBlocks = 1,
+
+        kInstBinop = 2,
+        kInstCast = 3,
+        kInstGEP_Old = 4,
+        kInstSelect = 5,
+        kInstExtractElt = 6,
+        kInstInsertElt = 7,
+        kInstShuffleVec = 8,
+        kInstCmp = 9,
+        kInstRet = 10,
+        kInstBr = 11,
+        kInstSwitch = 12,
+        kInstInvoke = 13,
+        kInstUnreachable = 15,
+        kInstPhi = 16,
+        kInstAlloca = 19,
+        kInstLoad = 20,
+        kInstVAArg = 23,
+        kInstStore_Old = 24,
+        kInstExtractVal = 26,
+        kInstInsertVal = 27,
+        kInstCmp2 = 28,
+        kInstVSelect = 29,
+        kInstInboundsGEP_Old = 30,
+        kInstIndirectBr = 31,
+        kDebugLocAgain = 33,
+        kInstCall = 34,
+        kDebugLoc = 35,
+        kInstFence = 36,
+        kInstCmpXchg_Old = 37,
+        kInstAtomicRMW_Old = 38,
+        kInstResume = 39,
+        kInstLandingPad_Old = 40,
+        kInstLoadAtomic = 41,
+        kInstStoreAtomic_Old = 42,
+        kInstGEP = 43,
+        kInstStore = 44,
+        kInstStoreAtomic = 45,
+        kInstCmpXchg = 46,
+        kInstLandingPad = 47,
+        kInstCleanupRet = 48,
+        kInstCatchRet = 49,
+        kInstCatchPad = 50,
+        kInstCleanupPad = 51,
+        kInstCatchSwitch = 52,
+        kOperandBundle = 55,
+        kInstUnop = 56,
+        kInstCallBr = 57,
+        kInstFreeze = 58,
+        kInstAtomicRMW = 59
+    };
+
+    enum class ConstantsCodes : uint32_t {
+        kSetType = 1,
+        kNull = 2,
+        kUndef = 3,
+        kInteger = 4,
+        kWideInteger = 5,
+        kFloat = 6,
+        kAggregate = 7,
+        kString = 8,
+        kCString = 9,
+        kCEBinop = 10,
+        kCECast = 11,
+        kCEGEP = 12,
+        kCESelect = 13,
+        kCEExtractElt = 14,
+        kCEInsertElt = 15,
+        kCEShuffleVec = 16,
+        kCECmp = 17,
+        kInlineAsm_Old = 18,
+        kCEShufVecEx = 19,
+        kCEInboundsGEP = 20,
+        kBlockAddress = 21,
+        kData = 22,
+        kInlineAsm_Old2 = 23,
+        kCEGEPWithInrangeIndex = 24,
+        kCEUnop = 25,
+        kPoison = 26,
+        kDsoLocalEquivalent = 27,
+        kInlineAsm_Old3 = 28,
+        kNoCfiValue = 29,
+        kInlineAsm = 30
+    };
+
+    enum class CastOpcodes : uint32_t {
+        kTrunc = 0,
+        kZExt = 1,
+        kSExt = 2,
+        kFPToUI = 3,
+        kFPToSI = 4,
+        kUIToFP = 5,
+        kSIToFP = 6,
+        kFPTrunc = 7,
+        kFPExt = 8,
+        kPtrToInt = 9,
+        kIntToPtr = 10,
+        kBitCast = 11,
+        kAddrSpaceCast = 12
+    };
+
+    enum class UnaryOpcodes : uint32_t {
+        kFNeg = 0
+    };
+
+    // On floating point operands kSDiv and kSRem stand for fdiv and frem, kAdd/kSub/kMul for their f* forms.
+    enum class BinaryOpcodes : uint32_t {
+        kAdd = 0,
+        kSub = 1,
+        kMul = 2,
+        kUDiv = 3,
+        kSDiv = 4,
+        kURem = 5,
+        kSRem = 6,
+        kShl = 7,
+        kLShr = 8,
+        kAShr = 9,
+        kAnd = 10,
+        kOr = 11,
+        kXor = 12
+    };
+
+    // Operand of kInstCmp2, numbered like llvm::CmpInst::Predicate.
+    enum class CmpPredicates : uint32_t {
+        kFCmpFalse = 0,
+        kFCmpOEQ = 1,
+        kFCmpOGT = 2,
+        kFCmpOGE = 3,
+        kFCmpOLT = 4,
+        kFCmpOLE = 5,
+        kFCmpONE = 6,
+        kFCmpORD = 7,
+        kFCmpUNO = 8,
+        kFCmpUEQ = 9,
+        kFCmpUGT = 10,
+        kFCmpUGE = 11,
+        kFCmpULT = 12,
+        kFCmpULE = 13,
+        kFCmpUNE = 14,
+        kFCmpTrue = 15,
+
+        kICmpEQ = 32,
+        kICmpNE = 33,
+        kICmpUGT = 34,
+        kICmpUGE = 35,
+        kICmpULT = 36,
+        kICmpULE = 37,
+        kICmpSGT = 38,
+        kICmpSGE = 39,
+        kICmpSLT = 40,
+        kICmpSLE = 41
+    };
+
+    // Bits of the calling convention operand of kInstCall.
+    enum CallMarkers {
+        kCallTail = 0,
+        kCallCConv = 1,
+        kCallMustTail = 14,
+        kCallExplicitType = 15,
+        kCallNoTail = 16,
+        kCallFmf = 17
+    };
+
+    // Signed operands (phi incoming values, integer constants) are written with the sign moved to bit 0.
+    inline uint64_t DecodeSignRotatedValue(uint64_t value) {
+        if ((value & 1) == 0)
+            return value >> 1;
+        if (value != 1)
+            return ~(value >> 1) + 1;
+        // there is no "-0": that is INT64_MIN
+        return 1ull << 63;
+    }
+
     enum AttributeCodes {
         kEntryOld = 1,
         kEntry = 2,
@@ -0,0 +1,95 @@
+#include "bitcode_materializer.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "function_block_parser.hpp"
+#include "parsing_exception.hpp"
+#include "../base/thread_pool.hpp"
+#include "../core/function.hpp"
+#include "../core/module.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    BitcodeMaterializer::BitcodeMaterializer(core::BLVMContext& context, core::Module& module,
+                                             base::MemoryBuffer&& bitcode_buffer) :
+            context_(context), module_(module), parsing_context_(std::move(bitcode_buffer)) {
+
+    }
+
+    BitcodeMaterializer::~BitcodeMaterializer() {
+
+    }
+
+    bool BitcodeMaterializer::Materialize(core::Function& function) {
+        if (function.IsMaterialized())
+            return true;
+
+        BitcodeReader reader(parsing_context_, *parsing_context_.GetBitcodeBuffer());
+        return MaterializeWith(reader, function);
+    }
+
+    bool BitcodeMaterializer::MaterializeAll(size_t thread_count) {
+        std::vector<core::Function*> pending;
+        bool all_succeeded = true;
+
+        for (auto& function : module_.function_list) {
+            if (function->IsDeclaration() || function->IsMaterialized())
+                continue;
+            if (function->GetBodyBitOffset() == 0)
+                all_succeeded = false;
+            else
+                pending.push_back(function.Get());
+        }
+
+        if (thread_count == 0)
+            thread_count = base::ThreadPool::GetDefaultThreadCount();
+        thread_count = std::min(thread_count, pending.size());
+
+        // one status slot per function, written by whichever worker decoded it
+        std::vector<uint8_t> succeeded(pending.size(), 0);
+
+        std::vector<std::unique_ptr<BitcodeReader>> readers(std::max<size_t>(thread_count, 1));
+        auto decode = [&](size_t worker_index, size_t item_index) {
+            std::unique_ptr<BitcodeReader>& reader = readers[worker_index];
+            if (!reader)
+                reader.reset(new BitcodeReader(parsing_context_, *parsing_context_.GetBitcodeBuffer()));
+
+            succeeded[item_index] = MaterializeWith(*reader, *pending[item_index]);
+            // a failed block leaves its scopes on the reader's block stack, start over with a clean one
+            if (!succeeded[item_index])
+                reader.reset();
+        };
+
+        if (thread_count <= 1) {
+            for (size_t i = 0; i < pending.size(); i++)
+                decode(0, i);
+        } else {
+            base::ThreadPool pool(thread_count);
+            pool.ParallelFor(pending.size(), decode);
+        }
+
+        for (uint8_t result : succeeded)
+            all_succeeded = all_succeeded && result;
+        return all_succeeded;
+    }
+
+    bool BitcodeMaterializer::MaterializeWith(BitcodeReader& reader, core::Function& function) {
+        if (function.GetBodyBitOffset() == 0)
+            return false;
+
+        try {
+            reader.SeekToBitPos(function.GetBodyBitOffset());
+
+            FunctionBlockParser parser(context_, parsing_context_, reader, module_, function);
+            parser.Parse();
+        } catch (ReaderException&) {
+            return false;
+        } catch (ParserException&) {
+            return false;
+        }
+        return function.IsMaterialized();
+    }
+
+}
+}
@@ -0,0 +1,44 @@
+#ifndef _BLVM_BITCODE_BITCODE_MATERIALIZER_HPP
+#define _BLVM_BITCODE_BITCODE_MATERIALIZER_HPP
+
+#include "../base/memory_buffer.hpp"
+#include "../core/core_fwd.hpp"
+#include "../core/materializer.hpp"
+#include "parsing_context.hpp"
+#include "bitcode_reader.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    // Owns the bitcode of a module and decodes function bodies from it on first use.
+    // Load the module-level part with a BitcodeParser over GetParsingContext(), then install
+    // the materializer into the module with core::Module::SetMaterializer().
+    class BitcodeMaterializer : public core::Materializer {
+    public:
+        BitcodeMaterializer(core::BLVMContext& context, core::Module& module, base::MemoryBuffer&& bitcode_buffer);
+        virtual ~BitcodeMaterializer() override;
+
+        ParsingContext& GetParsingContext() {
+            return parsing_context_;
+        }
+
+        virtual bool Materialize(core::Function& function) override;
+
+        // Each worker decodes with its own BitcodeReader over the shared buffer and the (then read-only)
+        // ParsingContext. Every function block only writes into its own Function, so the result does not
+        // depend on scheduling. Must not run concurrently with Materialize() or a module-level parse.
+        virtual bool MaterializeAll(size_t thread_count) override;
+    private:
+        bool MaterializeWith(BitcodeReader& reader, core::Function& function);
+    private:
+        core::BLVMContext& context_;
+        core::Module& module_;
+        ParsingContext parsing_context_;
+
+        DISALLOW_COPY_AND_ASSIGN(BitcodeMaterializer);
+    };
+
+}
+}
+
+#endif // _BLVM_BITCODE_BITCODE_MATERIALIZER_HPP
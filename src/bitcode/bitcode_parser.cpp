@@ -1,148 +1,228 @@
 #include "bitcode_parser.hpp"
+#include <algorithm>
 #include "bitcode_reader.hpp"
 #include "parsing_context.hpp"
 #include "parsing_exception.hpp"
 #include "bitcode_llvm.hpp"
+#include "constants_block.hpp"
+#include "function_block_parser.hpp"
 #include "../core/module.hpp"
 #include "../core/type.hpp"
+#include "../core/blvm_context.hpp"
+#include "../core/function.hpp"
+#include "../core/global_variable.hpp"
 
 namespace blvm {
 namespace bitcode {
 
     BitcodeParser::BitcodeParser(core::BLVMContext& context, ParsingContext& parsing_context,
                                  BitcodeReader& reader, core::Module& target_module) :
-            context_(context), parsing_context_(parsing_context), reader_(reader), module_(target_module) {
+            context_(context), parsing_context_(parsing_context), reader_(reader), module_(target_module),
+            next_type_index_(0), type_layout_types_index_(0), vst_bit_offset_(0), has_data_layout_(false),
+            has_type_layouts_(false) {
 
     }
 
     void BitcodeParser::Parse() {
+        using Entry = BitcodeReader::Entry;
+
+        ScopedDecodePhase phase(parsing_context_.GetDecodeStats(), DecodePhase::kModule);
+
         ValidateHeader();
-        ParseModuleBlock();
-    }
 
-    std::string BitcodeParser::ConvertOpsToString(const std::vector<uint64_t> &ops) {
-        std::string result;
+        while (true) {
+            Entry entry = reader_.ReadNextEntry();
+            if (entry.kind != Entry::Kind::kSubBlock)
+                throw ParserException(ParserError::kDataError);
+
+            if (entry.id == BlockIds::kIdentificationBlock) {
+                // producer string and epoch, not needed
+                reader_.SkipSubBlock(entry.id);
+                continue;
+            }
+            if (entry.id != BlockIds::kModuleBlock)
+                throw ParserException(ParserError::kDataError);
 
-        for (auto iter = ops.begin(); iter != ops.end(); ++iter)
-            result.push_back((char)*iter);
+            ParseModuleBlock();
+            break;
+        }
 
-        return std::move(result);
-    }
+        // v2 names live in the STRTAB after the module, shared by all modules of the file. Anything else at the
+        // top level (SYMTAB, further modules) is skipped by its size.
+        while (!strtab_.IsValid() && !reader_.AtEndOfStream()) {
+            Entry entry = reader_.ReadNextEntry();
+            if (entry.kind != Entry::Kind::kSubBlock)
+                throw ParserException(ParserError::kDataError);
 
-    void BitcodeParser::ConvertOpsToString(const std::vector<uint64_t>& ops, std::string& out_string) {
-        for (auto iter = ops.begin(); iter != ops.end(); ++iter)
-            out_string.push_back((char)*iter);
+            if (entry.id == BlockIds::kStrtabBlock)
+                ParseStrtabBlock();
+            else
+                reader_.SkipSubBlock(entry.id);
+        }
+        ResolveStrtabNames();
     }
 
     void BitcodeParser::ValidateHeader() {
-        if (reader_.Read(8) != 'B' ||
-            reader_.Read(8) != 'C' ||
-            reader_.Read(4) != 0x0 ||
-            reader_.Read(4) != 0xC ||
-            reader_.Read(4) != 0xE ||
-            reader_.Read(4) != 0xD) {
+        if (!reader_.ReadMagic())
             throw ParserException(ParserError::kDataError);
-        }
     }
 
     void BitcodeParser::ParseModuleBlock() {
         using Entry = BitcodeReader::Entry;
 
-        Entry entry = reader_.ReadNextEntry();
-        if (entry.kind != Entry::Kind::kSubBlock || entry.id != BlockIds::kModuleBlock)
-            throw ParserException(ParserError::kDataError);
-
+        size_t module_bit_offset = reader_.GetCurrentBitPos();
         reader_.EnterSubBlock(BlockIds::kModuleBlock);
 
+        // FUNCTION_BLOCKs come in the same order as the FUNCTION records that have a body.
+        std::vector<core::Function*> functions_with_bodies;
+        size_t next_function_body = 0;
+
         while (true) {
-            entry = reader_.ReadNextEntry();
+            Entry entry = reader_.ReadNextEntry();
 
             if (entry.kind == Entry::Kind::kError) {
                 throw ParserException(ParserError::kDataError);
             } else if (entry.kind == Entry::Kind::kEndBlock) {
                 reader_.ReadBlockEnd();
+                ComputeTypeLayouts();
                 break;
             } else if (entry.kind == Entry::Kind::kSubBlock) {
                 switch (entry.id) {
                     case StandardBlockIds::kBlockInfo:
-                        ParseBlockInfoBlock();
+                        ReadBlockInfoBlock(reader_, parsing_context_);
                         break;
                     case BlockIds::kModuleBlock:
                         throw ParserException(ParserError::kDataError);
                     case BlockIds::kTypeBlock:
                         ParseTypeBlock();
                         break;
+                    case BlockIds::kFunctionBlock:
+                        // A block index of this bitcode lists every function block already.
+                        if (next_function_body == 0 && !reader_.IsStreaming() &&
+                            ReadFunctionOffsetsFromIndex(functions_with_bodies, module_bit_offset)) {
+                            next_function_body = functions_with_bodies.size();
+                            break;
+                        }
+                        // With a VSTOFFSET, the FNENTRYs of the module VST give every body offset at once, and
+                        // the function blocks, which run up to the VST, need not be walked at all.
+                        if (next_function_body == 0 && vst_bit_offset_ != 0 && !reader_.IsStreaming() &&
+                            ReadFunctionOffsetsFromVST(functions_with_bodies)) {
+                            next_function_body = functions_with_bodies.size();
+                            reader_.SeekToBitPos(vst_bit_offset_);
+                            break;
+                        }
+                        // Remember where the body starts and decode it lazily, see BitcodeMaterializer.
+                        if (next_function_body >= functions_with_bodies.size())
+                            throw ParserException(ParserError::kDataError);
+                        functions_with_bodies[next_function_body++]->SetBodyBitOffset(reader_.GetCurrentBitPos());
+                        if (!reader_.IsStreaming()) {
+                            reader_.SkipSubBlock(entry.id);
+                            break;
+                        }
+                        // A stream cannot come back for the body: decode it now. All the module-level records
+                        // that define types precede the first function block.
+                        ComputeTypeLayouts();
+                        FunctionBlockParser(context_, parsing_context_, reader_, module_,
+                                            *functions_with_bodies[next_function_body - 1]).Parse();
+                        break;
+                    case BlockIds::kConstantBlock:
+                        BindDataLayout();
+                        ParseConstantsBlock();
+                        break;
                     case BlockIds::kParamattrBlock:
                     case BlockIds::kParamattrGroupBlock:
-                    case BlockIds::kConstantBlock:
                     case BlockIds::kMetadataBlock:
                     case BlockIds::kMetadataAttachment:
                     case BlockIds::kValueSymtabBlock:
-                    case BlockIds::kFunctionBlock:
                     case BlockIds::kUselistBlock:
                     default:
                         reader_.SkipSubBlock(entry.id);
                 }
             } else if (entry.kind == Entry::Kind::kRecord) {
-                std::vector<uint64_t> ops;
-                uint32_t record_code = reader_.ReadRecord(entry.id, ops);
+                RecordView ops = reader_.ReadRecord(entry.id);
+                uint32_t record_code = ops.GetCode();
 
                 switch (record_code) {
                     case ModuleCodes::kVersion:
                         if (ops.empty())
                             throw ParserException(ParserError::kDataError);
-                        if (ops[0] != 1)    // current we only support module version 1
+                        // 1: relative value ids, 2: names moved to the STRTAB block
+                        if (ops[0] != 1 && ops[0] != 2)
                             throw ParserException(ParserError::kNotSupproted);
                         module_.module_version = static_cast<int>(ops[0]);
                         break;
                     case ModuleCodes::kTriple:
                         if (!ops.empty()) {
-                            module_.target_triple = std::move(ConvertOpsToString(ops));
+                            module_.target_triple = ops.ToString();
                         }
                         break;
                     case ModuleCodes::kDataLayout:
+                        // the layout the types so far were taken for is final
+                        if (has_data_layout_)
+                            throw ParserException(ParserError::kDataError);
                         if (!ops.empty()) {
-                            module_.target_datalayout = std::move(ConvertOpsToString(ops));
+                            module_.target_datalayout = ops.ToString();
                         }
                         break;
                     case ModuleCodes::kAsm:
                         throw ParserException(ParserError::kNotSupproted);
                         break;
                     case ModuleCodes::kSectionName:
-                        if (!ops.empty()) {
-                            std::string section_name = ConvertOpsToString(ops);
-                            module_.section_name_table.push_back(std::move(section_name));
-                        }
+                        if (!ops.empty())
+                            module_.section_name_table.push_back(context_.Intern(ops.ToString()));
                         break;
                     case ModuleCodes::kDepLib:
                         // unused, skip
                         break;
                     case ModuleCodes::kGlobalVar:
-
+                        BindDataLayout();
+                        ParseGlobalVarRecord(ops);
                         break;
                     case ModuleCodes::kFunction: {
-                        if (ops.size() < 8)
+                        // v1: [type, callingconv, isproto, linkage, paramattr, alignment, section, visibility, ...]
+                        // v2: [strtab_offset, strtab_size, <v1 fields>]
+                        BindDataLayout();
+                        size_t first = module_.module_version >= 2 ? 2 : 0;
+                        if (ops.size() < first + 8)
                             throw ParserException(ParserError::kDataNotEnough);
 
-                        if (!module_.IsValidTypeIndex((uint32_t)ops[0]))
+                        if (!module_.IsValidTypeIndex((uint32_t)ops[first]))
                             throw ParserException(ParserError::kDataError);
 
-                        core::TypeRef function_type = module_.type_table[ops[0]];
-
+                        core::TypeRef function_type = module_.type_table[ops[first]];
+                        if (function_type->GetTypeCode() != TypeCodes::kFunction)
+                            throw ParserException(ParserError::kDataError);
 
+                        bool is_proto = (ops[first + 2] != 0);
+                        core::Linkage linkage = static_cast<core::Linkage>(ops[first + 3]);
+
+                        core::FunctionRef function = new core::Function(function_type, linkage, is_proto);
+                        if (first != 0)
+                            function_names_.push_back(std::make_pair(ops[0], ops[1]));
+                        if (!is_proto)
+                            functions_with_bodies.push_back(function.Get());
+                        module_.value_table.push_back({core::ModuleValue::Kind::kFunction,
+                                                       (uint32_t)module_.function_list.size()});
+                        module_.function_list.push_back(std::move(function));
                         break;
                     }
+                    case ModuleCodes::kAlias_Old:
                     case ModuleCodes::kAlias:
-
+                    case ModuleCodes::kIFunc:
+                        module_.value_table.push_back({core::ModuleValue::Kind::kAlias, 0});
+                        break;
+                    case ModuleCodes::kVSTOffset:
+                        // In 32-bit words from the start of the bitcode, pointing at the VST's ENTER_SUBBLOCK.
+                        if (ops.empty() || ops[0] == 0 || ops[0] > reader_.GetBufferSize() / 4)
+                            throw ParserException(ParserError::kDataError);
+                        vst_bit_offset_ = ops[0] * 32;
                         break;
                     case ModuleCodes::kPurgeVals:
 
                         break;
                     case ModuleCodes::kGcName:
-                        if (!ops.empty()) {
-                            std::string gc_name = ConvertOpsToString(ops);
-                            module_.gc_name_table.push_back(std::move(gc_name));
-                        }
+                        if (!ops.empty())
+                            module_.gc_name_table.push_back(context_.Intern(ops.ToString()));
                         break;
                     case ModuleCodes::kComdat:
 
@@ -154,82 +234,20 @@ namespace bitcode {
         }
     }
 
-    void BitcodeParser::ParseBlockInfoBlock() {
-        using Entry = BitcodeReader::Entry;
-
-        if (parsing_context_.HasBlockInfos()) {
-            reader_.SkipSubBlock(StandardBlockIds::kBlockInfo);
-            return;
-        }
-
-        reader_.EnterSubBlock(StandardBlockIds::kBlockInfo);
-
-        BlockInfo* target_blockinfo = nullptr;
-        std::vector<uint64_t> ops;
-
-        while (true) {
-            Entry entry = reader_.ReadNextEntry(BitcodeReader::kDontProcessAbbrevDefinitions);
-
-            switch (entry.kind) {
-                case Entry::Kind::kError:
-                    throw ParserException(ParserError::kDataError);
-                case Entry::Kind::kSubBlock:
-                    reader_.SkipSubBlock(entry.id);  // unknown content, skip it
-                    continue;
-                case Entry::Kind::kEndBlock:
-                    reader_.ReadBlockEnd();
-                    return;
-                case Entry::Kind::kRecord:
-                    break;
-            }
-
-            if (entry.id == BuiltinAbbrevId::kDefineAbbrev) {
-                if (target_blockinfo == nullptr)
-                    throw ParserException(ParserError::kDataError);
-
-                AbbrevRef abbrev = reader_.ReadAbbrevDefinition();
-                target_blockinfo->abbrevs.push_back(std::move(abbrev));
-                continue;
-            }
-
-            ops.clear();
-            uint32_t code = reader_.ReadRecord(entry.id, ops);
-
-            switch (static_cast<BlockInfoCodes>(code)) {
-                case BlockInfoCodes::kSetBID:
-                    if (ops.empty())
-                        throw ParserException(ParserError::kDataError);
-                    target_blockinfo = parsing_context_.GetOrCreateBlockInfo((uint32_t)ops[0]);
-                    break;
-                case BlockInfoCodes::kBlockName:
-                    if (target_blockinfo == nullptr)
-                        throw ParserException(ParserError::kDataError);
-                    target_blockinfo->block_name = std::move(ConvertOpsToString(ops));
-                    break;
-                case BlockInfoCodes::kSetRecordName: {
-                    if (target_blockinfo == nullptr)
-                        throw ParserException(ParserError::kDataError);
-                    std::string record_name;
-                    if (ops.size() > 1) {
-                        for (size_t i = 1; i < ops.size(); i++)
-                            record_name.push_back((char)ops[i]);
-                    }
-                    target_blockinfo->record_names.push_back(std::make_pair((uint32_t)ops[0], std::move(record_name)));
-                    break;
-                }
-            }
-        }
-    }
-
     void BitcodeParser::ParseTypeBlock() {
         using Entry = BitcodeReader::Entry;
         using namespace blvm::core;
 
+        if (!module_.type_table.empty())
+            throw ParserException(ParserError::kDataError);
+
         reader_.EnterSubBlock(BlockIds::kTypeBlock);
+        type_layout_types_index_ = context_.GetLayoutTypesIndex();
 
-        std::vector<uint64_t> ops;
         size_t entries = 0;
+        next_type_index_ = 0;
         std::string current_struct_typename;
+        std::vector<TypeRef> type_list;  // struct members / function params, reused across records
 
         while (true) {
             Entry entry = reader_.ReadNextEntry();
@@ -239,7 +257,8 @@ namespace bitcode {
                 case Entry::Kind::kSubBlock:
                     throw ParserException(ParserError::kDataError);
                 case Entry::Kind::kEndBlock:
-                    if (entries != 0 && module_.type_table.size() != entries)
+                    // also catches forward references to entries that never got a record
+                    if (next_type_index_ != module_.type_table.size())
                         throw ParserException(ParserError::kDataError);
                     reader_.ReadBlockEnd();
                     return;
@@ -247,16 +266,20 @@ namespace bitcode {
                     break;
             }
 
-            ops.clear();
-            TypeCodes type_code = static_cast<TypeCodes>(reader_.ReadRecord(entry.id, ops));
+            RecordView ops = reader_.ReadRecord(entry.id);
+            TypeCodes type_code = static_cast<TypeCodes>(ops.GetCode());
 
-            TypeRef result_type;
+            TypeRef result_type = nullptr;
 
             switch (type_code) {
                 case TypeCodes::kNumEntry:
-                    if (ops.size() < 1 || entries != 0)
+                    if (ops.size() < 1 || entries != 0 || next_type_index_ != 0)
+                        throw ParserException(ParserError::kDataError);
+                    // every entry takes at least one bit, anything larger is garbage
+                    if (ops[0] / 8 > reader_.GetBufferSize())
                         throw ParserException(ParserError::kDataError);
                     entries = static_cast<size_t>(ops[0]);
+                    module_.type_table.resize(entries, nullptr);
                     continue;
                 case TypeCodes::kVoid:
                 case TypeCodes::kHalf:
@@ -271,40 +294,37 @@ namespace bitcode {
                     result_type = Type::ObtainSimpleType(context_, type_code);
                     break;
                 case TypeCodes::kInteger: {
+                    if (ops.size() < 1)
+                        throw ParserException(ParserError::kDataNotEnough);
                     uint32_t bit_width = static_cast<uint32_t>(ops[0]);
-                    if (IntegerType::IsCommonBitwidth(bit_width)) {
-                        result_type = IntegerType::ObtainIntegerType(context_, bit_width);
-                    } else {
-                        result_type = new IntegerType(bit_width);
-                    }
+                    if (bit_width == 0)
+                        throw ParserException(ParserError::kDataError);
+                    result_type = IntegerType::ObtainIntegerType(context_, bit_width);
                     break;
                 }
                 case TypeCodes::kPointer: {
                     if (ops.size() < 1)
                         throw ParserException(ParserError::kDataNotEnough);
 
-                    uint32_t target_type_index = static_cast<uint32_t>(ops[0]);
-                    if (!module_.IsValidTypeIndex(target_type_index))
-                        throw ParserException(ParserError::kDataError);
-                    if (!PointerType::IsValidTargetType(module_.type_table[target_type_index]->GetTypeCode()))
+                    TypeRef target_type = GetTypeByIndex(ops[0]);
+                    if (!PointerType::IsValidTargetType(target_type->GetTypeCode()))
                         throw ParserException(ParserError::kNotSupproted);
 
                     uint32_t address_space = 0;
                     if (ops.size() >= 2)
                         address_space = static_cast<uint32_t>(ops[1]);
-                    result_type = new PointerType(target_type_index, address_space);
+                    result_type = PointerType::ObtainPointerType(context_, target_type, address_space);
                     break;
                 }
                 case TypeCodes::kArray: {
                     if (ops.size() < 2)
                         throw ParserException(ParserError::kDataNotEnough);
 
-                    uint32_t element_type_index = static_cast<uint32_t>(ops[1]);
-                    if (!module_.IsValidTypeIndex(element_type_index) ||
-                        !ArrayType::IsValidElementType(module_.type_table[element_type_index]->GetTypeCode()))
+                    TypeRef element_type = GetTypeByIndex(ops[1]);
+                    if (!ArrayType::IsValidElementType(element_type->GetTypeCode()))
                         throw ParserException(ParserError::kDataError);
 
-                    result_type = new ArrayType((uint32_t)ops[0], element_type_index);
+                    result_type = ArrayType::ObtainArrayType(context_, ops[0], element_type);
                     break;
                 }
                 case TypeCodes::kVector: {
@@ -314,24 +334,23 @@ namespace bitcode {
                     if (ops[0] == 0)
                         throw ParserException(ParserError::kDataError);
 
-                    uint32_t element_type_index = static_cast<uint32_t>(ops[1]);
-                    if (!module_.IsValidTypeIndex(element_type_index) ||
-                        !VectorType::IsValidElementType(module_.type_table[element_type_index]->GetTypeCode()))
+                    TypeRef element_type = GetTypeByIndex(ops[1]);
+                    if (!VectorType::IsValidElementType(element_type->GetTypeCode()))
                         throw ParserException(ParserError::kDataError);
 
-                    result_type = new VectorType((uint32_t)ops[0], element_type_index);
+                    result_type = VectorType::ObtainVectorType(context_, (uint32_t)ops[0], element_type);
                     break;
                 }
                 case TypeCodes::kOpaque:
                     if (ops.size() != 1)
                         throw ParserException(ParserError::kDataError);
 
-                    result_type = new StructType(false, current_struct_typename);
+                    result_type = GetOrCreateNamedStruct(current_struct_typename);
                     current_struct_typename.clear();
                     break;
                 case TypeCodes::kStruct_NAME:
                     current_struct_typename.clear();
-                    ConvertOpsToString(ops, current_struct_typename);
+                    ops.AppendToString(current_struct_typename);
                     continue;
                 case TypeCodes::kStruct_NAMED:
                 case TypeCodes::kStruct_ANON: {
@@ -339,62 +358,42 @@ namespace bitcode {
                         throw ParserException(ParserError::kDataError);
 
                     bool ispacked = (ops[0] != 0);
-                    std::vector<uint32_t> members;
+                    type_list.clear();
                     for (size_t i = 1; i < ops.size(); i++) {
-                        uint32_t type_index = static_cast<uint32_t>(ops[i]);
-                        if (!module_.IsValidTypeIndex(type_index) ||
-                            !StructType::IsValidMemberType(module_.type_table[type_index]->GetTypeCode())) {
+                        TypeRef member_type = GetTypeByIndex(ops[i]);
+                        if (!StructType::IsValidMemberType(member_type->GetTypeCode()))
                             throw ParserException(ParserError::kDataError);
-                        }
-                        members.push_back(type_index);
+                        type_list.push_back(member_type);
                     }
 
                     if (type_code == TypeCodes::kStruct_NAMED) {
-                        result_type = new StructType(ispacked, current_struct_typename);
+                        StructType* struct_type = GetOrCreateNamedStruct(current_struct_typename);
+                        struct_type->SetBody(context_, ispacked, type_list);
+                        result_type = struct_type;
                         current_struct_typename.clear();
                     } else {
-                        result_type = new StructType(ispacked);
+                        result_type = StructType::ObtainLiteralStructType(context_, ispacked, type_list);
                     }
-                    if (ops.size() >= 2)
-                        static_cast<StructType*>(result_type.Get())->FillMembers(std::move(members));
-                    break;
-                }
-                case TypeCodes::kFunction_Old: {
-                    // format: [FUNCTION, vararg, ignored, retty, ...paramty...]
-                    if (ops.size() < 3)
-                        throw ParserException(ParserError::kDataNotEnough);
-
-                    std::vector<uint32_t> params;
-                    for (size_t i = 3; i < ops.size(); i++) {
-                        uint32_t param_type = static_cast<uint32_t>(ops[i]);
-                        if (!module_.IsValidTypeIndex(param_type))
-                            throw ParserException(ParserError::kDataError);
-                        if (!FunctionType::IsValidArgumentType(module_.type_table[param_type]->GetTypeCode()))
-                            throw ParserException(ParserError::kDataError);
-                        params.push_back(param_type);
-                    }
-                    bool is_vararg = (ops[0] != 0);
-                    uint32_t retty = static_cast<uint32_t>(ops[2]);
-                    result_type = new FunctionType(is_vararg, retty, std::move(params));
                     break;
                 }
+                case TypeCodes::kFunction_Old:
                 case TypeCodes::kFunction: {
-                    // format: [FUNCTION, vararg, retty, ...paramty...]
-                    if (ops.size() < 2)
+                    // kFunction_Old: [vararg, ignored, retty, ...paramty...]
+                    // kFunction:     [vararg, retty, ...paramty...]
+                    size_t return_index = (type_code == TypeCodes::kFunction_Old) ? 2 : 1;
+                    if (ops.size() < return_index + 1)
                         throw ParserException(ParserError::kDataNotEnough);
 
-                    std::vector<uint32_t> params;
-                    for (size_t i = 2; i < ops.size(); i++) {
-                        uint32_t param_type = static_cast<uint32_t>(ops[i]);
-                        if (!module_.IsValidTypeIndex(param_type))
+                    type_list.clear();
+                    for (size_t i = return_index + 1; i < ops.size(); i++) {
+                        TypeRef param_type = GetTypeByIndex(ops[i]);
+                        if (!FunctionType::IsValidArgumentType(param_type->GetTypeCode()))
                             throw ParserException(ParserError::kDataError);
-                        if (!FunctionType::IsValidArgumentType(module_.type_table[param_type]->GetTypeCode()))
-                            throw ParserException(ParserError::kDataError);
-                        params.push_back(param_type);
+                        type_list.push_back(param_type);
                     }
                     bool is_vararg = (ops[0] != 0);
-                    uint32_t retty = static_cast<uint32_t>(ops[1]);
-                    result_type = new FunctionType(is_vararg, retty, std::move(params));
+                    TypeRef return_type = GetTypeByIndex(ops[return_index]);
+                    result_type = FunctionType::ObtainFunctionType(context_, is_vararg, return_type, type_list);
                     break;
                 }
                 default:
@@ -402,17 +401,342 @@ namespace bitcode {
             }
             if (result_type == nullptr)
                 throw ParserException(ParserError::kInternalError);
-            module_.type_table.push_back(std::move(result_type));
+
+            if (next_type_index_ == module_.type_table.size()) {
+                if (entries != 0)
+                    throw ParserException(ParserError::kDataError);
+                module_.type_table.push_back(nullptr);
+            }
+            // a placeholder here was handed out for a forward reference, only a named struct may resolve it
+            TypeRef& slot = module_.type_table[next_type_index_++];
+            if (slot != nullptr && slot != result_type)
+                throw ParserException(ParserError::kDataError);
+            slot = result_type;
         }
     }
 
+    // Entries not defined yet can only be named structs (LLVM writes a struct after its members, so
+    // recursive structs are referenced early). They get a placeholder that their own record fills in.
+    core::TypeRef BitcodeParser::GetTypeByIndex(uint64_t type_index) {
+        if (type_index >= module_.type_table.size())
+            throw ParserException(ParserError::kDataError);
+
+        core::TypeRef& slot = module_.type_table[type_index];
+        if (slot == nullptr)
+            slot = core::StructType::CreateNamedStructType(context_, false, std::string());
+        return slot;
+    }
+
+    core::StructType* BitcodeParser::GetOrCreateNamedStruct(const std::string& name) {
+        core::StructType* struct_type = nullptr;
+        if (next_type_index_ < module_.type_table.size() && module_.type_table[next_type_index_] != nullptr) {
+            struct_type = static_cast<core::StructType*>(module_.type_table[next_type_index_]);
+            struct_type->SetName(context_, name);
+        } else {
+            struct_type = core::StructType::CreateNamedStructType(context_, false, name);
+        }
+        return struct_type;
+    }
+
+    // Having read the ENTER_SUBBLOCK abbrevid and block id of the first FUNCTION_BLOCK of the module block entered at
+    // module_bit_offset. On success the reader is left past the last function block, otherwise it has not moved.
+    bool BitcodeParser::ReadFunctionOffsetsFromIndex(const std::vector<core::Function*>& functions_with_bodies,
+                                                     size_t module_bit_offset) {
+        const BlockIndexRef& index = parsing_context_.GetBlockIndex();
+        if (!index)
+            return false;
+
+        const std::vector<BlockIndexEntry>& entries = index->GetEntries();
+        const std::vector<uint32_t>& modules = index->GetEntriesById(BlockIds::kModuleBlock);
+        auto module = std::find_if(modules.begin(), modules.end(), [&](uint32_t n) {
+            return entries[n].bit_offset == module_bit_offset;
+        });
+        if (module == modules.end())
+            return false;
+
+        std::vector<uint64_t> body_offsets;
+        for (uint32_t n : index->GetEntriesById(BlockIds::kFunctionBlock)) {
+            if (entries[n].parent == *module)
+                body_offsets.push_back(entries[n].bit_offset);
+        }
+        if (body_offsets.empty() || body_offsets.size() != functions_with_bodies.size() ||
+            body_offsets.front() != reader_.GetCurrentBitPos())
+            return false;
+
+        for (size_t i = 0; i < body_offsets.size(); i++)
+            functions_with_bodies[i]->SetBodyBitOffset(body_offsets[i]);
+        reader_.SeekToBitPos(body_offsets.back());
+        reader_.SkipSubBlock(BlockIds::kFunctionBlock);
+        return true;
+    }
+
+    // Having read the ENTER_SUBBLOCK abbrevid and block id of the first FUNCTION_BLOCK. On success the reader is
+    // left inside the module block past the VST, which the caller seeks back to, otherwise it is restored.
+    bool BitcodeParser::ReadFunctionOffsetsFromVST(const std::vector<core::Function*>& functions_with_bodies) {
+        using Entry = BitcodeReader::Entry;
+
+        size_t resume_bit_pos = reader_.GetCurrentBitPos();
+        if (vst_bit_offset_ <= resume_bit_pos)
+            return false;
+
+        // FNENTRY offsets point at the ENTER_SUBBLOCK too, the body offset is past the abbrev id and block id.
+        uint32_t header_bits = reader_.GetCurrentAbbrevIdWidth() + CommonBitWidth::kBlockIdWidth;
+        size_t assigned = 0;
+
+        reader_.SeekToBitPos(vst_bit_offset_);
+        Entry entry = reader_.ReadNextEntry();
+        if (entry.kind != Entry::Kind::kSubBlock || entry.id != BlockIds::kValueSymtabBlock) {
+            reader_.SeekToBitPos(resume_bit_pos);
+            return false;
+        }
+        reader_.EnterSubBlock(BlockIds::kValueSymtabBlock);
+
+        while (true) {
+            entry = reader_.ReadNextEntry();
+
+            switch (entry.kind) {
+                case Entry::Kind::kError:
+                    throw ParserException(ParserError::kDataError);
+                case Entry::Kind::kSubBlock:
+                    reader_.SkipSubBlock(entry.id);
+                    continue;
+                case Entry::Kind::kEndBlock:
+                    reader_.ReadBlockEnd();
+                    if (assigned == functions_with_bodies.size())
+                        return true;
+                    reader_.SeekToBitPos(resume_bit_pos);
+                    return false;
+                case Entry::Kind::kRecord:
+                    break;
+            }
+
+            // v1: [valueid, offset, namechar x N], v2: [valueid, offset]
+            RecordView ops = reader_.ReadRecord(entry.id);
+            if (ops.GetCode() != ValueSymtabCodes::kVSTFnEntry)
+                continue;
+            if (ops.size() < 2 || ops[0] >= module_.value_table.size() ||
+                module_.value_table[ops[0]].kind != core::ModuleValue::Kind::kFunction ||
+                ops[1] == 0 || ops[1] >= vst_bit_offset_ / 32)
+                throw ParserException(ParserError::kDataError);
+
+            core::Function* function = module_.function_list[module_.value_table[ops[0]].index].Get();
+            if (function->IsDeclaration() || function->GetBodyBitOffset() != 0)
+                throw ParserException(ParserError::kDataError);
+            function->SetBodyBitOffset(ops[1] * 32 + header_bits);
+            assigned++;
+        }
+    }
+
+    void BitcodeParser::ParseStrtabBlock() {
+        using Entry = BitcodeReader::Entry;
+
+        reader_.EnterSubBlock(BlockIds::kStrtabBlock);
+
+        while (true) {
+            Entry entry = reader_.ReadNextEntry();
+
+            if (entry.kind == Entry::Kind::kError) {
+                throw ParserException(ParserError::kDataError);
+            } else if (entry.kind == Entry::Kind::kEndBlock) {
+                reader_.ReadBlockEnd();
+                break;
+            } else if (entry.kind == Entry::Kind::kSubBlock) {
+                reader_.SkipSubBlock(entry.id);
+            } else if (entry.kind == Entry::Kind::kRecord) {
+                // The blob points into the bitcode buffer, names become views into it rather than copies.
+                // A stream moves on, keep a copy until the names are interned.
+                RecordView ops = reader_.ReadRecord(entry.id);
+                if (ops.GetCode() != StrtabCodes::kStrtabBlob || !ops.HasBlob())
+                    continue;
+                if (reader_.IsStreaming()) {
+                    ByteSpan blob = ops.GetBlob();
+                    strtab_storage_.assign(reinterpret_cast<const char*>(blob.data), blob.size);
+                    strtab_ = StringTable(ByteSpan(reinterpret_cast<const uint8_t*>(strtab_storage_.data()),
+                                                   strtab_storage_.size()));
+                } else {
+                    strtab_ = StringTable(ops.GetBlob());
+                }
+            }
+        }
+    }
+
+    void BitcodeParser::ResolveStrtabNames() {
+        if (function_names_.empty() && global_names_.empty())
+            return;
+        if (!strtab_.IsValid() || function_names_.size() != module_.function_list.size() ||
+            global_names_.size() != module_.global_list.size())
+            throw ParserException(ParserError::kDataError);
+
+        for (size_t i = 0; i < function_names_.size(); i++)
+            module_.function_list[i]->SetName(GetStrtabName(function_names_[i]));
+        for (size_t i = 0; i < global_names_.size(); i++)
+            module_.global_list[i]->SetName(GetStrtabName(global_names_[i]));
+    }
+
+    base::StringPiece BitcodeParser::GetStrtabName(const std::pair<uint64_t, uint64_t>& name) {
+        if (!strtab_.Contains(name.first, name.second))
+            throw ParserException(ParserError::kDataError);
+        base::StringPiece result = strtab_.Get(name.first, name.second);
+        if (reader_.IsStreaming())
+            result = context_.Intern(result).ToStringPiece();
+        return result;
+    }
+
+    // v1: [pointer type, isconst, initid, linkage, alignment, section, visibility, threadlocal, ...]
+    // v2: [strtab_offset, strtab_size, <v1 fields>]
+    // With bit 1 of isconst set, the type is the value type and the address space is in the bits above.
+    void BitcodeParser::ParseGlobalVarRecord(const RecordView& ops) {
+        size_t first = module_.module_version >= 2 ? 2 : 0;
+        if (ops.size() < first + 6)
+            throw ParserException(ParserError::kDataNotEnough);
+        if (!module_.IsValidTypeIndex((uint32_t)ops[first]))
+            throw ParserException(ParserError::kDataError);
+
+        core::TypeRef value_type = module_.type_table[ops[first]];
+        bool is_constant = (ops[first + 1] & 1) != 0;
+        if ((ops[first + 1] & 2) == 0) {
+            if (value_type->GetTypeCode() != TypeCodes::kPointer)
+                throw ParserException(ParserError::kDataError);
+            value_type = static_cast<const core::PointerType*>(value_type)->GetPointeeType();
+        }
+
+        uint64_t initializer_id = ops[first + 2] == 0 ? core::GlobalVariable::kNoInitializer : ops[first + 2] - 1;
+        core::Linkage linkage = static_cast<core::Linkage>(ops[first + 3]);
+        // log2 + 1, 0 for none
+        if (ops[first + 4] > 32)
+            throw ParserException(ParserError::kDataError);
+        uint32_t alignment = ops[first + 4] == 0 ? 0 : 1u << (ops[first + 4] - 1);
+
+        if (first != 0)
+            global_names_.push_back(std::make_pair(ops[0], ops[1]));
+        module_.value_table.push_back({core::ModuleValue::Kind::kGlobalVariable,
+                                       (uint32_t)module_.global_list.size()});
+        module_.global_list.push_back(new core::GlobalVariable(value_type, linkage, is_constant, alignment,
+                                                               initializer_id));
+    }
+
+    void BitcodeParser::ParseConstantsBlock() {
+        size_t first = module_.constant_list.size();
+        ReadConstantsBlock(reader_, module_.type_table, module_.constant_list, module_.constant_operands);
+        for (size_t i = first; i < module_.constant_list.size(); i++)
+            module_.value_table.push_back({core::ModuleValue::Kind::kConstant, (uint32_t)i});
+    }
+
+    // Once per module: at the end of the module block (DATALAYOUT follows the type block), or before the first
+    // function body of a stream.
+    void BitcodeParser::ComputeTypeLayouts() {
+        if (has_type_layouts_)
+            return;
+        has_type_layouts_ = true;
+
+        ScopedDecodePhase phase(parsing_context_.GetDecodeStats(), DecodePhase::kTypeLayout);
+        BindDataLayout();
+
+        for (core::TypeRef type : module_.type_table) {
+            if (!context_.ComputeTypeLayout(type))
+                throw ParserException(ParserError::kDataError);
+        }
+        // The globals and constants that function bodies refer to are all declared by now.
+        module_.InitializeGlobals();
+    }
+
+    // Before the first value that has a type. The type block precedes the DATALAYOUT record, so its types were
+    // obtained under whatever layout the context had selected last. If that is not this module's, they are
+    // obtained again from the types of this module's layout.
+    void BitcodeParser::BindDataLayout() {
+        if (has_data_layout_)
+            return;
+        has_data_layout_ = true;
+
+        if (!context_.SetDataLayout(module_.target_datalayout))
+            throw ParserException(ParserError::kNotSupproted);
+        if (context_.GetLayoutTypesIndex() == type_layout_types_index_)
+            return;
+
+        std::unordered_map<core::TypeRef, core::TypeRef> rebuilt;
+        for (core::TypeRef& type : module_.type_table)
+            type = RebuildType(type, rebuilt);
+    }
+
+    // Named structs are created anew, everything else is obtained by its structure.
+    core::TypeRef BitcodeParser::RebuildType(core::TypeRef type,
+                                             std::unordered_map<core::TypeRef, core::TypeRef>& rebuilt) {
+        using namespace blvm::core;
+
+        if (type == nullptr)
+            return nullptr;
+        auto iter = rebuilt.find(type);
+        if (iter != rebuilt.end())
+            return iter->second;
+
+        TypeRef result = nullptr;
+        std::vector<TypeRef> components;
+        switch (type->GetTypeCode()) {
+            case TypeCodes::kInteger:
+                result = IntegerType::ObtainIntegerType(context_, static_cast<IntegerType*>(type)->GetBitWidth());
+                break;
+            case TypeCodes::kPointer: {
+                PointerType* pointer_type = static_cast<PointerType*>(type);
+                result = PointerType::ObtainPointerType(context_, RebuildType(pointer_type->GetPointeeType(), rebuilt),
+                                                        pointer_type->GetAddressSpace());
+                break;
+            }
+            case TypeCodes::kArray: {
+                ArrayType* array_type = static_cast<ArrayType*>(type);
+                result = ArrayType::ObtainArrayType(context_, array_type->GetElementCount(),
+                                                    RebuildType(array_type->GetElementType(), rebuilt));
+                break;
+            }
+            case TypeCodes::kVector: {
+                VectorType* vector_type = static_cast<VectorType*>(type);
+                result = VectorType::ObtainVectorType(context_, vector_type->GetElementCount(),
+                                                      RebuildType(vector_type->GetElementType(), rebuilt));
+                break;
+            }
+            case TypeCodes::kStruct_ANON: {
+                StructType* struct_type = static_cast<StructType*>(type);
+                for (TypeRef member : struct_type->GetMembers())
+                    components.push_back(RebuildType(member, rebuilt));
+                result = StructType::ObtainLiteralStructType(context_, struct_type->IsPacked(), components);
+                break;
+            }
+            case TypeCodes::kStruct_NAMED: {
+                // registered before its members, which may point back at it
+                StructType* struct_type = static_cast<StructType*>(type);
+                StructType* named = StructType::CreateNamedStructType(context_, struct_type->IsPacked(),
+                                                                      struct_type->GetName().ToStringPiece());
+                rebuilt[type] = named;
+                if (!struct_type->IsOpaque()) {
+                    for (TypeRef member : struct_type->GetMembers())
+                        components.push_back(RebuildType(member, rebuilt));
+                    named->SetBody(context_, struct_type->IsPacked(), components);
+                }
+                return named;
+            }
+            case TypeCodes::kFunction: {
+                FunctionType* function_type = static_cast<FunctionType*>(type);
+                for (TypeRef param : function_type->GetParamTypes())
+                    components.push_back(RebuildType(param, rebuilt));
+                result = FunctionType::ObtainFunctionType(context_, function_type->IsVarArg(),
+                                                          RebuildType(function_type->GetReturnType(), rebuilt),
+                                                          components);
+                break;
+            }
+            default:
+                result = Type::ObtainSimpleType(context_, type->GetTypeCode());
+                if (result == nullptr)
+                    throw ParserException(ParserError::kDataError);
+                break;
+        }
+        rebuilt[type] = result;
+        return result;
+    }
+
     void BitcodeParser::ParseParamattrBlock() {
         using Entry = BitcodeReader::Entry;
 
         reader_.EnterSubBlock(BlockIds::kParamattrBlock);
 
-        std::vector<uint64_t> ops;
-
         while (true) {
             Entry entry = reader_.ReadNextEntry();
 
@@ -427,10 +751,9 @@ namespace bitcode {
                     break;
             }
 
-            ops.clear();
-            uint32_t code = reader_.ReadRecord(entry.id, ops);
+            RecordView ops = reader_.ReadRecord(entry.id);
 
-            switch (code) {
+            switch (ops.GetCode()) {
                 case AttributeCodes::kEntryOld:
                     for (size_t i = 0; i < ops.size(); i += 2) {
 
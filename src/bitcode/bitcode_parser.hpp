@@ -3,15 +3,23 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include "../base/noncopyable.hpp"
+#include "../base/string_piece.hpp"
 #include "../core/core_fwd.hpp"
+#include "string_table.hpp"
 
 namespace blvm {
 namespace bitcode {
 
     class BitcodeReader;
     class ParsingContext;
+    class RecordView;
 
+    // Over a streaming reader (BitcodeReader::IsStreaming()) the whole module is decoded in one forward pass:
+    // function bodies are parsed as their blocks go by instead of being left to a materializer, and names are
+    // interned in the context.
     class BitcodeParser {
     public:
         BitcodeParser(core::BLVMContext& context, ParsingContext& parsing_context,
@@ -19,19 +27,44 @@ namespace bitcode {
         ~BitcodeParser() = default;
         void Parse();
     private:
-        std::string ConvertOpsToString(const std::vector<uint64_t>& ops);
-        void ConvertOpsToString(const std::vector<uint64_t>& ops, std::string& out_string);
         void ValidateHeader();
         void ParseModuleBlock();
-        void ParseBlockInfoBlock();
         void ParseTypeBlock();
         void ParseParamattrBlock();
+        void ParseStrtabBlock();
+        void ParseConstantsBlock();
+        void ParseGlobalVarRecord(const RecordView& ops);
+
+        void BindDataLayout();
+        core::TypeRef RebuildType(core::TypeRef type, std::unordered_map<core::TypeRef, core::TypeRef>& rebuilt);
+        void ComputeTypeLayouts();
+        base::StringPiece GetStrtabName(const std::pair<uint64_t, uint64_t>& name);
+        bool ReadFunctionOffsetsFromIndex(const std::vector<core::Function*>& functions_with_bodies,
+                                          size_t module_bit_offset);
+        bool ReadFunctionOffsetsFromVST(const std::vector<core::Function*>& functions_with_bodies);
+        void ResolveStrtabNames();
+
+        core::TypeRef GetTypeByIndex(uint64_t type_index);
+        core::StructType* GetOrCreateNamedStruct(const std::string& name);
     private:
         core::BLVMContext& context_;
         ParsingContext& parsing_context_;
         BitcodeReader& reader_;
         core::Module& module_;
 
+        size_t next_type_index_;  // type table entry the next TYPE_BLOCK record defines
+        size_t type_layout_types_index_;  // BLVMContext::GetLayoutTypesIndex() while the type block was read
+
+        uint64_t vst_bit_offset_;  // module-level VST from MODULE_CODE_VSTOFFSET, 0 if there is none
+
+        bool has_data_layout_;
+        bool has_type_layouts_;
+
+        std::vector<std::pair<uint64_t, uint64_t>> function_names_;  // v2: (offset, size) into the STRTAB
+        std::vector<std::pair<uint64_t, uint64_t>> global_names_;
+        StringTable strtab_;
+        std::string strtab_storage_;  // streaming: the STRTAB blob does not outlive the reader's window
+
         DISALLOW_COPY_AND_ASSIGN(BitcodeParser);
     };
 
@@ -1,23 +1,63 @@
 #include "bitcode_reader.hpp"
+#include <algorithm>
 #include "../base/error_handling.hpp"
 #include "parsing_exception.hpp"
 
 namespace blvm {
 namespace bitcode {
 
-    BitcodeReader::BitcodeReader(ParsingContext& parsing_context, const base::MemoryBuffer& bitcode_buffer) :
-            parsing_context_(parsing_context), buffer_(bitcode_buffer),
-            buffer_index_(0), current_word_(0), current_word_bits_left_(0), current_block_(2) {
+    BitcodeReader::BitcodeReader(const ParsingContext& parsing_context, const base::MemoryBuffer& bitcode_buffer) :
+            parsing_context_(parsing_context),
+            buffer_data_(bitcode_buffer.begin()), buffer_size_(bitcode_buffer.size()), buffer_index_(0),
+            window_offset_(0), input_size_(bitcode_buffer.size()), stream_(nullptr), retained_depth_(0),
+            retained_byte_begin_(0), current_word_(0), current_word_bits_left_(0), scopes_(16), scope_depth_(0),
+            current_block_(&scopes_[0]) {
+        Init();
+    }
+
+    BitcodeReader::BitcodeReader(const ParsingContext& parsing_context, base::StreamInput& stream) :
+            parsing_context_(parsing_context), buffer_data_(stream.GetWindowData()),
+            buffer_size_((size_t)(stream.GetWindowEnd() - stream.GetWindowBegin())), buffer_index_(0),
+            window_offset_((size_t)stream.GetWindowBegin()),
+            input_size_(stream.IsComplete() ? (size_t)stream.GetWindowEnd() : SIZE_MAX), stream_(&stream),
+            retained_depth_(0), retained_byte_begin_(0), current_word_(0), current_word_bits_left_(0), scopes_(16),
+            scope_depth_(0), current_block_(&scopes_[0]) {
+        Init();
+    }
+
+    void BitcodeReader::Init() {
+        // the top level has no BLOCKINFO and 2-bit abbrev ids
+        *current_block_ = {0, 0, 2, 0, nullptr, 0};
+#if BLVM_DECODE_STATS
+        if (parsing_context_.GetDecodeStats())
+            stats_.reset(new DecodeStats());
+        stats_clock_ = DecodeStats::Now();
+#endif
         FillCurrentWord();
     }
 
     BitcodeReader::~BitcodeReader() {
+#if BLVM_DECODE_STATS
+        if (stats_) {
+            ChargeBlockTime();
+            parsing_context_.GetDecodeStats()->Merge(*stats_);
+        }
+#endif
+    }
 
+#if BLVM_DECODE_STATS
+    void BitcodeReader::ChargeBlockTime() {
+        uint64_t now = DecodeStats::Now();
+        // the top level is not a block, id 0 there would be BLOCKINFO
+        if (scope_depth_ != 0)
+            stats_->GetBlock(current_block_->block_id).nanoseconds += now - stats_clock_;
+        stats_clock_ = now;
     }
+#endif
 
     BitcodeReader::Entry BitcodeReader::ReadNextEntry(int flags) {
         while (true) {
-            word_t word = Read(current_block_.abbrevid_length);
+            word_t word = Read(current_block_->abbrevid_length);
             switch (word) {
                 case BuiltinAbbrevId::kEndBlock:
                     return Entry::MakeEndBlock();
@@ -25,7 +65,7 @@ namespace bitcode {
                     return Entry::MakeSubBlock(ReadSubBlockId());
                 case BuiltinAbbrevId::kDefineAbbrev:
                     if (!(flags & kDontProcessAbbrevDefinitions)) {
-                        current_block_.abbrevs.push_back(ReadAbbrevDefinition());
+                        local_abbrevs_.push_back(ReadAbbrevDefinition());
                         continue;
                     } // else: fallthrough
                 case BuiltinAbbrevId::kUnabbrevRecord:
@@ -35,65 +75,44 @@ namespace bitcode {
         }
     }
 
-    void BitcodeReader::FillCurrentWord() {
-        int buffer_bytes_left = (int)(buffer_.size() - buffer_index_);
-        if (buffer_bytes_left <= 0)
+    // The bitstream is little-endian, fewer than sizeof(word_t) bytes left: zero-pad the tail.
+    // A stream has only reached the end of its window, it slides the window first.
+    void BitcodeReader::FillTailWord() {
+        if (stream_ && EnsureAvailable(window_offset_ + buffer_index_ + sizeof(word_t))) {
+            memcpy(&current_word_, buffer_data_ + buffer_index_, sizeof(word_t));
+            buffer_index_ += sizeof(word_t);
+            current_word_bits_left_ = kBitsPerWord;
+            return;
+        }
+        if (buffer_index_ >= buffer_size_)
             throw ReaderException(ReaderError::kEof);
 
-        size_t expect_bytes = (size_t)buffer_bytes_left >= sizeof(word_t) ? sizeof(word_t) : (size_t)buffer_bytes_left;
-        size_t bytes_read = buffer_.ReadBytes(reinterpret_cast<uint8_t*>(&current_word_), buffer_index_, expect_bytes);
-        if (bytes_read != expect_bytes)
-            throw ReaderException(ReaderError::kDataNotEnough);
-
-        buffer_index_ += bytes_read;
-        current_word_bits_left_ = bytes_read * 8;
+        size_t bytes_left = buffer_size_ - buffer_index_;
+        current_word_ = 0;
+        memcpy(&current_word_, buffer_data_ + buffer_index_, bytes_left);
+        buffer_index_ += bytes_left;
+        current_word_bits_left_ = (uint32_t)(bytes_left * 8);
     }
 
-    BitcodeReader::word_t BitcodeReader::Read(uint32_t bits) {
-        static const size_t bits_per_word = sizeof(word_t) * 8;
-        DCHECK(bits <= bits_per_word);
-
-        if (bits <= current_word_bits_left_) {
-            word_t result = current_word_ & (~word_t(0) >> (bits_per_word - bits));
-            current_word_ >>= bits;
-            current_word_bits_left_ -= bits;
-            return result;
-        }
-
+    BitcodeReader::word_t BitcodeReader::ReadSlow(uint32_t bits) {
         word_t result = current_word_bits_left_ ? current_word_ : 0;
-        size_t bits_need_left = bits - current_word_bits_left_;
+        uint32_t bits_have = current_word_bits_left_;
+        uint32_t bits_need_left = bits - bits_have;
 
         FillCurrentWord();
         if (current_word_bits_left_ < bits_need_left)
             throw ReaderException(ReaderError::kDataNotEnough);
 
-        word_t result2 = current_word_ & (~word_t(0) >> (bits_per_word - bits_need_left));
-        current_word_ >>= bits_need_left;
+        word_t result2 = current_word_ & (~word_t(0) >> (kBitsPerWord - bits_need_left));
+        current_word_ = bits_need_left < kBitsPerWord ? current_word_ >> bits_need_left : 0;
         current_word_bits_left_ -= bits_need_left;
 
-        result |= result2 << (bits - bits_need_left);
+        result |= result2 << bits_have;
         return result;
     }
 
-    uint32_t BitcodeReader::ReadVBR(uint32_t bits) {
-        uint32_t piece = (uint32_t)Read(bits);
-        if ((piece & (1u << (bits - 1))) == 0)
-            return piece;
-
-        uint32_t result = 0;
-        uint32_t shift_left = 0;
-        while (true) {
-            result |= (piece & ((1u << (bits - 1)) - 1)) << shift_left;
-
-            if ((piece & (1u << (bits - 1))) == 0)
-                return result;
-
-            piece = (uint32_t)Read(bits);
-            shift_left += bits - 1;
-        }
-    }
-
-    uint64_t BitcodeReader::ReadVBR64(uint32_t bits) {
+    // Piece by piece, used for uncommon widths and values crossing the cached word.
+    uint64_t BitcodeReader::ReadVBRSlow(uint32_t bits) {
         uint32_t piece = (uint32_t)Read(bits);
         if ((piece & (1u << (bits - 1))) == 0)
             return (uint64_t)piece;
@@ -111,22 +130,45 @@ namespace bitcode {
         }
     }
 
-    size_t BitcodeReader::GetCurrentBitPos() {
-        return buffer_index_ * 8 - current_word_bits_left_;
+    bool BitcodeReader::EnsureAvailable(size_t end_byte) {
+        if (end_byte <= window_offset_ + buffer_size_)
+            return true;
+        if (!stream_)
+            return false;
+        // the cached word is kept, but RefillCurrentWord() may reload it from memory
+        return LoadWindow(GetCurrentBitPos() / 8, end_byte);
     }
 
-    bool BitcodeReader::IsValidBytePos(size_t byte_pos) {
-        return byte_pos < buffer_.size();
+    // Slides the window to [keep_from, end_byte) or to the end of the stream. buffer_index_ keeps its position
+    // in the input when that is still in the window, callers moving past it set it themselves.
+    bool BitcodeReader::LoadWindow(size_t keep_from, size_t end_byte) {
+        if (retained_depth_ != 0)
+            keep_from = std::min(keep_from, retained_byte_begin_);
+        size_t input_index = window_offset_ + buffer_index_;
+
+        bool loaded = stream_->Load(keep_from, end_byte);
+        if (stream_->IsComplete())
+            input_size_ = (size_t)stream_->GetWindowEnd();
+
+        window_offset_ = (size_t)stream_->GetWindowBegin();
+        buffer_data_ = stream_->GetWindowData();
+        buffer_size_ = (size_t)stream_->GetWindowEnd() - window_offset_;
+        buffer_index_ = input_index > window_offset_ ? std::min(input_index - window_offset_, buffer_size_) : 0;
+        return loaded;
     }
 
     void BitcodeReader::SeekToBitPos(size_t bit_pos) {
         size_t target_byte = bit_pos / 8;
         uint32_t target_byte_remain_bits = (uint32_t)(bit_pos % 8);
 
-        if (target_byte >= buffer_.size())
+        if (target_byte < window_offset_)
+            throw ReaderException(ReaderError::kNotSeekable);
+        // a forward seek lets a stream drop everything up to the target without copying it
+        size_t end_byte = target_byte + (target_byte_remain_bits != 0 ? 1 : 0);
+        if (end_byte > window_offset_ + buffer_size_ && (!stream_ || !LoadWindow(target_byte, end_byte)))
             throw ReaderException(ReaderError::kEof);
 
-        buffer_index_ = target_byte;
+        buffer_index_ = target_byte - window_offset_;
         current_word_bits_left_ = 0;
 
         if (target_byte_remain_bits != 0) {
@@ -135,15 +177,35 @@ namespace bitcode {
     }
 
     void BitcodeReader::SkipTo32bitsBoundary() {
-        if (sizeof(word_t) > 4 && current_word_bits_left_ >= 32) {
-            current_word_ >>= (current_word_bits_left_ - 32);
-            current_word_bits_left_ = 32;
+        uint32_t skip_bits = (uint32_t)(GetCurrentBitPos() & 31);
+        if (skip_bits == 0)
+            return;
+        skip_bits = 32 - skip_bits;
+
+        if (skip_bits <= current_word_bits_left_) {
+            current_word_ >>= skip_bits;
+            current_word_bits_left_ -= skip_bits;
         } else {
+            // The boundary is at or beyond the end of the cached word, it only happens after an unaligned seek.
+            size_t target_bitpos = GetCurrentBitPos() + skip_bits;
             current_word_ = 0;
             current_word_bits_left_ = 0;
+            if (EnsureAvailable(target_bitpos / 8))
+                SeekToBitPos(target_bitpos);
+            else
+                buffer_index_ = buffer_size_;
         }
     }
 
+    bool BitcodeReader::ReadMagic() {
+        return Read(8) == 'B' &&
+               Read(8) == 'C' &&
+               Read(4) == 0x0 &&
+               Read(4) == 0xC &&
+               Read(4) == 0xE &&
+               Read(4) == 0xD;
+    }
+
     // Having read the ENTER_SUBBLOCK abbrevid (by ReadNextEntry())
     uint32_t BitcodeReader::ReadSubBlockId() {
         return ReadVBR(CommonBitWidth::kBlockIdWidth);
@@ -151,21 +213,14 @@ namespace bitcode {
 
     // Having read the ENTER_SUBBLOCK abbrevid, and the blockid(vbr8) operand
     void BitcodeReader::EnterSubBlock(uint32_t block_id) {
-        Block block;
-        block.block_id = block_id;
-        block.abbrevid_length = ReadVBR(CommonBitWidth::kNewAbbrevIdWidth);
+        uint32_t abbrevid_length = ReadVBR(CommonBitWidth::kNewAbbrevIdWidth);
         SkipTo32bitsBoundary();
-        block.block_size = (uint32_t)Read(CommonBitWidth::kBlockSizeWidth);
-
-        BlockInfo* block_info = parsing_context_.GetBlockInfo(block_id);
-        if (block_info)
-            block.abbrevs.insert(block.abbrevs.end(), block_info->abbrevs.begin(), block_info->abbrevs.end());
+        uint32_t block_size = (uint32_t)Read(CommonBitWidth::kBlockSizeWidth);
 
-        if (block.block_size >= buffer_.size())
+        if (block_size >= input_size_)
             throw ReaderException(ReaderError::kDataError);
 
-        block_stack_.push(std::move(current_block_));
-        current_block_ = std::move(block);
+        PushBlockScope(block_id, abbrevid_length, block_size);
     }
 
     // Having read the ENTER_SUBBLOCK abbrevid, and the blockid(vbr8) operand
@@ -174,10 +229,18 @@ namespace bitcode {
         SkipTo32bitsBoundary();
         word_t block_size_bytes = Read(CommonBitWidth::kBlockSizeWidth);
 
-        if (block_size_bytes >= buffer_.size())
+        if (block_size_bytes >= input_size_)
             throw ReaderException(ReaderError::kDataError);
 
         SeekToBitPos(GetCurrentBitPos() + block_size_bytes * 4 * 8);
+#if BLVM_DECODE_STATS
+        if (stats_) {
+            BlockDecodeStats& block = stats_->GetBlock(block_id);
+            block.block_count++;
+            block.skipped_count++;
+            block.bytes += block_size_bytes * 4;
+        }
+#endif
     }
 
     // Having read the END_BLOCK abbrevid (by ReadNextEntry())
@@ -186,12 +249,73 @@ namespace bitcode {
         PopBlockScope();
     }
 
-    void BitcodeReader::PopBlockScope() {
-        if (block_stack_.empty())
+    // Inside a block: leaves it without reading the remaining entries.
+    void BitcodeReader::SkipRestOfBlock() {
+        if (scope_depth_ == 0)
             throw ReaderException(ReaderError::kScopeMismatch);
 
-        current_block_ = std::move(block_stack_.top());
-        block_stack_.pop();
+        SeekToBitPos(current_block_->body_bit_begin + (size_t)current_block_->block_size * 4 * 8);
+        PopBlockScope();
+    }
+
+    // Inside a block: the raw bytes of its body as declared by the block size, END_BLOCK included.
+    ByteSpan BitcodeReader::GetCurrentBlockBody() {
+        if (scope_depth_ == 0)
+            throw ReaderException(ReaderError::kScopeMismatch);
+
+        size_t begin = current_block_->body_bit_begin / 8;
+        size_t size = (size_t)current_block_->block_size * 4;
+        if (stream_) {
+            // One block at a time: the body stays in the window until PopBlockScope().
+            if (begin < window_offset_ || (retained_depth_ != 0 && retained_depth_ != scope_depth_))
+                throw ReaderException(ReaderError::kNotSeekable);
+            retained_depth_ = scope_depth_;
+            retained_byte_begin_ = begin;
+            EnsureAvailable(begin + size);
+        }
+
+        begin = std::min(begin - window_offset_, buffer_size_);
+        size = std::min(size, buffer_size_ - begin);
+        return ByteSpan(buffer_data_ + begin, size);
+    }
+
+    // O(1) whatever the size of the BLOCKINFO: the shared abbrevs are referenced, not copied.
+    void BitcodeReader::PushBlockScope(uint32_t block_id, uint32_t abbrevid_length, uint32_t block_size) {
+        if (scope_depth_ + 1 == scopes_.size())
+            scopes_.resize(scopes_.size() * 2);
+
+        const BlockInfo* block_info = parsing_context_.GetBlockInfo(block_id);
+#if BLVM_DECODE_STATS
+        if (stats_) {
+            ChargeBlockTime();
+            BlockDecodeStats& block = stats_->GetBlock(block_id);
+            block.block_count++;
+            block.bytes += (uint64_t)block_size * 4;
+        }
+#endif
+
+        current_block_ = &scopes_[++scope_depth_];
+        current_block_->block_id = block_id;
+        current_block_->block_size = block_size;
+        current_block_->abbrevid_length = abbrevid_length;
+        current_block_->blockinfo_abbrev_count = block_info ? (uint32_t)block_info->abbrevs.size() : 0;
+        current_block_->block_info = block_info;
+        current_block_->local_abbrev_begin = local_abbrevs_.size();
+        current_block_->body_bit_begin = GetCurrentBitPos();
+    }
+
+    void BitcodeReader::PopBlockScope() {
+        if (scope_depth_ == 0)
+            throw ReaderException(ReaderError::kScopeMismatch);
+#if BLVM_DECODE_STATS
+        if (stats_)
+            ChargeBlockTime();
+#endif
+
+        if (retained_depth_ == scope_depth_)
+            retained_depth_ = 0;
+        local_abbrevs_.resize(current_block_->local_abbrev_begin);
+        current_block_ = &scopes_[--scope_depth_];
     }
 
     // Having read the DEFINE_ABBREV abbrevid (by ReadNextEntry())
@@ -221,114 +345,142 @@ namespace bitcode {
             }
             abbrev->AddOperand(std::move(AbbrevOp(encoding, value)));
         }
+
+        if (!abbrev->Compile())
+            throw ReaderException(ReaderError::kDataError);
         return abbrev;
     }
 
-    uint64_t BitcodeReader::ReadAbbrevOp(const AbbrevOp& op) {
-        DCHECK(!op.IsLiteral());
-
-        switch (op.GetEncoding()) {
-            case AbbrevOp::Encoding::kArray:
-            case AbbrevOp::Encoding::kBlob:
-                BLVM_UNREACHABLE("Unsupported encoding type");
-            case AbbrevOp::Encoding::kFixed:
-                return Read((uint32_t)op.GetEncodingExtraData());
-            case AbbrevOp::Encoding::kVBR:
-                return ReadVBR64((uint32_t)op.GetEncodingExtraData());
-            case AbbrevOp::Encoding::kChar6:
+    uint64_t BitcodeReader::ReadScalarStep(const AbbrevStep& step) {
+        switch (step.kind) {
+            case AbbrevStep::Kind::kLiteral:
+                return step.value;
+            case AbbrevStep::Kind::kFixed:
+                return Read(step.width);
+            case AbbrevStep::Kind::kVBR:
+                return ReadVBR64(step.width);
+            case AbbrevStep::Kind::kChar6:
                 return (uint64_t)AbbrevOp::DecodeChar6((uint32_t)Read(6));
             default:
                 break;
         }
-        BLVM_UNREACHABLE("Invalid encoding type!");
+        BLVM_UNREACHABLE("Invalid scalar step!");
         return 0;
     }
 
-    AbbrevRef BitcodeReader::GetAbbreviationById(uint32_t abbrevid) {
-        uint32_t abbrev_index = abbrevid - BuiltinAbbrevId::kFirstApplicationAbbrev;
-        if (abbrev_index >= current_block_.abbrevs.size())
-            throw ReaderException(ReaderError::kDataError);
-
-        return current_block_.abbrevs[abbrev_index];
+    template <uint32_t kWidth>
+    void BitcodeReader::ReadVBRArray(uint32_t element_count, uint64_t* out_ops) {
+        for (uint32_t i = 0; i < element_count; i++)
+            out_ops[i] = ReadVBRFast<kWidth>();
     }
 
     // UNABBREV_RECORD or processed abbrev record
-    uint32_t BitcodeReader::ReadRecord(uint32_t abbrevid, std::vector<uint64_t>& out_ops) {
+    RecordView BitcodeReader::DecodeRecord(uint32_t abbrevid) {
+        using Kind = AbbrevStep::Kind;
+
         if (abbrevid == BuiltinAbbrevId::kUnabbrevRecord) {
             uint32_t code = ReadVBR(6);
             uint32_t numops = ReadVBR(6);
+            uint64_t* ops = ReserveRecordOperands(numops);
             for (uint32_t i = 0; i < numops; i++)
-                out_ops.push_back(ReadVBR64(6));
-            return code;
-        }
-
-        base::RefPtr<Abbreviation> abbrev = GetAbbreviationById(abbrevid);
-
-        if (abbrev->GetOperandCount() == 0)
-            throw ReaderException(ReaderError::kDataError);
-
-        const AbbrevOp& code_op = abbrev->GetOperandInfoAt(0);
-        uint32_t code;
-        if (code_op.IsLiteral()) {
-            code = (uint32_t)code_op.GetLiteralValue();
-        } else {
-            AbbrevOp::Encoding encoding = code_op.GetEncoding();
-            if (encoding == AbbrevOp::Encoding::kArray || encoding == AbbrevOp::Encoding::kBlob)
-                throw ReaderException(ReaderError::kDataError);
-            code = (uint32_t)ReadAbbrevOp(code_op);
+                ops[i] = ReadVBR64(6);
+            return RecordView(code, ops, numops, nullptr, 0, false);
         }
 
-        size_t op_count = abbrev->GetOperandCount();
-        for (size_t i = 1; i < op_count; i++) {
-            const AbbrevOp& op = abbrev->GetOperandInfoAt(i);
-            if (op.IsLiteral()) {
-                out_ops.push_back(op.GetLiteralValue());
-                continue;
-            }
-
-            AbbrevOp::Encoding encoding = op.GetEncoding();
-            if (encoding != AbbrevOp::Encoding::kArray && encoding != AbbrevOp::Encoding::kBlob) {
-                out_ops.push_back(ReadAbbrevOp(op));
-                continue;
-            }
-
-            if (encoding == AbbrevOp::Encoding::kArray) {
-                uint32_t element_count = ReadVBR(6);
-                if (i + 2 != op_count)
-                    throw ReaderException(ReaderError::kDataError);
-                const AbbrevOp& element = abbrev->GetOperandInfoAt(++i);
-
-                for (uint32_t j = 0; j < element_count; j++) {
-                    out_ops.push_back(ReadAbbrevOp(element));
+        const Abbreviation& abbrev = GetAbbreviationById(abbrevid);
+        uint32_t code = (uint32_t)ReadScalarStep(abbrev.GetCodeStep());
+
+        uint64_t* ops = ReserveRecordOperands(abbrev.GetScalarOperandCount());
+        size_t op_count = 0;
+
+        const AbbrevStep* program_end = abbrev.GetProgramEnd();
+        for (const AbbrevStep* step = abbrev.GetProgramBegin(); step != program_end; ++step) {
+            switch (step->kind) {
+                case Kind::kLiteral:
+                    ops[op_count++] = step->value;
+                    break;
+                case Kind::kFixed:
+                    ops[op_count++] = Read(step->width);
+                    break;
+                case Kind::kFixedRun: {
+                    word_t fields = Read(step->width);
+                    const AbbrevStep* run_end = step + 1 + step->count;
+                    for (++step; step != run_end; ++step) {
+                        ops[op_count++] = fields & (~word_t(0) >> (kBitsPerWord - step->width));
+                        fields >>= step->width;
+                    }
+                    --step;
+                    break;
                 }
-                continue;
-            }
-
-            DCHECK(encoding == AbbrevOp::Encoding::kBlob);
-            uint32_t element_count = ReadVBR(6);
-            SkipTo32bitsBoundary();
-
-            size_t current_bitpos = GetCurrentBitPos();
-            size_t target_bitpos = current_bitpos + ((element_count + 3) & ~3) * 8;
-
-            if (!IsValidBytePos(target_bitpos / 8)) {
-                for (uint32_t k = 0; k < element_count; k++)
-                    out_ops.push_back(0);
-                buffer_index_ = buffer_.size();
-                break;
-            } else {
-                const uint8_t* ptr = buffer_.GetAddressAt(current_bitpos / 8);
-
-                for (uint32_t k = 0; k < element_count; k++) {
-                    out_ops.push_back(*ptr++);
+                case Kind::kVBR:
+                    ops[op_count++] = ReadVBR64(step->width);
+                    break;
+                case Kind::kChar6:
+                    ops[op_count++] = (uint64_t)AbbrevOp::DecodeChar6((uint32_t)Read(6));
+                    break;
+                case Kind::kArrayFixed: {
+                    // Arrays and blobs are always last, return from here.
+                    uint32_t element_count = ReadVBR(6);
+                    uint32_t width = step->width;
+                    if (width <= 8) {
+                        uint8_t* bytes = ReserveRecordBytes(element_count);
+                        for (uint32_t i = 0; i < element_count; i++)
+                            bytes[i] = (uint8_t)Read(width);
+                        return RecordView(code, ops, op_count, bytes, element_count, false);
+                    }
+                    ops = ReserveRecordOperands(op_count + element_count);
+                    for (uint32_t i = 0; i < element_count; i++)
+                        ops[op_count + i] = Read(width);
+                    return RecordView(code, ops, op_count + element_count, nullptr, 0, false);
+                }
+                case Kind::kArrayVBR: {
+                    uint32_t element_count = ReadVBR(6);
+                    ops = ReserveRecordOperands(op_count + element_count);
+                    switch (step->width) {
+                        case 6:
+                            ReadVBRArray<6>(element_count, ops + op_count);
+                            break;
+                        case 8:
+                            ReadVBRArray<8>(element_count, ops + op_count);
+                            break;
+                        default:
+                            for (uint32_t i = 0; i < element_count; i++)
+                                ops[op_count + i] = ReadVBR64(step->width);
+                    }
+                    return RecordView(code, ops, op_count + element_count, nullptr, 0, false);
+                }
+                case Kind::kArrayChar6: {
+                    uint32_t element_count = ReadVBR(6);
+                    uint8_t* bytes = ReserveRecordBytes(element_count);
+                    for (uint32_t i = 0; i < element_count; i++)
+                        bytes[i] = (uint8_t)AbbrevOp::DecodeChar6((uint32_t)Read(6));
+                    return RecordView(code, ops, op_count, bytes, element_count, false);
+                }
+                case Kind::kBlob: {
+                    uint32_t element_count = ReadVBR(6);
+                    SkipTo32bitsBoundary();
+
+                    size_t current_bitpos = GetCurrentBitPos();
+                    size_t target_bitpos = current_bitpos + ((element_count + 3) & ~3) * 8;
+
+                    if (!EnsureAvailable(target_bitpos / 8 + 1)) {
+                        // Truncated blob: report zeros and move to the end, as LLVM does.
+                        uint8_t* bytes = ReserveRecordBytes(element_count);
+                        memset(bytes, 0, element_count);
+                        buffer_index_ = buffer_size_;
+                        current_word_bits_left_ = 0;
+                        return RecordView(code, ops, op_count, bytes, element_count, true);
+                    }
+
+                    const uint8_t* blob = buffer_data_ + (current_bitpos / 8 - window_offset_);
+                    SeekToBitPos(target_bitpos);
+                    return RecordView(code, ops, op_count, blob, element_count, true);
                 }
             }
-
-            SeekToBitPos(target_bitpos);
         }
 
-        return code;
+        return RecordView(code, ops, op_count, nullptr, 0, false);
     }
 
 }
-}
\ No newline at end of file
+}
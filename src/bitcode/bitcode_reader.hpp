@@ -2,34 +2,141 @@
 #define _BLVM_BITCODE_BITCODE_READER_HPP
 
 #include <cstdint>
-#include <stack>
+#include <cstring>
+#include <memory>
 #include <vector>
 #include "../base/noncopyable.hpp"
+#include "../base/bit_utils.hpp"
 #include "../base/memory_buffer.hpp"
+#include "../base/stream_input.hpp"
 #include "../core/core_fwd.hpp"
 #include "parsing_context.hpp"
 #include "bitcode_base.hpp"
+#include "record_view.hpp"
+#include "parsing_exception.hpp"
+#include "decode_stats.hpp"
 
 namespace blvm {
 namespace bitcode {
 
     class BitcodeReader {
     public:
-        typedef size_t word_t;
+        typedef uint64_t word_t;
         struct Entry;
 
         enum : int {
             kDontProcessAbbrevDefinitions = 1
         };
     public:
-        BitcodeReader(ParsingContext& parsing_context, const base::MemoryBuffer& bitcode_buffer);
+        BitcodeReader(const ParsingContext& parsing_context, const base::MemoryBuffer& bitcode_buffer);
+        // Reads through the sliding window of a stream. Bit positions are still offsets from the start of the
+        // stream, but seeking back only works within the window, see IsStreaming().
+        BitcodeReader(const ParsingContext& parsing_context, base::StreamInput& stream);
         ~BitcodeReader();
 
-        word_t Read(uint32_t bits);
-        uint32_t ReadVBR(uint32_t bits);
-        uint64_t ReadVBR64(uint32_t bits);
+        // A streaming reader drops the input behind it: a position can be revisited only while it is in the
+        // current block kept by GetCurrentBlockBody(), or within the last few bytes. Blobs and the block body
+        // stay valid until the next read only.
+        bool IsStreaming() const {
+            return stream_ != nullptr;
+        }
+
+        // Fast path is inlined: a single bounds check against the cached word.
+        word_t Read(uint32_t bits) {
+            DCHECK(bits <= kBitsPerWord);
+            if (bits <= current_word_bits_left_) {
+                word_t result = current_word_ & (~word_t(0) >> (kBitsPerWord - bits));
+                // a full word (Fixed(64), or a fused run of 64 bits) right after a refill shifts everything out
+                current_word_ = bits < kBitsPerWord ? current_word_ >> bits : 0;
+                current_word_bits_left_ -= bits;
+                return result;
+            }
+            return ReadSlow(bits);
+        }
+
+        // Common widths are dispatched to ReadVBRFast<>, calls with a constant width fold the switch away.
+        uint32_t ReadVBR(uint32_t bits) {
+            return (uint32_t)ReadVBR64(bits);
+        }
+
+        uint64_t ReadVBR64(uint32_t bits) {
+            switch (bits) {
+                case 4:
+                    return ReadVBRFast<4>();
+                case 5:
+                    return ReadVBRFast<5>();
+                case 6:
+                    return ReadVBRFast<6>();
+                case 8:
+                    return ReadVBRFast<8>();
+                default:
+                    return ReadVBRSlow(bits);
+            }
+        }
+
+        // Decodes a whole VBR value from the cached word at once when all of its chunks are there:
+        // the terminating chunk is the lowest clear continuation bit, found with one ctz, and the payloads
+        // are gathered with pext or a fixed sequence of mask/shift steps, without a per-chunk loop.
+        template <uint32_t kWidth>
+        uint64_t ReadVBRFast() {
+            static const word_t kContinuationMask = VBRContinuationMask(kWidth, kWidth - 1);
+
+            word_t stops = ~current_word_ & kContinuationMask & ValidBitsMask();
+            if (stops == 0) {
+                // The value straddles the cached word, reload it at the exact bit position (56+ bits).
+                if (!RefillCurrentWord())
+                    return ReadVBRSlow(kWidth);
+                stops = ~current_word_ & kContinuationMask & ValidBitsMask();
+                if (stops == 0)
+                    return ReadVBRSlow(kWidth);
+            }
+
+            uint32_t used_bits = base::CountTrailingZeros64(stops) + 1;
+            word_t chunks = current_word_ & (~word_t(0) >> (kBitsPerWord - used_bits));
+            current_word_ = (current_word_ >> (used_bits - 1)) >> 1;
+            current_word_bits_left_ -= used_bits;
+#if BLVM_HAS_PEXT
+            return base::ParallelBitExtract64(chunks, ~kContinuationMask);
+#else
+            return VBRPayloadCompactor<kWidth, 0, (kWidth < kBitsPerWord)>::Compact(chunks);
+#endif
+        }
+
         Entry ReadNextEntry(int flags = 0);
 
+        size_t GetCurrentBitPos() const {
+            return (window_offset_ + buffer_index_) * 8 - current_word_bits_left_;
+        }
+
+        void SeekToBitPos(size_t bit_pos);
+
+        // Size of the whole input in bytes. SIZE_MAX for a stream whose end has not been seen yet.
+        size_t GetBufferSize() const {
+            return input_size_;
+        }
+
+        bool AtEndOfStream() {
+            size_t bit_pos = GetCurrentBitPos();
+            return bit_pos >= (window_offset_ + buffer_size_) * 8 && !EnsureAvailable(bit_pos / 8 + 1);
+        }
+
+        // 'BC' 0xC0DE. False if the stream does not start with the bitcode magic.
+        bool ReadMagic();
+
+        // Size of the current block in 32-bit words, as declared by its header.
+        uint32_t GetCurrentBlockSize() const {
+            return current_block_->block_size;
+        }
+
+        uint32_t GetCurrentAbbrevIdWidth() const {
+            return current_block_->abbrevid_length;
+        }
+
+        // Nesting depth of the current block, 0 at the top level.
+        size_t GetBlockDepth() const {
+            return scope_depth_;
+        }
+
         // Having read the ENTER_SUBBLOCK abbrevid (by ReadNextEntry())
         uint32_t ReadSubBlockId();
 
@@ -42,31 +149,171 @@ namespace bitcode {
         // Having read the END_BLOCK abbrevid (by ReadNextEntry())
         void ReadBlockEnd();
 
+        // Inside a block: leaves it without reading the remaining entries.
+        void SkipRestOfBlock();
+
+        // Inside a block: the raw bytes of its body as declared by the block size, END_BLOCK included.
+        // A streaming reader keeps them in its window until the block is left.
+        ByteSpan GetCurrentBlockBody();
+
         // Having read the DEFINE_ABBREV abbrevid (by ReadNextEntry())
         AbbrevRef ReadAbbrevDefinition();
 
-        // UNABBREV_RECORD or processed abbrev record
-        uint32_t ReadRecord(uint32_t abbrevid, std::vector<uint64_t>& out_ops);
+        // UNABBREV_RECORD or processed abbrev record.
+        // The returned view points into reader-owned storage and the bitcode buffer, it stays valid until the
+        // next ReadRecord() call.
+        RecordView ReadRecord(uint32_t abbrevid) {
+#if BLVM_DECODE_STATS
+            RecordView record = DecodeRecord(abbrevid);
+            if (stats_)
+                stats_->CountRecord(current_block_->block_id, abbrevid != BuiltinAbbrevId::kUnabbrevRecord, record);
+            return record;
+#else
+            return DecodeRecord(abbrevid);
+#endif
+        }
     private:
-        void FillCurrentWord();
+        static const uint32_t kBitsPerWord = sizeof(word_t) * 8;
+
+        // Loads the next word straight from the buffer, only the last (partial) word goes out-of-line.
+        void FillCurrentWord() {
+            if (buffer_index_ + sizeof(word_t) <= buffer_size_) {
+                memcpy(&current_word_, buffer_data_ + buffer_index_, sizeof(word_t));
+                buffer_index_ += sizeof(word_t);
+                current_word_bits_left_ = kBitsPerWord;
+                return;
+            }
+            FillTailWord();
+        }
+
+        // Continuation bit of every complete chunk that fits in a word, starting from the first one at pos.
+        static constexpr uint64_t VBRContinuationMask(uint32_t width, uint32_t pos) {
+            return pos >= kBitsPerWord ? 0 : (uint64_t(1) << pos) | VBRContinuationMask(width, pos + width);
+        }
+
+        // Portable pext for the regular VBR layout. Step n merges pairs of groups of 2^n chunks: each group
+        // holds its (width - 1) * 2^n payload bits at the bottom, the upper group moves down by 2^n bits.
+        static constexpr uint64_t VBRGroupPayloadMask(uint32_t width, uint32_t step, uint32_t pos) {
+            return pos >= kBitsPerWord ? 0 :
+                   (((uint64_t(1) << ((width - 1) << step)) - 1) << pos) |
+                   VBRGroupPayloadMask(width, step, pos + (width << (step + 1)));
+        }
+
+        template <uint32_t kWidth, uint32_t kStep, bool kHasStep>
+        struct VBRPayloadCompactor {
+            static uint64_t Compact(uint64_t chunks) {
+                static const uint64_t kLowGroups = VBRGroupPayloadMask(kWidth, kStep, 0);
+                static const uint64_t kHighGroups = kLowGroups << (kWidth << kStep);
+                chunks = (chunks & kLowGroups) | ((chunks & kHighGroups) >> (1u << kStep));
+                return VBRPayloadCompactor<kWidth, kStep + 1,
+                                           ((kWidth << (kStep + 1)) < kBitsPerWord)>::Compact(chunks);
+            }
+        };
+
+        template <uint32_t kWidth, uint32_t kStep>
+        struct VBRPayloadCompactor<kWidth, kStep, false> {
+            static uint64_t Compact(uint64_t chunks) {
+                return chunks;
+            }
+        };
+
+        word_t ValidBitsMask() const {
+            return current_word_bits_left_ < kBitsPerWord ?
+                   (word_t(1) << current_word_bits_left_) - 1 : ~word_t(0);
+        }
+
+        // Reloads the cached word so that it starts exactly at the current bit position, at least 57 bits are
+        // cached afterwards. Returns false near the end of the buffer (or window), where the caller has to take
+        // the slow path.
+        bool RefillCurrentWord() {
+            size_t bit_pos = buffer_index_ * 8 - current_word_bits_left_;  // relative to the window
+            size_t byte_pos = bit_pos / 8;
+            if (byte_pos + sizeof(word_t) > buffer_size_)
+                return false;
+            uint32_t skip_bits = (uint32_t)(bit_pos % 8);
+            memcpy(&current_word_, buffer_data_ + byte_pos, sizeof(word_t));
+            current_word_ >>= skip_bits;
+            current_word_bits_left_ = kBitsPerWord - skip_bits;
+            buffer_index_ = byte_pos + sizeof(word_t);
+            return true;
+        }
+
+        void Init();
+        RecordView DecodeRecord(uint32_t abbrevid);
+#if BLVM_DECODE_STATS
+        // Charges the time since the last block transition to the current block.
+        void ChargeBlockTime();
+#endif
+        void FillTailWord();
+        // Whether the input up to end_byte is in memory, a streaming reader waits for it.
+        bool EnsureAvailable(size_t end_byte);
+        bool LoadWindow(size_t keep_from, size_t end_byte);
+        word_t ReadSlow(uint32_t bits);
+        uint64_t ReadVBRSlow(uint32_t bits);
         void SkipTo32bitsBoundary();
-        size_t GetCurrentBitPos();
-        bool IsValidBytePos(size_t byte_pos);
-        void SeekToBitPos(size_t bit_pos);
+        void PushBlockScope(uint32_t block_id, uint32_t abbrevid_length, uint32_t block_size);
         void PopBlockScope();
-        uint64_t ReadAbbrevOp(const AbbrevOp& op);
-        AbbrevRef GetAbbreviationById(uint32_t abbrevid);
+        uint64_t ReadScalarStep(const AbbrevStep& step);
+        template <uint32_t kWidth>
+        void ReadVBRArray(uint32_t element_count, uint64_t* out_ops);
+
+        uint64_t* ReserveRecordOperands(size_t count) {
+            if (count > record_operands_.size())
+                record_operands_.resize(count * 2);
+            return record_operands_.data();
+        }
+
+        uint8_t* ReserveRecordBytes(size_t count) {
+            if (count > record_bytes_.size())
+                record_bytes_.resize(count * 2);
+            return record_bytes_.data();
+        }
+
+        const Abbreviation& GetAbbreviationById(uint32_t abbrevid) {
+            uint32_t abbrev_index = abbrevid - BuiltinAbbrevId::kFirstApplicationAbbrev;
+            if (abbrev_index < current_block_->blockinfo_abbrev_count)
+                return *current_block_->block_info->abbrevs[abbrev_index];
+
+            size_t local_index = current_block_->local_abbrev_begin +
+                                 (abbrev_index - current_block_->blockinfo_abbrev_count);
+            // abbrev_index wraps around for ids below kFirstApplicationAbbrev
+            if (abbrev_index >= abbrevid || local_index >= local_abbrevs_.size())
+                throw ReaderException(ReaderError::kDataError);
+            return *local_abbrevs_[local_index];
+        }
     private:
-        ParsingContext& parsing_context_;
+        const ParsingContext& parsing_context_;
 
-        const base::MemoryBuffer& buffer_;
+        // The input in memory: the whole buffer, or the window of a stream. Indexes are relative to it.
+        const uint8_t* buffer_data_;
+        size_t buffer_size_;
         size_t buffer_index_;
+        size_t window_offset_;  // input offset of buffer_data_[0], 0 unless streaming
+        size_t input_size_;
+
+        base::StreamInput* stream_;
+        size_t retained_depth_;       // scope whose body GetCurrentBlockBody() handed out, 0 if none
+        size_t retained_byte_begin_;
 
         word_t current_word_;
-        size_t current_word_bits_left_;
+        uint32_t current_word_bits_left_;
+
+        // Flat scope stack, slots are reused and only grow. current_block_ points at scopes_[scope_depth_].
+        std::vector<Block> scopes_;
+        size_t scope_depth_;
+        Block* current_block_;
+        // DEFINE_ABBREVs of all open scopes, each scope owns the tail from its local_abbrev_begin.
+        std::vector<AbbrevRef> local_abbrevs_;
+
+        // Reused by every ReadRecord(), only grows.
+        std::vector<uint64_t> record_operands_;
+        std::vector<uint8_t> record_bytes_;
 
-        Block current_block_;
-        std::stack<Block> block_stack_;
+#if BLVM_DECODE_STATS
+        // Private counters, merged into the context's DecodeStats by the destructor. Null if it has none.
+        std::unique_ptr<DecodeStats> stats_;
+        uint64_t stats_clock_;
+#endif
 
         DISALLOW_COPY_AND_ASSIGN(BitcodeReader);
     };
@@ -0,0 +1,70 @@
+#include "bitcode_visitor.hpp"
+#include "bitcode_reader.hpp"
+#include "parsing_context.hpp"
+#include "parsing_exception.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    BitcodeScanner::BitcodeScanner(ParsingContext& parsing_context, BitcodeReader& reader) :
+            parsing_context_(parsing_context), reader_(reader) {
+
+    }
+
+    bool BitcodeScanner::Scan(BitcodeVisitor& visitor) {
+        using Entry = BitcodeReader::Entry;
+
+        if (!reader_.ReadMagic())
+            throw ParserException(ParserError::kDataError);
+
+        // Top level: a sequence of blocks (IDENTIFICATION, MODULE, STRTAB, SYMTAB, ...) up to the end of the file.
+        while (!reader_.AtEndOfStream()) {
+            Entry entry = reader_.ReadNextEntry();
+            if (entry.kind != Entry::Kind::kSubBlock)
+                throw ParserException(ParserError::kDataError);
+
+            if (ScanBlock(visitor, entry.id) == Action::kStop)
+                return false;
+        }
+        return true;
+    }
+
+    BitcodeVisitor::Action BitcodeScanner::ScanBlock(BitcodeVisitor& visitor, uint32_t block_id) {
+        using Entry = BitcodeReader::Entry;
+
+        if (block_id == StandardBlockIds::kBlockInfo) {
+            ReadBlockInfoBlock(reader_, parsing_context_);
+            return Action::kContinue;
+        }
+
+        reader_.EnterSubBlock(block_id);
+        Action action = visitor.OnEnterBlock(block_id, reader_.GetCurrentBitPos(), reader_.GetCurrentBlockSize());
+        while (action == Action::kContinue) {
+            Entry entry = reader_.ReadNextEntry();
+
+            switch (entry.kind) {
+                case Entry::Kind::kError:
+                    throw ParserException(ParserError::kDataError);
+                case Entry::Kind::kEndBlock:
+                    reader_.ReadBlockEnd();
+                    return visitor.OnExitBlock(block_id) == Action::kStop ? Action::kStop : Action::kContinue;
+                case Entry::Kind::kSubBlock:
+                    action = ScanBlock(visitor, entry.id);
+                    continue;
+                case Entry::Kind::kRecord:
+                    break;
+            }
+
+            RecordView record = reader_.ReadRecord(entry.id);
+            action = record.HasBlob() ? visitor.OnBlob(block_id, record) : visitor.OnRecord(block_id, record);
+        }
+
+        if (action == Action::kSkipBlock) {
+            reader_.SkipRestOfBlock();
+            return Action::kContinue;
+        }
+        return Action::kStop;
+    }
+
+}
+}
@@ -0,0 +1,74 @@
+#ifndef _BLVM_BITCODE_BITCODE_VISITOR_HPP
+#define _BLVM_BITCODE_BITCODE_VISITOR_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include "../base/noncopyable.hpp"
+#include "record_view.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    class BitcodeReader;
+    class ParsingContext;
+
+    // Push-style callbacks for BitcodeScanner. Every callback steers the walk with its return value, the
+    // default implementations visit everything.
+    class BitcodeVisitor {
+    public:
+        enum class Action {
+            kContinue,
+            kSkipBlock,  // leave the current block (from OnEnterBlock: do not enter it) via its block size
+            kStop        // end the scan
+        };
+
+        virtual ~BitcodeVisitor() = default;
+
+        // bit_offset points after the ENTER_SUBBLOCK header, block_size is in 32-bit words.
+        virtual Action OnEnterBlock(uint32_t block_id, size_t bit_offset, uint32_t block_size) {
+            return Action::kContinue;
+        }
+
+        // The view is valid only during the call.
+        virtual Action OnRecord(uint32_t block_id, const RecordView& record) {
+            return Action::kContinue;
+        }
+
+        // Records with a blob operand come here instead of OnRecord(). The blob points into the bitcode buffer.
+        virtual Action OnBlob(uint32_t block_id, const RecordView& record) {
+            return OnRecord(block_id, record);
+        }
+
+        // Not called for blocks that were skipped.
+        virtual Action OnExitBlock(uint32_t block_id) {
+            return Action::kContinue;
+        }
+    };
+
+
+    // Walks a whole bitcode file without building any IR. BLOCKINFO blocks are consumed by the scanner
+    // (abbreviations would not resolve without them) and are not reported to the visitor.
+    // Malformed input throws ReaderException or ParserException, like BitcodeParser.
+    class BitcodeScanner {
+    public:
+        BitcodeScanner(ParsingContext& parsing_context, BitcodeReader& reader);
+        ~BitcodeScanner() = default;
+
+        // Starts at the magic number. Returns false if the visitor stopped the scan.
+        bool Scan(BitcodeVisitor& visitor);
+    private:
+        typedef BitcodeVisitor::Action Action;
+
+        // Having read the ENTER_SUBBLOCK abbrevid and the block id.
+        Action ScanBlock(BitcodeVisitor& visitor, uint32_t block_id);
+    private:
+        ParsingContext& parsing_context_;
+        BitcodeReader& reader_;
+
+        DISALLOW_COPY_AND_ASSIGN(BitcodeScanner);
+    };
+
+}
+}
+
+#endif // _BLVM_BITCODE_BITCODE_VISITOR_HPP
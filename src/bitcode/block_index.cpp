@@ -0,0 +1,236 @@
+#include "block_index.hpp"
+#include <cstdio>
+#include <cstring>
+#include "../base/hash.hpp"
+#include "bitcode_base.hpp"
+#include "bitcode_reader.hpp"
+#include "block_info_set.hpp"
+#include "parsing_context.hpp"
+#include "parsing_exception.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    namespace {
+
+        // Sidecar layout, all fields little-endian:
+        //   magic[8] version:u32 entry_count:u32 bitcode_size:u64 bitcode_hash:u64 entries_hash:u64
+        //   entry_count * { bit_offset:u64 block_id:u32 block_size:u32 parent:u32 depth:u32 }
+        const char kIndexMagic[8] = {'B', 'L', 'V', 'M', 'B', 'I', 'D', 'X'};
+        const uint32_t kIndexVersion = 1;
+        const size_t kHeaderSize = 40;
+        const size_t kEntrySize = 24;
+
+        void PutLE(std::vector<uint8_t>& out, uint64_t value, size_t bytes) {
+            for (size_t i = 0; i < bytes; i++)
+                out.push_back((uint8_t)(value >> (i * 8)));
+        }
+
+        uint64_t GetLE(const uint8_t* data, size_t bytes) {
+            uint64_t value = 0;
+            for (size_t i = 0; i < bytes; i++)
+                value |= (uint64_t)data[i] << (i * 8);
+            return value;
+        }
+
+        class IndexWalker {
+        public:
+            IndexWalker(ParsingContext& parsing_context, BitcodeReader& reader, uint32_t max_depth,
+                        std::vector<BlockIndexEntry>& entries) :
+                    parsing_context_(parsing_context), reader_(reader), max_depth_(max_depth), entries_(entries) {}
+
+            // Having read the ENTER_SUBBLOCK abbrevid and the block id.
+            void IndexBlock(uint32_t block_id, uint32_t parent, uint32_t depth) {
+                using Entry = BitcodeReader::Entry;
+
+                BlockIndexEntry index_entry;
+                index_entry.bit_offset = reader_.GetCurrentBitPos();
+                index_entry.block_id = block_id;
+                index_entry.parent = parent;
+                index_entry.depth = depth;
+
+                reader_.EnterSubBlock(block_id);
+                index_entry.block_size = reader_.GetCurrentBlockSize();
+                uint32_t self = (uint32_t)entries_.size();
+                entries_.push_back(index_entry);
+
+                if (block_id == StandardBlockIds::kBlockInfo) {
+                    // Later records may use its abbrevs, read it for real.
+                    reader_.SkipRestOfBlock();
+                    reader_.SeekToBitPos(index_entry.bit_offset);
+                    ReadBlockInfoBlock(reader_, parsing_context_);
+                    return;
+                }
+                if (depth >= max_depth_) {
+                    reader_.SkipRestOfBlock();
+                    return;
+                }
+
+                while (true) {
+                    Entry entry = reader_.ReadNextEntry();
+
+                    switch (entry.kind) {
+                        case Entry::Kind::kError:
+                            throw ParserException(ParserError::kDataError);
+                        case Entry::Kind::kEndBlock:
+                            reader_.ReadBlockEnd();
+                            return;
+                        case Entry::Kind::kSubBlock:
+                            IndexBlock(entry.id, self, depth + 1);
+                            break;
+                        case Entry::Kind::kRecord:
+                            reader_.ReadRecord(entry.id);
+                            break;
+                    }
+                }
+            }
+        private:
+            ParsingContext& parsing_context_;
+            BitcodeReader& reader_;
+            uint32_t max_depth_;
+            std::vector<BlockIndexEntry>& entries_;
+
+            DISALLOW_COPY_AND_ASSIGN(IndexWalker);
+        };
+
+    }
+
+    BlockIndex::BlockIndex(size_t bitcode_size, uint64_t bitcode_hash) :
+            bitcode_size_(bitcode_size), bitcode_hash_(bitcode_hash) {
+
+    }
+
+    uint64_t BlockIndex::HashBitcode(const base::MemoryBuffer& bitcode_buffer) {
+        return base::HashBytes(bitcode_buffer.begin(), bitcode_buffer.size());
+    }
+
+    void BlockIndex::AddEntry(const BlockIndexEntry& entry) {
+        entries_by_id_[entry.block_id].push_back((uint32_t)entries_.size());
+        entries_.push_back(entry);
+    }
+
+    BlockIndexRef BlockIndex::Build(ParsingContext& parsing_context, BitcodeReader& reader, uint32_t max_depth) {
+        using Entry = BitcodeReader::Entry;
+
+        const base::MemoryBuffer& bitcode_buffer = *parsing_context.GetBitcodeBuffer();
+        if (!reader.ReadMagic())
+            throw ParserException(ParserError::kDataError);
+
+        std::vector<BlockIndexEntry> entries;
+        IndexWalker walker(parsing_context, reader, max_depth, entries);
+        while (!reader.AtEndOfStream()) {
+            Entry entry = reader.ReadNextEntry();
+            if (entry.kind != Entry::Kind::kSubBlock)
+                throw ParserException(ParserError::kDataError);
+            walker.IndexBlock(entry.id, kNoParent, 0);
+        }
+
+        base::RefPtr<BlockIndex> index = new BlockIndex(bitcode_buffer.size(), HashBitcode(bitcode_buffer));
+        index->entries_.reserve(entries.size());
+        for (const BlockIndexEntry& entry : entries)
+            index->AddEntry(entry);
+        return index;
+    }
+
+    bool BlockIndex::SaveToFile(const char* filename) const {
+        std::vector<uint8_t> data;
+        data.reserve(kHeaderSize + entries_.size() * kEntrySize);
+
+        data.insert(data.end(), kIndexMagic, kIndexMagic + sizeof(kIndexMagic));
+        PutLE(data, kIndexVersion, 4);
+        PutLE(data, entries_.size(), 4);
+        PutLE(data, bitcode_size_, 8);
+        PutLE(data, bitcode_hash_, 8);
+        PutLE(data, 0, 8);  // entries_hash, filled in below
+        for (const BlockIndexEntry& entry : entries_) {
+            PutLE(data, entry.bit_offset, 8);
+            PutLE(data, entry.block_id, 4);
+            PutLE(data, entry.block_size, 4);
+            PutLE(data, entry.parent, 4);
+            PutLE(data, entry.depth, 4);
+        }
+
+        uint64_t entries_hash = base::HashBytes(data.data() + kHeaderSize, data.size() - kHeaderSize);
+        for (size_t i = 0; i < 8; i++)
+            data[32 + i] = (uint8_t)(entries_hash >> (i * 8));
+
+        FILE* file = fopen(filename, "wb");
+        if (!file)
+            return false;
+        bool succeeded = fwrite(data.data(), 1, data.size(), file) == data.size();
+        succeeded = (fclose(file) == 0) && succeeded;
+        if (!succeeded)
+            remove(filename);
+        return succeeded;
+    }
+
+    BlockIndexRef BlockIndex::LoadFromFile(const char* filename, const base::MemoryBuffer& bitcode_buffer) {
+        base::MemoryBuffer file = base::MemoryBuffer::OpenFile(filename);
+        if (!file.IsValid() || file.size() < kHeaderSize)
+            return nullptr;
+
+        const uint8_t* data = file.begin();
+        if (memcmp(data, kIndexMagic, sizeof(kIndexMagic)) != 0 || GetLE(data + 8, 4) != kIndexVersion)
+            return nullptr;
+
+        size_t entry_count = (size_t)GetLE(data + 12, 4);
+        if (file.size() != kHeaderSize + entry_count * kEntrySize ||
+            GetLE(data + 32, 8) != base::HashBytes(data + kHeaderSize, file.size() - kHeaderSize))
+            return nullptr;
+        // Cheap size check first, the hash reads the whole bitcode.
+        if (GetLE(data + 16, 8) != bitcode_buffer.size() || GetLE(data + 24, 8) != HashBitcode(bitcode_buffer))
+            return nullptr;
+
+        base::RefPtr<BlockIndex> index = new BlockIndex(bitcode_buffer.size(), GetLE(data + 24, 8));
+        index->entries_.reserve(entry_count);
+        uint64_t bitcode_bits = (uint64_t)bitcode_buffer.size() * 8;
+
+        for (size_t i = 0; i < entry_count; i++) {
+            const uint8_t* p = data + kHeaderSize + i * kEntrySize;
+            BlockIndexEntry entry;
+            entry.bit_offset = GetLE(p, 8);
+            entry.block_id = (uint32_t)GetLE(p + 8, 4);
+            entry.block_size = (uint32_t)GetLE(p + 12, 4);
+            entry.parent = (uint32_t)GetLE(p + 16, 4);
+            entry.depth = (uint32_t)GetLE(p + 20, 4);
+
+            // Entries come in file order, a parent always precedes its children.
+            bool valid_parent = entry.parent == kNoParent ? entry.depth == 0 :
+                                entry.parent < i && entry.depth == index->entries_[entry.parent].depth + 1;
+            if (entry.bit_offset >= bitcode_bits || !valid_parent)
+                return nullptr;
+            index->AddEntry(entry);
+        }
+        return index;
+    }
+
+    BlockIndexRef BlockIndex::LoadOrBuild(ParsingContext& parsing_context, const char* filename) {
+        BlockIndexRef index = LoadFromFile(filename, *parsing_context.GetBitcodeBuffer());
+        if (index)
+            return index;
+
+        try {
+            BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
+            index = Build(parsing_context, reader);
+        } catch (ReaderException&) {
+            return nullptr;
+        } catch (ParserException&) {
+            return nullptr;
+        }
+        index->SaveToFile(filename);
+        return index;
+    }
+
+    const std::vector<uint32_t>& BlockIndex::GetEntriesById(uint32_t block_id) const {
+        static const std::vector<uint32_t> kNoEntries;
+        auto iter = entries_by_id_.find(block_id);
+        return iter != entries_by_id_.end() ? iter->second : kNoEntries;
+    }
+
+    const BlockIndexEntry* BlockIndex::FindFirst(uint32_t block_id) const {
+        const std::vector<uint32_t>& found = GetEntriesById(block_id);
+        return found.empty() ? nullptr : &entries_[found.front()];
+    }
+
+}
+}
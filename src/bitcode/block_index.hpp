@@ -0,0 +1,81 @@
+#ifndef _BLVM_BITCODE_BLOCK_INDEX_HPP
+#define _BLVM_BITCODE_BLOCK_INDEX_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "../base/noncopyable.hpp"
+#include "../base/memory_buffer.hpp"
+#include "../base/ref_base.hpp"
+#include "../base/ref_ptr.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    class BitcodeReader;
+    class ParsingContext;
+
+    struct BlockIndexEntry {
+        uint64_t bit_offset;  // right after the block id, where BitcodeReader::EnterSubBlock() resumes
+        uint32_t block_id;
+        uint32_t block_size;  // in 32-bit words
+        uint32_t parent;      // entry of the enclosing block, BlockIndex::kNoParent at the top level
+        uint32_t depth;       // 0 at the top level
+    };
+
+    class BlockIndex;
+    typedef base::RefPtr<const BlockIndex> BlockIndexRef;
+
+    // Offsets of the blocks of a bitcode file, in file order, so that a later load can seek straight to
+    // a block: SeekToBitPos(entry.bit_offset), then EnterSubBlock(entry.block_id) or a parser for it.
+    // Decoding a block may need the BLOCKINFO abbrevs, which is indexed like any other block.
+    class BlockIndex : public base::RefBase {
+    public:
+        static const uint32_t kNoParent = ~uint32_t(0);
+        // Top-level blocks and the children of MODULE_BLOCK. Going deeper means decoding every function body.
+        static const uint32_t kDefaultMaxDepth = 1;
+
+        virtual ~BlockIndex() override = default;
+
+        // Walks the records of blocks above max_depth (which is needed to find their sub-blocks), blocks at
+        // max_depth are recorded and skipped by their size. Starts at the magic number, reads BLOCKINFO into
+        // parsing_context on the way. Throws ReaderException or ParserException on malformed input.
+        static BlockIndexRef Build(ParsingContext& parsing_context, BitcodeReader& reader,
+                                   uint32_t max_depth = kDefaultMaxDepth);
+
+        // Sidecar file, tied to the size and content hash of the bitcode it was built from.
+        bool SaveToFile(const char* filename) const;
+        // nullptr if the file is missing, malformed, or was built from a different bitcode.
+        static BlockIndexRef LoadFromFile(const char* filename, const base::MemoryBuffer& bitcode_buffer);
+        // The index in filename if it matches the bitcode of parsing_context, otherwise a new one, which is
+        // saved to filename (a failure to write it is ignored). nullptr if the bitcode cannot be indexed.
+        static BlockIndexRef LoadOrBuild(ParsingContext& parsing_context, const char* filename);
+
+        const std::vector<BlockIndexEntry>& GetEntries() const {
+            return entries_;
+        }
+
+        // Entries of all blocks with that id, in file order: GetEntriesById(kFunctionBlock)[n] is the n-th body.
+        const std::vector<uint32_t>& GetEntriesById(uint32_t block_id) const;
+
+        // First block with that id, nullptr if there is none.
+        const BlockIndexEntry* FindFirst(uint32_t block_id) const;
+    private:
+        BlockIndex(size_t bitcode_size, uint64_t bitcode_hash);
+        void AddEntry(const BlockIndexEntry& entry);
+
+        static uint64_t HashBitcode(const base::MemoryBuffer& bitcode_buffer);
+    private:
+        size_t bitcode_size_;
+        uint64_t bitcode_hash_;
+        std::vector<BlockIndexEntry> entries_;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> entries_by_id_;
+
+        DISALLOW_COPY_AND_ASSIGN(BlockIndex);
+    };
+
+}
+}
+
+#endif // _BLVM_BITCODE_BLOCK_INDEX_HPP
@@ -0,0 +1,130 @@
+#include "block_info_set.hpp"
+#include <cstring>
+#include "../base/hash.hpp"
+#include "bitcode_reader.hpp"
+#include "parsing_context.hpp"
+#include "parsing_exception.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    BlockInfo* BlockInfoSet::GetOrCreateBlockInfo(uint32_t block_id) {
+        if (block_id > kMaxBlockId)
+            return nullptr;
+        if (block_id >= table_.size())
+            table_.resize(block_id + 1);
+
+        std::unique_ptr<BlockInfo>& slot = table_[block_id];
+        if (!slot) {
+            slot.reset(new BlockInfo());
+            slot->block_id = block_id;
+        }
+        return slot.get();
+    }
+
+    BlockInfoSetRef BlockInfoCache::Find(const uint8_t* block_data, size_t block_size) {
+        uint64_t hash = base::HashBytes(block_data, block_size);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto range = entries_.equal_range(hash);
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            const std::vector<uint8_t>& contents = iter->second.block_contents;
+            if (contents.size() == block_size && memcmp(contents.data(), block_data, block_size) == 0) {
+                hit_count_++;
+                return iter->second.block_infos;
+            }
+        }
+        return nullptr;
+    }
+
+    void BlockInfoCache::Insert(const uint8_t* block_data, size_t block_size, const BlockInfoSetRef& block_infos) {
+        Entry entry;
+        entry.block_contents.assign(block_data, block_data + block_size);
+        entry.block_infos = block_infos;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.emplace(base::HashBytes(block_data, block_size), std::move(entry));
+    }
+
+    void ReadBlockInfoBlock(BitcodeReader& reader, ParsingContext& parsing_context) {
+        using Entry = BitcodeReader::Entry;
+
+        // Only the first BLOCKINFO of a stream is used.
+        if (parsing_context.HasBlockInfos()) {
+            reader.SkipSubBlock(StandardBlockIds::kBlockInfo);
+            return;
+        }
+
+        reader.EnterSubBlock(StandardBlockIds::kBlockInfo);
+
+        // Identical BLOCKINFO bytes always parse to the same set, reuse it when another context already has.
+        ByteSpan block_body = reader.GetCurrentBlockBody();
+        const BlockInfoCacheRef& cache = parsing_context.GetBlockInfoCache();
+        if (cache) {
+            BlockInfoSetRef cached = cache->Find(block_body.data, block_body.size);
+            if (cached) {
+                parsing_context.SetBlockInfoSet(cached);
+                reader.SkipRestOfBlock();
+                return;
+            }
+        }
+
+        base::RefPtr<BlockInfoSet> block_infos = new BlockInfoSet();
+        BlockInfo* target_blockinfo = nullptr;
+
+        while (true) {
+            Entry entry = reader.ReadNextEntry(BitcodeReader::kDontProcessAbbrevDefinitions);
+
+            switch (entry.kind) {
+                case Entry::Kind::kError:
+                    throw ParserException(ParserError::kDataError);
+                case Entry::Kind::kSubBlock:
+                    reader.SkipSubBlock(entry.id);  // unknown content, skip it
+                    continue;
+                case Entry::Kind::kEndBlock:
+                    reader.ReadBlockEnd();
+                    parsing_context.SetBlockInfoSet(block_infos);
+                    if (cache)
+                        cache->Insert(block_body.data, block_body.size, block_infos);
+                    return;
+                case Entry::Kind::kRecord:
+                    break;
+            }
+
+            if (entry.id == BuiltinAbbrevId::kDefineAbbrev) {
+                if (target_blockinfo == nullptr)
+                    throw ParserException(ParserError::kDataError);
+
+                AbbrevRef abbrev = reader.ReadAbbrevDefinition();
+                target_blockinfo->abbrevs.push_back(std::move(abbrev));
+                continue;
+            }
+
+            RecordView ops = reader.ReadRecord(entry.id);
+
+            switch (static_cast<BlockInfoCodes>(ops.GetCode())) {
+                case BlockInfoCodes::kSetBID:
+                    if (ops.empty())
+                        throw ParserException(ParserError::kDataError);
+                    target_blockinfo = ops[0] <= BlockInfoSet::kMaxBlockId ?
+                                       block_infos->GetOrCreateBlockInfo((uint32_t)ops[0]) : nullptr;
+                    if (target_blockinfo == nullptr)
+                        throw ParserException(ParserError::kDataError);
+                    break;
+                case BlockInfoCodes::kBlockName:
+                    if (target_blockinfo == nullptr)
+                        throw ParserException(ParserError::kDataError);
+                    target_blockinfo->block_name = ops.ToString();
+                    break;
+                case BlockInfoCodes::kSetRecordName: {
+                    if (target_blockinfo == nullptr || ops.empty())
+                        throw ParserException(ParserError::kDataError);
+                    target_blockinfo->record_names.push_back(std::make_pair((uint32_t)ops[0], ops.ToString(1)));
+                    break;
+                }
+            }
+        }
+    }
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef _BLVM_BITCODE_BLOCK_INFO_SET_HPP
+#define _BLVM_BITCODE_BLOCK_INFO_SET_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "../base/noncopyable.hpp"
+#include "../base/ref_base.hpp"
+#include "../base/ref_ptr.hpp"
+#include "bitcode_base.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    // The parsed BLOCKINFO block of a bitstream, indexed directly by block id.
+    // Filled in by the parser, then published to a ParsingContext as const and never changed again, so one
+    // set can be shared by any number of contexts and reader threads.
+    class BlockInfoSet : public base::RefBase {
+    public:
+        // Block ids are small in practice, larger SETBIDs are rejected instead of growing the table.
+        static const uint32_t kMaxBlockId = 1024;
+
+        BlockInfoSet() = default;
+        virtual ~BlockInfoSet() override = default;
+
+        const BlockInfo* GetBlockInfo(uint32_t block_id) const {
+            return block_id < table_.size() ? table_[block_id].get() : nullptr;
+        }
+
+        // While building only. Returns nullptr if block_id exceeds kMaxBlockId.
+        BlockInfo* GetOrCreateBlockInfo(uint32_t block_id);
+    private:
+        std::vector<std::unique_ptr<BlockInfo>> table_;
+
+        DISALLOW_COPY_AND_ASSIGN(BlockInfoSet);
+    };
+
+    typedef base::RefPtr<const BlockInfoSet> BlockInfoSetRef;
+
+
+    // Parsed BLOCKINFO sets keyed by the raw bytes of their block. Modules written by the same producer
+    // carry byte-identical BLOCKINFO blocks, a context with a cache attached reuses the first parse.
+    // Thread safe.
+    class BlockInfoCache : public base::RefBase {
+    public:
+        BlockInfoCache() = default;
+        virtual ~BlockInfoCache() override = default;
+
+        // nullptr if no block with exactly these contents was inserted.
+        BlockInfoSetRef Find(const uint8_t* block_data, size_t block_size);
+        void Insert(const uint8_t* block_data, size_t block_size, const BlockInfoSetRef& block_infos);
+
+        size_t GetHitCount() const {
+            return hit_count_;
+        }
+    private:
+        struct Entry {
+            std::vector<uint8_t> block_contents;
+            BlockInfoSetRef block_infos;
+        };
+
+        std::mutex mutex_;
+        std::unordered_multimap<uint64_t, Entry> entries_;
+        size_t hit_count_ = 0;
+
+        DISALLOW_COPY_AND_ASSIGN(BlockInfoCache);
+    };
+
+    typedef base::RefPtr<BlockInfoCache> BlockInfoCacheRef;
+
+
+    class BitcodeReader;
+    class ParsingContext;
+
+    // Having read the ENTER_SUBBLOCK abbrevid and the BLOCKINFO block id: reads the whole block and publishes the
+    // result to parsing_context, or reuses an identical set from its cache. Throws ParserException on bad data.
+    void ReadBlockInfoBlock(BitcodeReader& reader, ParsingContext& parsing_context);
+
+}
+}
+
+#endif // _BLVM_BITCODE_BLOCK_INFO_SET_HPP
@@ -0,0 +1,58 @@
+#include "constants_block.hpp"
+#include "bitcode_reader.hpp"
+#include "parsing_exception.hpp"
+#include "../core/type.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    void ReadConstantsBlock(BitcodeReader& reader, const std::vector<core::TypeRef>& type_table,
+                            std::vector<core::ConstantRecord>& out_records, std::vector<uint64_t>& out_operands) {
+        using Entry = BitcodeReader::Entry;
+
+        reader.EnterSubBlock(BlockIds::kConstantBlock);
+
+        // LLVM writes a SETTYPE before the first constant and whenever the type changes.
+        core::TypeRef current_type = nullptr;
+
+        while (true) {
+            Entry entry = reader.ReadNextEntry();
+
+            switch (entry.kind) {
+                case Entry::Kind::kError:
+                    throw ParserException(ParserError::kDataError);
+                case Entry::Kind::kSubBlock:
+                    reader.SkipSubBlock(entry.id);
+                    continue;
+                case Entry::Kind::kEndBlock:
+                    reader.ReadBlockEnd();
+                    return;
+                case Entry::Kind::kRecord:
+                    break;
+            }
+
+            RecordView ops = reader.ReadRecord(entry.id);
+            ConstantsCodes code = static_cast<ConstantsCodes>(ops.GetCode());
+            if (code == ConstantsCodes::kSetType) {
+                if (ops.empty() || ops[0] >= type_table.size())
+                    throw ParserException(ParserError::kDataError);
+                current_type = type_table[ops[0]];
+                TypeCodes type_code = current_type->GetTypeCode();
+                if (type_code == TypeCodes::kVoid || type_code == TypeCodes::kLabel ||
+                    type_code == TypeCodes::kFunction)
+                    throw ParserException(ParserError::kDataError);
+                continue;
+            }
+
+            // Every other record is a value, codes that are not evaluated included.
+            if (current_type == nullptr || out_operands.size() + ops.size() > UINT32_MAX)
+                throw ParserException(ParserError::kDataError);
+            core::ConstantRecord record = {current_type, code, (uint32_t)out_operands.size(), (uint32_t)ops.size()};
+            for (size_t i = 0; i < ops.size(); i++)
+                out_operands.push_back(ops[i]);
+            out_records.push_back(record);
+        }
+    }
+
+}
+}
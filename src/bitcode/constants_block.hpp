@@ -0,0 +1,23 @@
+#ifndef _BLVM_BITCODE_CONSTANTS_BLOCK_HPP
+#define _BLVM_BITCODE_CONSTANTS_BLOCK_HPP
+
+#include <cstdint>
+#include <vector>
+#include "../core/constant.hpp"
+#include "../core/core_fwd.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    class BitcodeReader;
+
+    // Having read the ENTER_SUBBLOCK abbrevid and the CONSTANTS block id: appends one record per constant, in
+    // value id order, and copies their operands to out_operands. Types are looked up in type_table. The
+    // constants are evaluated later, see core::WriteConstantImage(). Throws ParserException on bad data.
+    void ReadConstantsBlock(BitcodeReader& reader, const std::vector<core::TypeRef>& type_table,
+                            std::vector<core::ConstantRecord>& out_records, std::vector<uint64_t>& out_operands);
+
+}
+}
+
+#endif // _BLVM_BITCODE_CONSTANTS_BLOCK_HPP
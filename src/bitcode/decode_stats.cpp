@@ -0,0 +1,198 @@
+#include "decode_stats.hpp"
+#include <algorithm>
+#include <utility>
+#include "bitcode_llvm.hpp"
+#include "record_view.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    namespace {
+
+        const char* GetBlockName(uint32_t block_id) {
+            switch (block_id) {
+                case StandardBlockIds::kBlockInfo: return "BLOCKINFO";
+                case BlockIds::kModuleBlock: return "MODULE";
+                case BlockIds::kParamattrBlock: return "PARAMATTR";
+                case BlockIds::kParamattrGroupBlock: return "PARAMATTR_GROUP";
+                case BlockIds::kConstantBlock: return "CONSTANTS";
+                case BlockIds::kFunctionBlock: return "FUNCTION";
+                case BlockIds::kIdentificationBlock: return "IDENTIFICATION";
+                case BlockIds::kValueSymtabBlock: return "VALUE_SYMTAB";
+                case BlockIds::kMetadataBlock: return "METADATA";
+                case BlockIds::kMetadataAttachment: return "METADATA_ATTACHMENT";
+                case BlockIds::kTypeBlock: return "TYPE";
+                case BlockIds::kUselistBlock: return "USELIST";
+                case BlockIds::kModuleStrtabBlock: return "MODULE_STRTAB";
+                case BlockIds::kGlobalValSummaryBlock: return "GLOBALVAL_SUMMARY";
+                case BlockIds::kOperandBundleTagsBlock: return "OPERAND_BUNDLE_TAGS";
+                case BlockIds::kMetadataKindBlock: return "METADATA_KIND";
+                case BlockIds::kStrtabBlock: return "STRTAB";
+                case BlockIds::kFullLtoGlobalValSummaryBlock: return "FULL_LTO_GLOBALVAL_SUMMARY";
+                case BlockIds::kSymtabBlock: return "SYMTAB";
+                case BlockIds::kSyncScopeNamesBlock: return "SYNC_SCOPE_NAMES";
+                default: return "?";
+            }
+        }
+
+        const char* GetPhaseName(size_t phase) {
+            switch ((DecodePhase)phase) {
+                case DecodePhase::kModule: return "module";
+                case DecodePhase::kTypeLayout: return "type_layout";
+                case DecodePhase::kFunctionBody: return "function_body";
+                default: return "?";
+            }
+        }
+
+        // (code, count) of the non-zero histogram entries, most frequent first.
+        std::vector<std::pair<uint32_t, uint64_t>> SortedCodes(const BlockDecodeStats& block) {
+            std::vector<std::pair<uint32_t, uint64_t>> codes;
+            for (size_t code = 0; code < block.record_codes.size(); code++) {
+                if (block.record_codes[code] != 0)
+                    codes.push_back(std::make_pair((uint32_t)code, block.record_codes[code]));
+            }
+            std::stable_sort(codes.begin(), codes.end(),
+                             [](const std::pair<uint32_t, uint64_t>& lhs, const std::pair<uint32_t, uint64_t>& rhs) {
+                                 return lhs.second > rhs.second;
+                             });
+            return codes;
+        }
+
+        double ToMilliseconds(uint64_t nanoseconds) {
+            return (double)nanoseconds / 1e6;
+        }
+
+    }
+
+    BlockDecodeStats::BlockDecodeStats() :
+            block_count(0), skipped_count(0), bytes(0), records(0), abbreviated_records(0),
+            unabbreviated_records(0), operands(0), blobs(0), blob_bytes(0), nanoseconds(0), other_codes(0) {}
+
+    void BlockDecodeStats::Merge(const BlockDecodeStats& other) {
+        block_count += other.block_count;
+        skipped_count += other.skipped_count;
+        bytes += other.bytes;
+        records += other.records;
+        abbreviated_records += other.abbreviated_records;
+        unabbreviated_records += other.unabbreviated_records;
+        operands += other.operands;
+        blobs += other.blobs;
+        blob_bytes += other.blob_bytes;
+        nanoseconds += other.nanoseconds;
+        other_codes += other.other_codes;
+        if (record_codes.size() < other.record_codes.size())
+            record_codes.resize(other.record_codes.size(), 0);
+        for (size_t code = 0; code < other.record_codes.size(); code++)
+            record_codes[code] += other.record_codes[code];
+    }
+
+    DecodeStats::DecodeStats() {
+        std::fill(phase_nanoseconds_, phase_nanoseconds_ + (size_t)DecodePhase::kCount, 0);
+    }
+
+    void DecodeStats::CountRecord(uint32_t block_id, bool is_abbreviated, const RecordView& record) {
+        BlockDecodeStats& block = GetBlock(block_id);
+        block.records++;
+        if (is_abbreviated)
+            block.abbreviated_records++;
+        else
+            block.unabbreviated_records++;
+        // blob bytes are counted separately
+        block.operands += record.HasBlob() ? record.GetScalarCount() : record.size();
+        if (record.HasBlob()) {
+            block.blobs++;
+            block.blob_bytes += record.GetBlob().size;
+        }
+
+        uint32_t code = record.GetCode();
+        if (code >= BlockDecodeStats::kMaxHistogramCode) {
+            block.other_codes++;
+            return;
+        }
+        if (code >= block.record_codes.size())
+            block.record_codes.resize(code + 1, 0);
+        block.record_codes[code]++;
+    }
+
+    void DecodeStats::AddPhaseTime(DecodePhase phase, uint64_t nanoseconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        phase_nanoseconds_[(size_t)phase] += nanoseconds;
+    }
+
+    void DecodeStats::Merge(const DecodeStats& other) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (blocks_.size() < other.blocks_.size())
+            blocks_.resize(other.blocks_.size());
+        for (size_t i = 0; i < other.blocks_.size(); i++)
+            blocks_[i].Merge(other.blocks_[i]);
+        for (size_t i = 0; i < (size_t)DecodePhase::kCount; i++)
+            phase_nanoseconds_[i] += other.phase_nanoseconds_[i];
+    }
+
+    void DecodeStats::PrintTable(FILE* out) const {
+        fprintf(out, "%-20s %8s %8s %12s %10s %10s %10s %12s %7s %10s\n", "block", "count", "skipped", "bytes",
+                "records", "abbrev", "unabbrev", "operands", "blobs", "self ms");
+        for (size_t id = 0; id < blocks_.size(); id++) {
+            const BlockDecodeStats& block = blocks_[id];
+            if (block.block_count == 0 && block.records == 0)
+                continue;
+            fprintf(out, "%-20s %8llu %8llu %12llu %10llu %10llu %10llu %12llu %7llu %10.3f\n",
+                    GetBlockName((uint32_t)id), (unsigned long long)block.block_count,
+                    (unsigned long long)block.skipped_count, (unsigned long long)block.bytes,
+                    (unsigned long long)block.records, (unsigned long long)block.abbreviated_records,
+                    (unsigned long long)block.unabbreviated_records, (unsigned long long)block.operands,
+                    (unsigned long long)block.blobs, ToMilliseconds(block.nanoseconds));
+        }
+
+        fprintf(out, "\n%-20s %10s\n", "phase", "ms");
+        for (size_t phase = 0; phase < (size_t)DecodePhase::kCount; phase++)
+            fprintf(out, "%-20s %10.3f\n", GetPhaseName(phase), ToMilliseconds(phase_nanoseconds_[phase]));
+
+        for (size_t id = 0; id < blocks_.size(); id++) {
+            const BlockDecodeStats& block = blocks_[id];
+            if (block.records == 0)
+                continue;
+            fprintf(out, "\nrecord codes of %s:", GetBlockName((uint32_t)id));
+            for (const std::pair<uint32_t, uint64_t>& code : SortedCodes(block))
+                fprintf(out, " %u:%llu", code.first, (unsigned long long)code.second);
+            if (block.other_codes != 0)
+                fprintf(out, " other:%llu", (unsigned long long)block.other_codes);
+            fprintf(out, "\n");
+        }
+    }
+
+    void DecodeStats::PrintJson(FILE* out) const {
+        fprintf(out, "{\"blocks\": [");
+        const char* separator = "";
+        for (size_t id = 0; id < blocks_.size(); id++) {
+            const BlockDecodeStats& block = blocks_[id];
+            if (block.block_count == 0 && block.records == 0)
+                continue;
+            fprintf(out, "%s\n  {\"id\": %u, \"name\": \"%s\", \"count\": %llu, \"skipped\": %llu, \"bytes\": %llu, "
+                         "\"records\": %llu, \"abbreviated\": %llu, \"unabbreviated\": %llu, \"operands\": %llu, "
+                         "\"blobs\": %llu, \"blob_bytes\": %llu, \"self_ns\": %llu, \"record_codes\": {",
+                    separator, (uint32_t)id, GetBlockName((uint32_t)id), (unsigned long long)block.block_count,
+                    (unsigned long long)block.skipped_count, (unsigned long long)block.bytes,
+                    (unsigned long long)block.records, (unsigned long long)block.abbreviated_records,
+                    (unsigned long long)block.unabbreviated_records, (unsigned long long)block.operands,
+                    (unsigned long long)block.blobs, (unsigned long long)block.blob_bytes,
+                    (unsigned long long)block.nanoseconds);
+            const char* code_separator = "";
+            for (const std::pair<uint32_t, uint64_t>& code : SortedCodes(block)) {
+                fprintf(out, "%s\"%u\": %llu", code_separator, code.first, (unsigned long long)code.second);
+                code_separator = ", ";
+            }
+            fprintf(out, "}, \"other_codes\": %llu}", (unsigned long long)block.other_codes);
+            separator = ",";
+        }
+
+        fprintf(out, "\n], \"phases_ns\": {");
+        for (size_t phase = 0; phase < (size_t)DecodePhase::kCount; phase++) {
+            fprintf(out, "%s\"%s\": %llu", phase == 0 ? "" : ", ", GetPhaseName(phase),
+                    (unsigned long long)phase_nanoseconds_[phase]);
+        }
+        fprintf(out, "}}\n");
+    }
+
+}
+}
@@ -0,0 +1,117 @@
+#ifndef _BLVM_BITCODE_DECODE_STATS_HPP
+#define _BLVM_BITCODE_DECODE_STATS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include "../base/noncopyable.hpp"
+
+// Build with -DBLVM_DECODE_STATS=1 (CMake option BLVM_DECODE_STATS) to collect decode statistics. Otherwise
+// the hooks in BitcodeReader and the parsers are compiled out and a DecodeStats stays empty.
+#ifndef BLVM_DECODE_STATS
+    #define BLVM_DECODE_STATS 0
+#endif
+
+namespace blvm {
+namespace bitcode {
+
+    class RecordView;
+
+    // Counters of one block id. Bytes are the declared body sizes, nested blocks included. Time is exclusive:
+    // nested blocks are charged to themselves.
+    struct BlockDecodeStats {
+        static const uint32_t kMaxHistogramCode = 1024;  // record codes above go to other_codes
+
+        uint64_t block_count;
+        uint64_t skipped_count;  // of block_count, skipped by size without being entered
+        uint64_t bytes;
+        uint64_t records;
+        uint64_t abbreviated_records;
+        uint64_t unabbreviated_records;
+        uint64_t operands;
+        uint64_t blobs;
+        uint64_t blob_bytes;
+        uint64_t nanoseconds;
+        std::vector<uint64_t> record_codes;  // record code -> count, grows on demand
+        uint64_t other_codes;
+
+        BlockDecodeStats();
+        void Merge(const BlockDecodeStats& other);
+    };
+
+    // Steps timed by the parsers, summed over threads. Phases nest: the type layout is part of the module.
+    enum class DecodePhase {
+        kModule,        // BitcodeParser::Parse(), function bodies skipped
+        kTypeLayout,    // computing type sizes after the module block
+        kFunctionBody,  // FunctionBlockParser, lazily or through MaterializeAll()
+        kCount
+    };
+
+    // Collected per BitcodeReader and merged into the DecodeStats of its ParsingContext when the reader goes
+    // away, so readers on several threads can share one DecodeStats.
+    class DecodeStats {
+    public:
+        DecodeStats();
+        ~DecodeStats() = default;
+
+        static constexpr bool IsEnabled() {
+            return BLVM_DECODE_STATS != 0;
+        }
+
+        static uint64_t Now() {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        BlockDecodeStats& GetBlock(uint32_t block_id) {
+            if (block_id >= blocks_.size())
+                blocks_.resize(block_id + 1);
+            return blocks_[block_id];
+        }
+
+        void CountRecord(uint32_t block_id, bool is_abbreviated, const RecordView& record);
+
+        // Thread safe, unlike the counters.
+        void AddPhaseTime(DecodePhase phase, uint64_t nanoseconds);
+        void Merge(const DecodeStats& other);
+
+        // The table lists every block id that was seen, followed by its record code histogram.
+        void PrintTable(FILE* out) const;
+        void PrintJson(FILE* out) const;
+    private:
+        std::vector<BlockDecodeStats> blocks_;
+        uint64_t phase_nanoseconds_[(size_t)DecodePhase::kCount];
+        std::mutex mutex_;
+
+        DISALLOW_COPY_AND_ASSIGN(DecodeStats);
+    };
+
+
+    // Adds the lifetime of the scope to a phase, nothing when stats is null or collection is compiled out.
+    class ScopedDecodePhase {
+    public:
+#if BLVM_DECODE_STATS
+        ScopedDecodePhase(DecodeStats* stats, DecodePhase phase) :
+                stats_(stats), phase_(phase), begin_(stats ? DecodeStats::Now() : 0) {}
+
+        ~ScopedDecodePhase() {
+            if (stats_)
+                stats_->AddPhaseTime(phase_, DecodeStats::Now() - begin_);
+        }
+    private:
+        DecodeStats* stats_;
+        DecodePhase phase_;
+        uint64_t begin_;
+#else
+        ScopedDecodePhase(DecodeStats*, DecodePhase) {}
+#endif
+    private:
+        DISALLOW_COPY_AND_ASSIGN(ScopedDecodePhase);
+    };
+
+}
+}
+
+#endif // _BLVM_BITCODE_DECODE_STATS_HPP
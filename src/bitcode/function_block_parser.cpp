@@ -1,9 +1,1034 @@
 #include "function_block_parser.hpp"
+#include <algorithm>
+#include <cstring>
+#include "bitcode_reader.hpp"
+#include "bitcode_llvm.hpp"
+#include "constants_block.hpp"
+#include "parsing_context.hpp"
+#include "parsing_exception.hpp"
+#include "../core/function.hpp"
+#include "../core/function_body.hpp"
+#include "../core/global_variable.hpp"
+#include "../core/module.hpp"
+#include "../core/superinstructions.hpp"
+#include "../core/type.hpp"
 
 namespace blvm {
 namespace bitcode {
 
+    using core::Instruction;
+    using core::Opcode;
+    using core::RegisterType;
+    using core::ValueType;
 
+    namespace {
 
+        const RegisterType kVoidType = {ValueType::kVoid, 0};
+        const RegisterType kBoolType = {ValueType::kI1, 1};
+        const RegisterType kPointerType = {ValueType::kPointer, 64};
+
+        // Bit of the packed ALLOCA operand: the first operand is the allocated type, not a pointer to it.
+        const uint64_t kAllocaExplicitType = 1u << 6;
+
+        // Switches with APInt case ranges carry this in the upper bits of their type operand.
+        const uint64_t kSwitchInstMagic = 0x4B5;
+
+        // constant_image_offsets_ entries that are not offsets
+        const uint64_t kImagePending = UINT64_MAX;
+        const uint64_t kImageInProgress = UINT64_MAX - 1;
+        const uint64_t kImageFailed = UINT64_MAX - 2;
+
+        // Function-level constants only need images to fill registers and the expressions behind them.
+        const uint64_t kMaxImageSize = 1ull << 20;
+
+        uint64_t SignExtend(uint64_t value, uint32_t bit_width) {
+            if (bit_width == 0 || bit_width >= 64)
+                return value;
+            uint64_t sign = 1ull << (bit_width - 1);
+            return ((value & ((sign << 1) - 1)) ^ sign) - sign;
+        }
+
+        void ThrowDataError() {
+            throw ParserException(ParserError::kDataError);
+        }
+
+        void ThrowNotSupported() {
+            throw ParserException(ParserError::kNotSupproted);
+        }
+
+    }
+
+    FunctionBlockParser::FunctionBlockParser(core::BLVMContext& context, const ParsingContext& parsing_context,
+                                             BitcodeReader& reader, core::Module& module, core::Function& function) :
+            context_(context), parsing_context_(parsing_context), reader_(reader), module_(module),
+            function_(function), is_lowering_(true), basic_block_count_(0), current_block_(0),
+            module_value_count_(0), defined_value_count_(0), max_forward_reference_(0) {
+
+    }
+
+    FunctionBlockParser::~FunctionBlockParser() {
+
+    }
+
+    template <typename Step>
+    void FunctionBlockParser::RunLoweringStep(Step step) {
+        if (!is_lowering_)
+            return;
+        try {
+            step();
+        } catch (ParserException& e) {
+            if (e.code() != static_cast<int>(ParserError::kNotSupproted))
+                throw;
+            is_lowering_ = false;
+            body_.reset();
+        }
+    }
+
+    void FunctionBlockParser::Parse() {
+        using Entry = BitcodeReader::Entry;
+
+        ScopedDecodePhase phase(parsing_context_.GetDecodeStats(), DecodePhase::kFunctionBody);
+
+        reader_.EnterSubBlock(BlockIds::kFunctionBlock);
+        RunLoweringStep([this] { BeginLowering(); });
+
+        uint32_t instruction_count = 0;
+
+        while (true) {
+            Entry entry = reader_.ReadNextEntry();
+
+            switch (entry.kind) {
+                case Entry::Kind::kError:
+                    throw ParserException(ParserError::kDataError);
+                case Entry::Kind::kSubBlock:
+                    // metadata, value symtab, uselist: not needed to execute
+                    if (entry.id == BlockIds::kConstantBlock && is_lowering_)
+                        RunLoweringStep([this] { ReadLocalConstants(); });
+                    else
+                        reader_.SkipSubBlock(entry.id);
+                    continue;
+                case Entry::Kind::kEndBlock:
+                    reader_.ReadBlockEnd();
+                    if (basic_block_count_ == 0)
+                        throw ParserException(ParserError::kDataError);
+                    RunLoweringStep([this] { FinishLowering(); });
+                    function_.SetBodyInfo(basic_block_count_, instruction_count);
+                    function_.SetBody(std::move(body_));
+                    return;
+                case Entry::Kind::kRecord:
+                    break;
+            }
+
+            RecordView ops = reader_.ReadRecord(entry.id);
+            switch (static_cast<FunctionCodes>(ops.GetCode())) {
+                case FunctionCodes::kDeclareBlocks:
+                    // every block ends in a record of at least one bit
+                    if (ops.empty() || ops[0] == 0 || basic_block_count_ != 0 ||
+                        ops[0] > (uint64_t)reader_.GetCurrentBlockSize() * 32)
+                        throw ParserException(ParserError::kDataError);
+                    basic_block_count_ = static_cast<uint32_t>(ops[0]);
+                    break;
+                case FunctionCodes::kDebugLoc:
+                case FunctionCodes::kDebugLocAgain:
+                case FunctionCodes::kOperandBundle:
+                    break;
+                default:
+                    instruction_count++;
+                    RunLoweringStep([this, &ops] { LowerRecord(ops); });
+                    break;
+            }
+        }
+    }
+
+    // Arguments take the first registers, in order.
+    void FunctionBlockParser::BeginLowering() {
+        body_.reset(new core::FunctionBody());
+        module_value_count_ = module_.value_table.size();
+        max_forward_reference_ = (uint64_t)reader_.GetCurrentBlockSize() * 32;
+
+        // abbreviated instruction records take a word or two
+        size_t estimated_count = reader_.GetCurrentBlockSize() / 2 + 8;
+        body_->code.reserve(estimated_count);
+        body_->registers.reserve(estimated_count);
+        values_.reserve(estimated_count);
+
+        auto function_type = static_cast<const core::FunctionType*>(function_.GetFunctionType());
+        if (function_type->IsVarArg())
+            ThrowNotSupported();
+        for (core::TypeRef param_type : function_type->GetParamTypes()) {
+            RegisterType type = GetRegisterType(param_type);
+            values_.push_back({NewRegister(), type, kNoConstant});
+        }
+        defined_value_count_ = (uint32_t)values_.size();
+        body_->argument_count = defined_value_count_;
+    }
+
+    // The constants get their value ids now and their registers on first use.
+    void FunctionBlockParser::ReadLocalConstants() {
+        size_t first = constants_.size();
+        ReadConstantsBlock(reader_, module_.type_table, constants_, constant_operands_);
+        if (values_.size() != defined_value_count_)
+            ThrowDataError();
+
+        for (size_t i = first; i < constants_.size(); i++) {
+            RegisterType type = kVoidType;
+            core::GetRegisterType(constants_[i].type, type);
+            values_.push_back({core::kNoRegister, type, (uint32_t)i});
+        }
+        defined_value_count_ = (uint32_t)values_.size();
+        constant_image_offsets_.resize(constants_.size(), kImagePending);
+    }
+
+    void FunctionBlockParser::LowerRecord(const RecordView& ops) {
+        if (current_block_ >= basic_block_count_)
+            ThrowDataError();
+
+        switch (static_cast<FunctionCodes>(ops.GetCode())) {
+            case FunctionCodes::kInstBinop:
+                LowerBinop(ops);
+                break;
+            case FunctionCodes::kInstUnop:
+                LowerUnop(ops);
+                break;
+            case FunctionCodes::kInstCast:
+                LowerCast(ops);
+                break;
+            case FunctionCodes::kInstCmp:
+            case FunctionCodes::kInstCmp2:
+                LowerCmp(ops);
+                break;
+            case FunctionCodes::kInstVSelect:
+                LowerSelect(ops);
+                break;
+            case FunctionCodes::kInstGEP:
+                LowerGEP(ops);
+                break;
+            case FunctionCodes::kInstAlloca:
+                LowerAlloca(ops);
+                break;
+            case FunctionCodes::kInstLoad:
+            case FunctionCodes::kInstLoadAtomic:
+                LowerLoad(ops);
+                break;
+            case FunctionCodes::kInstStore:
+            case FunctionCodes::kInstStoreAtomic:
+                LowerStore(ops);
+                break;
+            case FunctionCodes::kInstCall:
+                LowerCall(ops);
+                break;
+            case FunctionCodes::kInstPhi:
+                LowerPhi(ops);
+                break;
+            case FunctionCodes::kInstRet:
+                LowerRet(ops);
+                break;
+            case FunctionCodes::kInstBr:
+                LowerBr(ops);
+                break;
+            case FunctionCodes::kInstSwitch:
+                LowerSwitch(ops);
+                break;
+            case FunctionCodes::kInstUnreachable:
+                Emit(Opcode::kUnreachable, kVoidType, core::kNoRegister);
+                EndBlock();
+                break;
+            case FunctionCodes::kInstFreeze: {
+                size_t index = 0;
+                Operand value = ReadValueTypePair(ops, index);
+                Emit(Opcode::kMove, value.type, DefineValue(value.type), value.register_index);
+                break;
+            }
+            case FunctionCodes::kInstFence:
+                // a single thread of execution
+                break;
+            default:
+                ThrowNotSupported();
+        }
+    }
+
+    // [opval, opval, opcode, (flags)]
+    void FunctionBlockParser::LowerBinop(const RecordView& ops) {
+        size_t index = 0;
+        Operand lhs = ReadValueTypePair(ops, index);
+        Operand rhs = ReadValue(ops, index, lhs.type);
+        if (index >= ops.size())
+            ThrowDataError();
+
+        BinaryOpcodes binary_opcode = static_cast<BinaryOpcodes>(ops[index]);
+        Opcode opcode;
+        if (lhs.type.IsInteger()) {
+            if (binary_opcode > BinaryOpcodes::kXor)
+                ThrowDataError();
+            opcode = static_cast<Opcode>((uint32_t)Opcode::kAdd + (uint32_t)binary_opcode);
+        } else if (lhs.type.IsFloatingPoint()) {
+            switch (binary_opcode) {
+                case BinaryOpcodes::kAdd: opcode = Opcode::kFAdd; break;
+                case BinaryOpcodes::kSub: opcode = Opcode::kFSub; break;
+                case BinaryOpcodes::kMul: opcode = Opcode::kFMul; break;
+                case BinaryOpcodes::kSDiv: opcode = Opcode::kFDiv; break;
+                case BinaryOpcodes::kSRem: opcode = Opcode::kFRem; break;
+                default: ThrowDataError(); return;
+            }
+        } else {
+            ThrowDataError();
+            return;
+        }
+        Emit(opcode, lhs.type, DefineValue(lhs.type), lhs.register_index, rhs.register_index);
+    }
+
+    // [opval, opcode, (flags)]
+    void FunctionBlockParser::LowerUnop(const RecordView& ops) {
+        size_t index = 0;
+        Operand value = ReadValueTypePair(ops, index);
+        if (index >= ops.size() || static_cast<UnaryOpcodes>(ops[index]) != UnaryOpcodes::kFNeg ||
+            !value.type.IsFloatingPoint())
+            ThrowDataError();
+        Emit(Opcode::kFNeg, value.type, DefineValue(value.type), value.register_index);
+    }
+
+    // [opval, destty, castopc, (flags)]
+    void FunctionBlockParser::LowerCast(const RecordView& ops) {
+        size_t index = 0;
+        Operand value = ReadValueTypePair(ops, index);
+        if (index + 2 > ops.size())
+            ThrowDataError();
+        RegisterType dest_type = GetRegisterType(GetType(ops[index]));
+        RegisterType source_type = value.type;
+
+        bool is_valid = false;
+        Opcode opcode = Opcode::kMove;
+        switch (static_cast<CastOpcodes>(ops[index + 1])) {
+            case CastOpcodes::kTrunc:
+                opcode = Opcode::kTrunc;
+                is_valid = source_type.IsInteger() && dest_type.IsInteger() && dest_type.width < source_type.width;
+                break;
+            case CastOpcodes::kZExt:
+            case CastOpcodes::kSExt:
+                opcode = static_cast<CastOpcodes>(ops[index + 1]) == CastOpcodes::kZExt ? Opcode::kZExt
+                                                                                      : Opcode::kSExt;
+                is_valid = source_type.IsInteger() && dest_type.IsInteger() && dest_type.width > source_type.width;
+                break;
+            case CastOpcodes::kFPToUI:
+            case CastOpcodes::kFPToSI:
+                opcode = static_cast<CastOpcodes>(ops[index + 1]) == CastOpcodes::kFPToUI ? Opcode::kFPToUI
+                                                                                        : Opcode::kFPToSI;
+                is_valid = source_type.IsFloatingPoint() && dest_type.IsInteger();
+                break;
+            case CastOpcodes::kUIToFP:
+            case CastOpcodes::kSIToFP:
+                opcode = static_cast<CastOpcodes>(ops[index + 1]) == CastOpcodes::kUIToFP ? Opcode::kUIToFP
+                                                                                        : Opcode::kSIToFP;
+                is_valid = source_type.IsInteger() && dest_type.IsFloatingPoint();
+                break;
+            case CastOpcodes::kFPTrunc:
+                opcode = Opcode::kFPTrunc;
+                is_valid = source_type.type == ValueType::kDouble && dest_type.type == ValueType::kFloat;
+                break;
+            case CastOpcodes::kFPExt:
+                opcode = Opcode::kFPExt;
+                is_valid = source_type.type == ValueType::kFloat && dest_type.type == ValueType::kDouble;
+                break;
+            case CastOpcodes::kPtrToInt:
+                opcode = Opcode::kPtrToInt;
+                is_valid = source_type.type == ValueType::kPointer && dest_type.IsInteger();
+                break;
+            case CastOpcodes::kIntToPtr:
+                opcode = Opcode::kIntToPtr;
+                is_valid = source_type.IsInteger() && dest_type.type == ValueType::kPointer;
+                break;
+            case CastOpcodes::kBitCast:
+                // registers hold the bits, a bitcast between same-sized scalars is a copy
+                is_valid = source_type.width == dest_type.width &&
+                           (source_type.type == ValueType::kPointer) == (dest_type.type == ValueType::kPointer);
+                break;
+            case CastOpcodes::kAddrSpaceCast:
+                is_valid = source_type.type == ValueType::kPointer && dest_type.type == ValueType::kPointer;
+                break;
+            default:
+                break;
+        }
+        if (!is_valid)
+            ThrowDataError();
+
+        Instruction& instruction = Emit(opcode, dest_type, DefineValue(dest_type), value.register_index);
+        if (opcode != Opcode::kMove) {
+            instruction.aux = static_cast<uint8_t>(source_type.type);
+            instruction.b = source_type.width;
+        }
+    }
+
+    // [opval, opval, pred, (flags)]
+    void FunctionBlockParser::LowerCmp(const RecordView& ops) {
+        size_t index = 0;
+        Operand lhs = ReadValueTypePair(ops, index);
+        Operand rhs = ReadValue(ops, index, lhs.type);
+        if (index >= ops.size())
+            ThrowDataError();
+
+        uint64_t predicate = ops[index];
+        Opcode opcode;
+        if (lhs.type.IsInteger() || lhs.type.type == ValueType::kPointer) {
+            if (predicate < (uint64_t)CmpPredicates::kICmpEQ || predicate > (uint64_t)CmpPredicates::kICmpSLE)
+                ThrowDataError();
+            opcode = Opcode::kICmp;
+        } else if (lhs.type.IsFloatingPoint()) {
+            if (predicate > (uint64_t)CmpPredicates::kFCmpTrue)
+                ThrowDataError();
+            opcode = Opcode::kFCmp;
+        } else {
+            ThrowDataError();
+            return;
+        }
+        Instruction& instruction = Emit(opcode, lhs.type, DefineValue(kBoolType), lhs.register_index,
+                                        rhs.register_index);
+        instruction.aux = static_cast<uint8_t>(predicate);
+    }
+
+    // [opval, opval, pred]: true value, false value, condition
+    void FunctionBlockParser::LowerSelect(const RecordView& ops) {
+        size_t index = 0;
+        Operand true_value = ReadValueTypePair(ops, index);
+        Operand false_value = ReadValue(ops, index, true_value.type);
+        Operand condition = ReadValueTypePair(ops, index);
+        if (condition.type != kBoolType)
+            ThrowDataError();
+        Emit(Opcode::kSelect, true_value.type, DefineValue(true_value.type), condition.register_index,
+             true_value.register_index, false_value.register_index);
+    }
+
+    // [inbounds, ty, opval, opval, ...]: constant indexes fold into one offset, each other index adds its scaled
+    // value on the way.
+    void FunctionBlockParser::LowerGEP(const RecordView& ops) {
+        if (ops.size() < 3)
+            ThrowDataError();
+        core::TypeRef current_type = GetType(ops[1]);
+        size_t index = 2;
+        Operand base = ReadValueTypePair(ops, index);
+        if (base.type.type != ValueType::kPointer)
+            ThrowDataError();
+
+        struct ScaledIndex {
+            Operand value;
+            uint32_t scale;
+        };
+        std::vector<ScaledIndex> scaled_indexes;
+        uint64_t offset = 0;
+        bool is_first = true;
+
+        while (index < ops.size()) {
+            Operand value = ReadValueTypePair(ops, index);
+            if (!value.type.IsInteger() || !current_type->IsSized())
+                ThrowDataError();
+
+            uint64_t stride;
+            TypeCodes type_code = current_type->GetTypeCode();
+            if (is_first) {
+                // steps over whole objects of the source element type
+                stride = current_type->GetAllocSize();
+                is_first = false;
+            } else if (type_code == TypeCodes::kStruct_ANON || type_code == TypeCodes::kStruct_NAMED) {
+                auto struct_type = static_cast<const core::StructType*>(current_type);
+                uint64_t member = body_->registers[value.register_index];
+                if (!value.is_constant || member >= struct_type->GetMembers().size())
+                    ThrowDataError();
+                offset += struct_type->GetMemberOffset((size_t)member);
+                current_type = struct_type->GetMembers()[(size_t)member];
+                continue;
+            } else if (type_code == TypeCodes::kArray) {
+                current_type = static_cast<const core::ArrayType*>(current_type)->GetElementType();
+                stride = current_type->GetAllocSize();
+            } else {
+                // vectors are not laid out in registers, and nothing else can be indexed into
+                ThrowNotSupported();
+                return;
+            }
+
+            if (value.is_constant) {
+                offset += SignExtend(body_->registers[value.register_index], value.type.width) * stride;
+            } else {
+                if (stride > UINT32_MAX)
+                    ThrowNotSupported();
+                scaled_indexes.push_back({value, (uint32_t)stride});
+            }
+        }
+
+        uint32_t dest = DefineValue(kPointerType);
+        uint32_t address = base.register_index;
+        for (const ScaledIndex& scaled_index : scaled_indexes) {
+            Emit(Opcode::kPtrAddScaled, scaled_index.value.type, dest, address, scaled_index.value.register_index,
+                 scaled_index.scale);
+            address = dest;
+        }
+        if (offset != 0 || scaled_indexes.empty())
+            Emit(Opcode::kPtrAdd, kPointerType, dest, address, (uint32_t)offset, (uint32_t)(offset >> 32));
+    }
+
+    // [instty, opty, op, align]: the element count is an absolute value id. align packs the alignment
+    // (log2 + 1, bits 0-4 and 8-10) with flags, the explicit type flag among them.
+    void FunctionBlockParser::LowerAlloca(const RecordView& ops) {
+        if (ops.size() != 4)
+            ThrowDataError();
+        core::TypeRef allocated_type = GetType(ops[0]);
+        uint64_t packed = ops[3];
+        if ((packed & kAllocaExplicitType) == 0) {
+            if (allocated_type->GetTypeCode() != TypeCodes::kPointer)
+                ThrowDataError();
+            allocated_type = static_cast<const core::PointerType*>(allocated_type)->GetPointeeType();
+        }
+
+        RegisterType count_type = GetRegisterType(GetType(ops[1]));
+        Operand count = GetOperand(ops[2], &count_type);
+        if (!count.type.IsInteger())
+            ThrowDataError();
+        if (!allocated_type->IsSized() || allocated_type->GetAllocSize() > UINT32_MAX)
+            ThrowNotSupported();
+
+        uint64_t alignment_exponent = (packed & 0x1f) | (((packed >> 8) & 0x7) << 5);
+        if (alignment_exponent > 32)
+            ThrowNotSupported();
+        uint32_t alignment = alignment_exponent == 0 ? allocated_type->GetAlignment()
+                                                     : 1u << (alignment_exponent - 1);
+        Emit(Opcode::kAlloca, kPointerType, DefineValue(kPointerType), count.register_index,
+             (uint32_t)allocated_type->GetAllocSize(), alignment);
+    }
+
+    // [op, ty, align, vol], atomic: [op, ty, align, vol, ordering, ssid]
+    void FunctionBlockParser::LowerLoad(const RecordView& ops) {
+        size_t index = 0;
+        Operand address = ReadValueTypePair(ops, index);
+        size_t trailing = static_cast<FunctionCodes>(ops.GetCode()) == FunctionCodes::kInstLoadAtomic ? 4 : 2;
+        // without the explicit type (before LLVM 3.7) the type would be the pointee of the operand's
+        if (index + trailing + 1 != ops.size())
+            ThrowNotSupported();
+        RegisterType type = GetRegisterType(GetType(ops[index]));
+        if (address.type.type != ValueType::kPointer || type.type == ValueType::kVoid)
+            ThrowDataError();
+        Emit(Opcode::kLoad, type, DefineValue(type), address.register_index);
+    }
+
+    // [ptr, val, align, vol], atomic: [ptr, val, align, vol, ordering, ssid]
+    void FunctionBlockParser::LowerStore(const RecordView& ops) {
+        size_t index = 0;
+        Operand address = ReadValueTypePair(ops, index);
+        Operand value = ReadValueTypePair(ops, index);
+        size_t trailing = static_cast<FunctionCodes>(ops.GetCode()) == FunctionCodes::kInstStoreAtomic ? 4 : 2;
+        if (index + trailing != ops.size() || address.type.type != ValueType::kPointer)
+            ThrowDataError();
+        Emit(Opcode::kStore, value.type, core::kNoRegister, address.register_index, value.register_index);
+    }
+
+    // [paramattrs, cc, (fmf), fnty, fnid, args...]
+    void FunctionBlockParser::LowerCall(const RecordView& ops) {
+        if (ops.size() < 2)
+            ThrowDataError();
+        size_t index = 1;
+        uint64_t calling_convention = ops[index++];
+        if ((calling_convention >> CallMarkers::kCallFmf) & 1)
+            index++;
+        // before LLVM 3.7 the function type was the pointee of the callee's type
+        if (((calling_convention >> CallMarkers::kCallExplicitType) & 1) == 0)
+            ThrowNotSupported();
+        if (index + 2 > ops.size())
+            ThrowDataError();
+        core::TypeRef type = GetType(ops[index++]);
+        if (type->GetTypeCode() != TypeCodes::kFunction)
+            ThrowDataError();
+        auto function_type = static_cast<const core::FunctionType*>(type);
+
+        // Intrinsics are declarations the interpreter cannot call, the ones without an effect are dropped.
+        uint64_t callee_id = (uint32_t)(module_value_count_ + defined_value_count_) - (uint32_t)ops[index];
+        if (callee_id < module_value_count_ &&
+            module_.value_table[callee_id].kind == core::ModuleValue::Kind::kFunction) {
+            const core::Function& function = *module_.function_list[module_.value_table[callee_id].index];
+            if (function.IsNoOpIntrinsic())
+                return;
+            if (function.GetName().StartsWith("llvm."))
+                ThrowNotSupported();
+        }
+
+        Operand callee = ReadValueTypePair(ops, index);
+        if (callee.type.type != ValueType::kPointer)
+            ThrowDataError();
+        if (function_type->IsVarArg())
+            ThrowNotSupported();
+
+        std::vector<uint32_t>& call_arguments = body_->call_arguments;
+        uint32_t argument_begin = (uint32_t)call_arguments.size();
+        for (core::TypeRef param_type : function_type->GetParamTypes()) {
+            Operand argument = ReadValue(ops, index, GetRegisterType(param_type));
+            call_arguments.push_back(argument.register_index);
+        }
+        if (index != ops.size())
+            ThrowDataError();
+
+        RegisterType return_type = GetRegisterType(function_type->GetReturnType());
+        uint32_t dest = return_type.type == ValueType::kVoid ? core::kNoRegister : DefineValue(return_type);
+        Emit(Opcode::kCall, return_type, dest, callee.register_index, argument_begin,
+             (uint32_t)function_type->GetParamTypes().size());
+    }
+
+    // [ty, val0, bb0, ...]: values are signed relative ids, forward references are common. The copies are
+    // placed once all blocks are known, see EmitPhiCopies().
+    void FunctionBlockParser::LowerPhi(const RecordView& ops) {
+        if (ops.empty())
+            ThrowDataError();
+        RegisterType type = GetRegisterType(GetType(ops[0]));
+        if (type.type == ValueType::kVoid)
+            ThrowDataError();
+
+        uint32_t incoming_begin = (uint32_t)phi_incoming_.size();
+        uint32_t incoming_count = (uint32_t)((ops.size() - 1) / 2);
+        uint32_t next_value_id = (uint32_t)(module_value_count_ + defined_value_count_);
+        for (uint32_t i = 0; i < incoming_count; i++) {
+            uint32_t value_id = next_value_id - (uint32_t)DecodeSignRotatedValue(ops[1 + i * 2]);
+            Operand value = GetOperand(value_id, &type);
+            if (value.type != type)
+                ThrowDataError();
+            phi_incoming_.push_back({GetBlock(ops[2 + i * 2]), value.register_index});
+        }
+        phis_.push_back({current_block_, DefineValue(type), type, incoming_begin, incoming_count});
+    }
+
+    // [] or [opval]
+    void FunctionBlockParser::LowerRet(const RecordView& ops) {
+        if (ops.empty()) {
+            Emit(Opcode::kRet, kVoidType, core::kNoRegister, core::kNoRegister);
+        } else {
+            size_t index = 0;
+            Operand value = ReadValueTypePair(ops, index);
+            if (index != ops.size())
+                ThrowNotSupported();
+            Emit(Opcode::kRet, value.type, core::kNoRegister, value.register_index);
+        }
+        EndBlock();
+    }
+
+    // [bb] or [bbtrue, bbfalse, cond]
+    void FunctionBlockParser::LowerBr(const RecordView& ops) {
+        if (ops.size() == 1) {
+            Emit(Opcode::kBr, kVoidType, core::kNoRegister, GetBlock(ops[0]));
+        } else if (ops.size() == 3) {
+            size_t index = 2;
+            Operand condition = ReadValue(ops, index, kBoolType);
+            Emit(Opcode::kCondBr, kBoolType, core::kNoRegister, condition.register_index, GetBlock(ops[0]),
+                 GetBlock(ops[1]));
+        } else {
+            ThrowDataError();
+        }
+        EndBlock();
+    }
+
+    // [opty, cond, defaultbb, (caseval, bb)*]: case values are absolute value ids of constants.
+    void FunctionBlockParser::LowerSwitch(const RecordView& ops) {
+        if (ops.size() < 3 || (ops.size() - 3) % 2 != 0)
+            ThrowDataError();
+        if ((ops[0] >> 16) == kSwitchInstMagic)
+            ThrowNotSupported();
+        RegisterType type = GetRegisterType(GetType(ops[0]));
+        if (!type.IsInteger())
+            ThrowDataError();
+
+        size_t index = 1;
+        Operand condition = ReadValue(ops, index, type);
+
+        std::vector<core::FunctionBody::SwitchCase>& switch_cases = body_->switch_cases;
+        uint32_t first_case = (uint32_t)switch_cases.size();
+        switch_cases.push_back({0, GetBlock(ops[2])});
+        for (size_t i = 3; i < ops.size(); i += 2) {
+            uint64_t value;
+            RegisterType value_type;
+            if (!ReadConstantBits(ops[i], value, value_type) || value_type != type)
+                ThrowDataError();
+            switch_cases.push_back({value, GetBlock(ops[i + 1])});
+        }
+        Emit(Opcode::kSwitch, type, core::kNoRegister, condition.register_index, first_case,
+             (uint32_t)(ops.size() - 3) / 2);
+        EndBlock();
+    }
+
+    // Lays the blocks out in order and turns block numbers into code indexes. The copies of the phis go right
+    // before an unconditional branch. A conditional branch or switch jumps through a stub after it instead,
+    // one per successor with phis, so that the copies of one edge do not run on the others.
+    void FunctionBlockParser::FinishLowering() {
+        if (current_block_ != basic_block_count_ || values_.size() != defined_value_count_)
+            ThrowDataError();
+
+        struct Fixup {
+            enum Field : uint8_t {
+                kA,
+                kB,
+                kC,
+                kSwitchCase
+            };
+
+            uint32_t index;  // into code, or into switch_cases for kSwitchCase
+            Field field;
+            uint32_t block;
+        };
+
+        std::vector<core::FunctionBody::SwitchCase>& switch_cases = body_->switch_cases;
+        std::vector<Instruction> lowered;
+        lowered.swap(body_->code);
+        std::vector<Instruction>& code = body_->code;
+        code.reserve(lowered.size() + phis_.size());
+        std::vector<uint32_t> block_starts(basic_block_count_);
+        std::vector<Fixup> fixups;
+        fixups.reserve(basic_block_count_ * 2);
+        std::vector<std::pair<uint32_t, uint32_t>> stubs;  // successor block, code index of its stub
+
+        auto has_phis = [this](uint32_t block) {
+            auto it = std::lower_bound(phis_.begin(), phis_.end(), block,
+                                       [](const Phi& phi, uint32_t value) { return phi.block < value; });
+            return it != phis_.end() && it->block == block;
+        };
+        auto find_stub = [&stubs](uint32_t block) {
+            for (const std::pair<uint32_t, uint32_t>& stub : stubs) {
+                if (stub.first == block)
+                    return stub.second;
+            }
+            return core::kNoRegister;
+        };
+
+        for (uint32_t block = 0; block < basic_block_count_; block++) {
+            block_starts[block] = (uint32_t)code.size();
+            uint32_t begin = block == 0 ? 0 : block_ends_[block - 1];
+            uint32_t end = block_ends_[block];
+            code.insert(code.end(), lowered.begin() + begin, lowered.begin() + end - 1);
+
+            Instruction terminator = lowered[end - 1];
+            if (terminator.opcode == Opcode::kBr) {
+                EmitPhiCopies(block, terminator.a, code);
+                fixups.push_back({(uint32_t)code.size(), Fixup::kA, terminator.a});
+                code.push_back(terminator);
+                continue;
+            }
+            uint32_t terminator_index = (uint32_t)code.size();
+            code.push_back(terminator);
+            if (terminator.opcode != Opcode::kCondBr && terminator.opcode != Opcode::kSwitch)
+                continue;
+
+            std::vector<Fixup> edges;
+            if (terminator.opcode == Opcode::kCondBr) {
+                edges.push_back({terminator_index, Fixup::kB, terminator.b});
+                edges.push_back({terminator_index, Fixup::kC, terminator.c});
+            } else {
+                for (uint32_t i = terminator.b; i <= terminator.b + terminator.c; i++)
+                    edges.push_back({i, Fixup::kSwitchCase, switch_cases[i].target});
+            }
+
+            stubs.clear();
+            for (const Fixup& edge : edges) {
+                if (!has_phis(edge.block)) {
+                    fixups.push_back(edge);
+                    continue;
+                }
+                uint32_t stub = find_stub(edge.block);
+                if (stub == core::kNoRegister) {
+                    stub = (uint32_t)code.size();
+                    stubs.push_back(std::make_pair(edge.block, stub));
+                    EmitPhiCopies(block, edge.block, code);
+                    fixups.push_back({(uint32_t)code.size(), Fixup::kA, edge.block});
+                    code.push_back({nullptr, Opcode::kBr, ValueType::kVoid, 0, 0, core::kNoRegister, 0, 0, 0});
+                }
+                // the edge leads to the stub, whose code index is known already
+                if (edge.field == Fixup::kSwitchCase)
+                    switch_cases[edge.index].target = stub;
+                else if (edge.field == Fixup::kB)
+                    code[edge.index].b = stub;
+                else
+                    code[edge.index].c = stub;
+            }
+        }
+
+        for (const Fixup& fixup : fixups) {
+            uint32_t target = block_starts[fixup.block];
+            switch (fixup.field) {
+                case Fixup::kA:
+                    code[fixup.index].a = target;
+                    break;
+                case Fixup::kB:
+                    code[fixup.index].b = target;
+                    break;
+                case Fixup::kC:
+                    code[fixup.index].c = target;
+                    break;
+                case Fixup::kSwitchCase:
+                    switch_cases[fixup.index].target = target;
+                    break;
+            }
+        }
+        for (Instruction& instruction : code)
+            instruction.opcode = core::SpecializeOpcode(instruction);
+        core::FuseSuperinstructions(*body_);
+        body_->basic_block_count = basic_block_count_;
+    }
+
+    // A copy whose source is the destination of another copy of the same edge reads a temporary, filled
+    // before any copy is made.
+    void FunctionBlockParser::EmitPhiCopies(uint32_t block, uint32_t successor, std::vector<Instruction>& code) {
+        auto range = std::equal_range(phis_.begin(), phis_.end(), Phi{successor, 0, kVoidType, 0, 0},
+                                      [](const Phi& lhs, const Phi& rhs) { return lhs.block < rhs.block; });
+
+        struct Copy {
+            uint32_t dest;
+            uint32_t source;
+            RegisterType type;
+        };
+        std::vector<Copy> copies;
+        for (auto phi = range.first; phi != range.second; ++phi) {
+            const PhiIncoming* incoming = nullptr;
+            for (uint32_t i = 0; i < phi->incoming_count && incoming == nullptr; i++) {
+                if (phi_incoming_[phi->incoming_begin + i].block == block)
+                    incoming = &phi_incoming_[phi->incoming_begin + i];
+            }
+            if (incoming == nullptr)
+                ThrowDataError();
+            if (incoming->source != phi->dest)
+                copies.push_back({phi->dest, incoming->source, phi->type});
+        }
+
+        size_t temporary_count = 0;
+        for (Copy& copy : copies) {
+            bool is_overwritten = false;
+            for (const Copy& other : copies)
+                is_overwritten |= &other != &copy && other.dest == copy.source;
+            if (!is_overwritten)
+                continue;
+            if (temporary_count == copy_temporaries_.size())
+                copy_temporaries_.push_back(NewRegister());
+            uint32_t temporary = copy_temporaries_[temporary_count++];
+            code.push_back({nullptr, Opcode::kMove, copy.type.type, 0, copy.type.width, temporary, copy.source, 0, 0});
+            copy.source = temporary;
+        }
+        for (const Copy& copy : copies)
+            code.push_back({nullptr, Opcode::kMove, copy.type.type, 0, copy.type.width, copy.dest, copy.source, 0, 0});
+    }
+
+    FunctionBlockParser::Operand FunctionBlockParser::ReadValueTypePair(const RecordView& ops, size_t& index) {
+        if (index >= ops.size())
+            ThrowDataError();
+        uint32_t next_value_id = (uint32_t)(module_value_count_ + defined_value_count_);
+        uint32_t value_id = next_value_id - (uint32_t)ops[index++];
+        if (value_id < next_value_id)
+            return GetOperand(value_id, nullptr);
+
+        // a forward reference carries its type
+        if (index >= ops.size())
+            ThrowDataError();
+        RegisterType type = GetRegisterType(GetType(ops[index++]));
+        return GetOperand(value_id, &type);
+    }
+
+    FunctionBlockParser::Operand FunctionBlockParser::ReadValue(const RecordView& ops, size_t& index,
+                                                                RegisterType type) {
+        if (index >= ops.size())
+            ThrowDataError();
+        uint32_t value_id = (uint32_t)(module_value_count_ + defined_value_count_) - (uint32_t)ops[index++];
+        Operand operand = GetOperand(value_id, &type);
+        if (operand.type != type)
+            ThrowDataError();
+        return operand;
+    }
+
+    // Module values and constants get a preset register on first use. A forward reference needs its type
+    // and must stay within what the block could still define.
+    FunctionBlockParser::Operand FunctionBlockParser::GetOperand(uint64_t value_id, const RegisterType* forward_type) {
+        if (value_id < module_value_count_) {
+            auto it = module_value_registers_.find(value_id);
+            if (it != module_value_registers_.end())
+                return it->second;
+
+            const core::ModuleValue& value = module_.value_table[value_id];
+            uint64_t bits = 0;
+            RegisterType type = kPointerType;
+            switch (value.kind) {
+                case core::ModuleValue::Kind::kFunction:
+                    bits = (uint64_t)(uintptr_t)module_.function_list[value.index].Get();
+                    break;
+                case core::ModuleValue::Kind::kGlobalVariable:
+                    bits = (uint64_t)(uintptr_t)module_.global_list[value.index]->GetStorage();
+                    if (bits == 0)
+                        ThrowNotSupported();
+                    break;
+                case core::ModuleValue::Kind::kConstant:
+                    ReadConstantBits(value_id, bits, type);
+                    break;
+                default:
+                    ThrowNotSupported();
+            }
+            Operand operand = {NewRegister(bits), type, true};
+            module_value_registers_[value_id] = operand;
+            return operand;
+        }
+
+        uint64_t local_id = value_id - module_value_count_;
+        if (local_id < defined_value_count_) {
+            if (values_[local_id].constant == kNoConstant)
+                return {values_[local_id].register_index, values_[local_id].type, false};
+            if (values_[local_id].register_index == core::kNoRegister) {
+                uint64_t bits = 0;
+                RegisterType type;
+                ReadConstantBits(value_id, bits, type);
+                values_[local_id].register_index = NewRegister(bits);
+            }
+            return {values_[local_id].register_index, values_[local_id].type, true};
+        }
+
+        if (forward_type == nullptr || forward_type->type == ValueType::kVoid ||
+            local_id - defined_value_count_ >= max_forward_reference_)
+            ThrowDataError();
+        if (local_id >= values_.size())
+            values_.resize((size_t)local_id + 1, {core::kNoRegister, kVoidType, kNoConstant});
+        LocalValue& value = values_[local_id];
+        if (value.register_index == core::kNoRegister) {
+            value.register_index = NewRegister();
+            value.type = *forward_type;
+        } else if (value.type != *forward_type) {
+            ThrowDataError();
+        }
+        return {value.register_index, value.type, false};
+    }
+
+    uint32_t FunctionBlockParser::DefineValue(RegisterType type) {
+        uint32_t local_id = defined_value_count_++;
+        if (local_id == values_.size()) {
+            values_.push_back({NewRegister(), type, kNoConstant});
+            return values_.back().register_index;
+        }
+
+        // forward referenced
+        LocalValue& value = values_[local_id];
+        if (value.register_index == core::kNoRegister)
+            value.register_index = NewRegister();
+        else if (value.type != type)
+            ThrowDataError();
+        value.type = type;
+        return value.register_index;
+    }
+
+    bool FunctionBlockParser::ReadConstantBits(uint64_t value_id, uint64_t& out_bits, RegisterType& out_type) {
+        core::TypeRef type;
+        uint8_t image[sizeof(uint64_t)] = {};
+        if (value_id < module_value_count_) {
+            const core::ModuleValue& value = module_.value_table[value_id];
+            if (value.kind != core::ModuleValue::Kind::kConstant)
+                return false;
+            type = module_.constant_list[value.index].type;
+            if (!core::GetRegisterType(type, out_type) || out_type.type == ValueType::kVoid ||
+                !module_.WriteValueImage(value_id, type, image))
+                ThrowNotSupported();
+        } else {
+            uint64_t local_id = value_id - module_value_count_;
+            if (local_id >= defined_value_count_ || values_[local_id].constant == kNoConstant)
+                return false;
+            const core::ConstantRecord& record = constants_[values_[local_id].constant];
+            type = record.type;
+            out_type = values_[local_id].type;
+            // the common case, without the image
+            if (record.code == ConstantsCodes::kInteger && record.operand_count == 1 && out_type.IsInteger()) {
+                out_bits = DecodeSignRotatedValue(constant_operands_[record.operand_begin]);
+                if (out_type.width < 64)
+                    out_bits &= (1ull << out_type.width) - 1;
+                return true;
+            }
+            if (out_type.type == ValueType::kVoid || !WriteValueImage(value_id, type, image))
+                ThrowNotSupported();
+        }
+
+        out_bits = 0;
+        memcpy(&out_bits, image, (size_t)type->GetStoreSize());
+        if (out_type.IsInteger() && out_type.width < 64)
+            out_bits &= (1ull << out_type.width) - 1;
+        return true;
+    }
+
+    core::TypeRef FunctionBlockParser::GetType(uint64_t type_index) {
+        if (type_index >= module_.type_table.size())
+            ThrowDataError();
+        return module_.type_table[(size_t)type_index];
+    }
+
+    RegisterType FunctionBlockParser::GetRegisterType(core::TypeRef type) {
+        RegisterType register_type;
+        if (!core::GetRegisterType(type, register_type))
+            ThrowNotSupported();
+        return register_type;
+    }
+
+    uint32_t FunctionBlockParser::NewRegister(uint64_t initial_value) {
+        std::vector<uint64_t>& registers = body_->registers;
+        if (registers.size() >= core::kNoRegister)
+            ThrowNotSupported();
+        registers.push_back(initial_value);
+        return (uint32_t)(registers.size() - 1);
+    }
+
+    Instruction& FunctionBlockParser::Emit(Opcode opcode, RegisterType type, uint32_t dest, uint32_t a, uint32_t b,
+                                           uint32_t c) {
+        body_->code.push_back({nullptr, opcode, type.type, 0, type.width, dest, a, b, c});
+        return body_->code.back();
+    }
+
+    void FunctionBlockParser::EndBlock() {
+        block_ends_.push_back((uint32_t)body_->code.size());
+        current_block_++;
+    }
+
+    uint32_t FunctionBlockParser::GetBlock(uint64_t block_index) {
+        if (block_index >= basic_block_count_)
+            ThrowDataError();
+        return (uint32_t)block_index;
+    }
+
+    core::TypeRef FunctionBlockParser::GetTypeByIndex(uint64_t type_index) {
+        return type_index < module_.type_table.size() ? module_.type_table[(size_t)type_index] : nullptr;
+    }
+
+    // Local constants are evaluated on first use like the module's, see core::Module::InitializeGlobals().
+    bool FunctionBlockParser::WriteValueImage(uint64_t value_id, core::TypeRef type, uint8_t* dest) {
+        if (value_id < module_value_count_)
+            return module_.WriteValueImage(value_id, type, dest);
+
+        uint64_t local_id = value_id - module_value_count_;
+        if (local_id >= values_.size() || values_[local_id].constant == kNoConstant)
+            return false;
+        uint32_t index = values_[local_id].constant;
+        const core::ConstantRecord& record = constants_[index];
+        if (record.type != type)
+            return false;
+
+        uint64_t state = constant_image_offsets_[index];
+        if (state == kImageInProgress || state == kImageFailed)
+            return false;
+        if (state == kImagePending) {
+            constant_image_offsets_[index] = kImageInProgress;
+            bool succeeded = type->IsSized() && type->GetStoreSize() <= kMaxImageSize;
+            size_t size = (size_t)type->GetStoreSize();
+            // scalars are evaluated on the stack, the operands may add images of their own meanwhile
+            uint8_t small_image[16];
+            std::vector<uint8_t> large_image;
+            uint8_t* image = small_image;
+            if (succeeded && size > sizeof(small_image)) {
+                large_image.resize(size);
+                image = large_image.data();
+            }
+            if (succeeded) {
+                memset(image, 0, size);
+                succeeded = core::WriteConstantImage(record, constant_operands_.data() + record.operand_begin, *this,
+                                                     image);
+            }
+            if (!succeeded) {
+                constant_image_offsets_[index] = kImageFailed;
+                return false;
+            }
+            state = constant_images_.size();
+            constant_image_offsets_[index] = state;
+            constant_images_.insert(constant_images_.end(), image, image + size);
+        }
+        memcpy(dest, constant_images_.data() + state, (size_t)type->GetStoreSize());
+        return true;
+    }
+
+}
 }
-}
\ No newline at end of file
@@ -1,10 +1,149 @@
 #ifndef _BLVM_BITCODE_FUNCTION_BLOCK_PARSER_HPP
 #define _BLVM_BITCODE_FUNCTION_BLOCK_PARSER_HPP
 
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "../base/noncopyable.hpp"
+#include "../core/constant.hpp"
+#include "../core/core_fwd.hpp"
+#include "../core/instruction.hpp"
+
 namespace blvm {
 namespace bitcode {
 
+    class BitcodeReader;
+    class ParsingContext;
+    class RecordView;
+
+    // Decodes one FUNCTION_BLOCK straight into a core::FunctionBody. The reader must be positioned right after
+    // the block id, i.e. at core::Function::GetBodyBitOffset().
+    //
+    // Every SSA value gets a register on first sight: arguments first, then constants as instructions use
+    // them, results as they are defined or forward referenced. Operands are resolved to registers and types
+    // to core::RegisterType on the spot, branch targets are block numbers until the block layout is known at
+    // the end of the block. Then phis turn into copies on their incoming edges, the generic opcodes into
+    // their variants for the operand types (core::SpecializeOpcode), and common sequences into
+    // superinstructions (core::FuseSuperinstructions).
+    //
+    // Instructions the lowering does not cover (aggregates, vectors, exception handling, atomics other than
+    // plain loads and stores, varargs, wide integers) leave the function materialized without a body.
+    // Calls to intrinsics without an effect (debug info, lifetime markers) are dropped, other intrinsics are
+    // not covered. Both need the callee's name: a module decoded in one pass from a stream has none yet and
+    // keeps such calls as they are.
+    class FunctionBlockParser : private core::ConstantResolver {
+    public:
+        FunctionBlockParser(core::BLVMContext& context, const ParsingContext& parsing_context,
+                            BitcodeReader& reader, core::Module& module, core::Function& function);
+        ~FunctionBlockParser();
+        void Parse();
+    private:
+        // Values past defined_value_count_ are forward references that have a register already.
+        struct LocalValue {
+            uint32_t register_index;  // core::kNoRegister until used (constants) or referenced
+            core::RegisterType type;
+            uint32_t constant;        // into constants_, kNoConstant for arguments and instructions
+        };
+
+        struct Operand {
+            uint32_t register_index;
+            core::RegisterType type;
+            bool is_constant;  // the register is preset with the value
+        };
+
+        struct Phi {
+            uint32_t block;
+            uint32_t dest;
+            core::RegisterType type;
+            uint32_t incoming_begin;  // into phi_incoming_
+            uint32_t incoming_count;
+        };
+
+        struct PhiIncoming {
+            uint32_t block;
+            uint32_t source;
+        };
+
+        static const uint32_t kNoConstant = UINT32_MAX;
+
+        // Runs step unless lowering has stopped. A construct the lowering does not cover stops it for the rest
+        // of the block, malformed records still fail the whole block.
+        template <typename Step>
+        void RunLoweringStep(Step step);
+
+        void BeginLowering();
+        void ReadLocalConstants();
+        void LowerRecord(const RecordView& ops);
+        void FinishLowering();
+
+        void LowerBinop(const RecordView& ops);
+        void LowerUnop(const RecordView& ops);
+        void LowerCast(const RecordView& ops);
+        void LowerCmp(const RecordView& ops);
+        void LowerSelect(const RecordView& ops);
+        void LowerGEP(const RecordView& ops);
+        void LowerAlloca(const RecordView& ops);
+        void LowerLoad(const RecordView& ops);
+        void LowerStore(const RecordView& ops);
+        void LowerCall(const RecordView& ops);
+        void LowerPhi(const RecordView& ops);
+        void LowerRet(const RecordView& ops);
+        void LowerBr(const RecordView& ops);
+        void LowerSwitch(const RecordView& ops);
+
+        // Relative value ids, as written by LLVM since module version 1.
+        Operand ReadValueTypePair(const RecordView& ops, size_t& index);
+        Operand ReadValue(const RecordView& ops, size_t& index, core::RegisterType type);
+        Operand GetOperand(uint64_t value_id, const core::RegisterType* forward_type);
+        uint32_t DefineValue(core::RegisterType type);
+
+        // Value of a constant that fits a register, false for non-constants.
+        bool ReadConstantBits(uint64_t value_id, uint64_t& out_bits, core::RegisterType& out_type);
+
+        core::TypeRef GetType(uint64_t type_index);
+        core::RegisterType GetRegisterType(core::TypeRef type);
+        uint32_t NewRegister(uint64_t initial_value = 0);
+        core::Instruction& Emit(core::Opcode opcode, core::RegisterType type, uint32_t dest, uint32_t a = 0,
+                                uint32_t b = 0, uint32_t c = 0);
+        void EndBlock();
+        uint32_t GetBlock(uint64_t block_index);
+
+        // Appends the copies of the phis of successor for the edge from block, as a parallel copy.
+        void EmitPhiCopies(uint32_t block, uint32_t successor, std::vector<core::Instruction>& code);
+
+        virtual core::TypeRef GetTypeByIndex(uint64_t type_index) override;
+        virtual bool WriteValueImage(uint64_t value_id, core::TypeRef type, uint8_t* dest) override;
+    private:
+        core::BLVMContext& context_;
+        const ParsingContext& parsing_context_;
+        BitcodeReader& reader_;
+        core::Module& module_;
+        core::Function& function_;
+
+        bool is_lowering_;  // cleared when the body turns out to need something the lowering does not cover
+        std::unique_ptr<core::FunctionBody> body_;
+        uint32_t basic_block_count_;
+        uint32_t current_block_;
+        std::vector<uint32_t> block_ends_;  // code index past the terminator of each finished block
+
+        uint64_t module_value_count_;
+        std::vector<LocalValue> values_;  // by value id - module_value_count_
+        uint32_t defined_value_count_;    // local values defined so far, the next value id is past them
+        uint64_t max_forward_reference_;
+        std::unordered_map<uint64_t, Operand> module_value_registers_;
+
+        std::vector<core::ConstantRecord> constants_;
+        std::vector<uint64_t> constant_operands_;
+        std::vector<uint8_t> constant_images_;
+        std::vector<uint64_t> constant_image_offsets_;  // per constant, into constant_images_
+
+        std::vector<Phi> phis_;
+        std::vector<PhiIncoming> phi_incoming_;
+        std::vector<uint32_t> copy_temporaries_;
 
+        DISALLOW_COPY_AND_ASSIGN(FunctionBlockParser);
+    };
 
 }
 }
@@ -0,0 +1,163 @@
+#include "module_summary.hpp"
+#include <utility>
+#include "../base/memory_buffer.hpp"
+#include "bitcode_llvm.hpp"
+#include "bitcode_reader.hpp"
+#include "bitcode_visitor.hpp"
+#include "parsing_context.hpp"
+#include "parsing_exception.hpp"
+#include "string_table.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    namespace {
+
+        const uint32_t kNotAFunction = ~uint32_t(0);
+
+        class SummaryVisitor : public BitcodeVisitor {
+        public:
+            explicit SummaryVisitor(ModuleSummary& summary) : summary_(summary) {}
+
+            virtual Action OnEnterBlock(uint32_t block_id, size_t bit_offset, uint32_t block_size) override {
+                switch (block_id) {
+                    case BlockIds::kModuleBlock:
+                    case BlockIds::kStrtabBlock:
+                        return Action::kContinue;
+                    case BlockIds::kValueSymtabBlock:
+                        // Function VSTs are never reached, their blocks are skipped. v2 VSTs carry no names.
+                        return summary_.module_version < 2 ? Action::kContinue : Action::kSkipBlock;
+                    default:
+                        return Action::kSkipBlock;
+                }
+            }
+
+            virtual Action OnRecord(uint32_t block_id, const RecordView& record) override {
+                switch (block_id) {
+                    case BlockIds::kModuleBlock:
+                        OnModuleRecord(record);
+                        break;
+                    case BlockIds::kValueSymtabBlock:
+                        OnValueSymtabRecord(record);
+                        break;
+                    case BlockIds::kStrtabBlock:
+                        // A blob points into the bitcode buffer, it outlives the record.
+                        if (record.GetCode() == StrtabCodes::kStrtabBlob && record.HasBlob())
+                            strtab_ = StringTable(record.GetBlob());
+                        break;
+                }
+                return Action::kContinue;
+            }
+
+            // v2 names are (offset, size) into the STRTAB, which follows the module block.
+            void ResolveStrtabNames() {
+                if (summary_.module_version < 2)
+                    return;
+
+                for (size_t i = 0; i < summary_.functions.size(); i++) {
+                    const std::pair<uint64_t, uint64_t>& name = strtab_names_[i];
+                    if (!strtab_.Contains(name.first, name.second))
+                        throw ParserException(ParserError::kDataError);
+                    summary_.functions[i].name = strtab_.Get(name.first, name.second).ToString();
+                }
+            }
+        private:
+            void OnModuleRecord(const RecordView& record) {
+                switch (record.GetCode()) {
+                    case ModuleCodes::kVersion:
+                        if (record.empty() || (record[0] != 1 && record[0] != 2))
+                            throw ParserException(ParserError::kNotSupproted);
+                        summary_.module_version = (int)record[0];
+                        break;
+                    case ModuleCodes::kTriple:
+                        summary_.target_triple = record.ToString();
+                        break;
+                    case ModuleCodes::kDataLayout:
+                        summary_.target_datalayout = record.ToString();
+                        break;
+                    case ModuleCodes::kSectionName:
+                        summary_.section_names.push_back(record.ToString());
+                        break;
+                    case ModuleCodes::kGcName:
+                        summary_.gc_names.push_back(record.ToString());
+                        break;
+                    case ModuleCodes::kGlobalVar:
+                    case ModuleCodes::kAlias_Old:
+                    case ModuleCodes::kAlias:
+                    case ModuleCodes::kIFunc:
+                        value_functions_.push_back(kNotAFunction);
+                        break;
+                    case ModuleCodes::kFunction: {
+                        // Same layout as in BitcodeParser::ParseModuleBlock().
+                        size_t first = summary_.module_version >= 2 ? 2 : 0;
+                        if (record.size() < first + 8)
+                            throw ParserException(ParserError::kDataNotEnough);
+
+                        FunctionSummary function;
+                        function.linkage = static_cast<core::Linkage>(record[first + 3]);
+                        function.is_declaration = (record[first + 2] != 0);
+                        if (first != 0)
+                            strtab_names_.push_back(std::make_pair(record[0], record[1]));
+
+                        value_functions_.push_back((uint32_t)summary_.functions.size());
+                        summary_.functions.push_back(std::move(function));
+                        break;
+                    }
+                }
+            }
+
+            // v1: [valueid, namechar x N] or [valueid, offset, namechar x N]
+            void OnValueSymtabRecord(const RecordView& record) {
+                size_t name_first;
+                switch (record.GetCode()) {
+                    case ValueSymtabCodes::kVSTEntry:
+                        name_first = 1;
+                        break;
+                    case ValueSymtabCodes::kVSTFnEntry:
+                        name_first = 2;
+                        break;
+                    default:
+                        return;
+                }
+                if (record.size() < name_first || record[0] >= value_functions_.size())
+                    return;
+
+                uint32_t function_index = value_functions_[record[0]];
+                if (function_index != kNotAFunction)
+                    summary_.functions[function_index].name = record.ToString(name_first);
+            }
+        private:
+            ModuleSummary& summary_;
+            std::vector<uint32_t> value_functions_;  // module-level value id -> function index
+            std::vector<std::pair<uint64_t, uint64_t>> strtab_names_;
+            StringTable strtab_;
+        };
+
+    }
+
+    void ScanModuleSummary(ParsingContext& parsing_context, BitcodeReader& reader, ModuleSummary& out_summary) {
+        SummaryVisitor visitor(out_summary);
+        BitcodeScanner scanner(parsing_context, reader);
+        scanner.Scan(visitor);
+        visitor.ResolveStrtabNames();
+    }
+
+    bool ScanModuleSummary(const char* filename, ModuleSummary& out_summary) {
+        base::MemoryBuffer buffer = base::MemoryBuffer::OpenFile(filename);
+        if (!buffer.IsValid())
+            return false;
+
+        ParsingContext parsing_context(std::move(buffer));
+        try {
+            BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
+            ScanModuleSummary(parsing_context, reader, out_summary);
+        } catch (ReaderException&) {
+            return false;
+        } catch (ParserException&) {
+            return false;
+        }
+        return true;
+    }
+
+}
+}
@@ -0,0 +1,43 @@
+#ifndef _BLVM_BITCODE_MODULE_SUMMARY_HPP
+#define _BLVM_BITCODE_MODULE_SUMMARY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../core/linkage.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    class BitcodeReader;
+    class ParsingContext;
+
+    struct FunctionSummary {
+        std::string name;
+        core::Linkage linkage;
+        bool is_declaration;
+    };
+
+    // What an indexer needs from a module, without its types, constants, metadata or function bodies.
+    struct ModuleSummary {
+        int module_version;
+        std::string target_triple;
+        std::string target_datalayout;
+        std::vector<std::string> section_names;
+        std::vector<std::string> gc_names;
+        std::vector<FunctionSummary> functions;  // in FUNCTION record order
+
+        ModuleSummary() : module_version(0) {}
+    };
+
+    // Reads the MODULE_BLOCK records plus the names (v1: module VST, v2: STRTAB), every other block is
+    // skipped by its size. Starts at the magic number. Throws ReaderException or ParserException.
+    void ScanModuleSummary(ParsingContext& parsing_context, BitcodeReader& reader, ModuleSummary& out_summary);
+
+    // Convenience wrapper over a file, returns false if it cannot be read or is malformed.
+    bool ScanModuleSummary(const char* filename, ModuleSummary& out_summary);
+
+}
+}
+
+#endif // _BLVM_BITCODE_MODULE_SUMMARY_HPP
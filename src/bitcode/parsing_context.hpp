@@ -2,25 +2,73 @@
 #define _BLVM_BITCODE_PARSING_CONTEXT_HPP
 
 #include <cstdint>
-#include <vector>
 #include <utility>
 #include "../base/memory_buffer.hpp"
+#include "block_index.hpp"
+#include "block_info_set.hpp"
+#include "decode_stats.hpp"
 
 namespace blvm {
 namespace bitcode {
 
-    struct BlockInfo;
-
     class ParsingContext {
     public:
         explicit ParsingContext(base::MemoryBuffer&& bitcode_buffer);
+        // Without a buffer, for a reader over a base::StreamInput.
+        ParsingContext();
         const base::MemoryBuffer* GetBitcodeBuffer() const;
-        bool HasBlockInfos() const;
-        BlockInfo* GetBlockInfo(uint32_t block_id);
-        BlockInfo* GetOrCreateBlockInfo(uint32_t block_id);
+
+        bool HasBlockInfos() const {
+            return block_infos_.Get() != nullptr;
+        }
+
+        // O(1), called on every block entry.
+        const BlockInfo* GetBlockInfo(uint32_t block_id) const {
+            return block_infos_.Get() != nullptr ? block_infos_->GetBlockInfo(block_id) : nullptr;
+        }
+
+        const BlockInfoSetRef& GetBlockInfoSet() const {
+            return block_infos_;
+        }
+
+        // The set is immutable from here on and may be shared with other contexts.
+        void SetBlockInfoSet(const BlockInfoSetRef& block_infos) {
+            block_infos_ = block_infos;
+        }
+
+        // Optional. With a cache attached, a BLOCKINFO block already parsed by another context is reused.
+        const BlockInfoCacheRef& GetBlockInfoCache() const {
+            return block_info_cache_;
+        }
+
+        void SetBlockInfoCache(const BlockInfoCacheRef& cache) {
+            block_info_cache_ = cache;
+        }
+
+        // Optional. With an index of this bitcode attached, parsers seek to the blocks it lists instead of walking
+        // up to them, see BlockIndex::LoadOrBuild().
+        const BlockIndexRef& GetBlockIndex() const {
+            return block_index_;
+        }
+
+        void SetBlockIndex(const BlockIndexRef& block_index) {
+            block_index_ = block_index;
+        }
+
+        // Optional, not owned. Readers and parsers over this context report into it, see DecodeStats.
+        DecodeStats* GetDecodeStats() const {
+            return decode_stats_;
+        }
+
+        void SetDecodeStats(DecodeStats* decode_stats) {
+            decode_stats_ = decode_stats;
+        }
     private:
         base::MemoryBuffer bitcode_storage_;
-        std::vector<BlockInfo> block_infos;
+        BlockInfoSetRef block_infos_;
+        BlockInfoCacheRef block_info_cache_;
+        BlockIndexRef block_index_;
+        DecodeStats* decode_stats_;
 
         DISALLOW_COPY_AND_ASSIGN(ParsingContext);
     };
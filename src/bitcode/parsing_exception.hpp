@@ -13,7 +13,8 @@ namespace bitcode {
         kEof = 1,
         kDataNotEnough = 2,
         kDataError = 3,
-        kScopeMismatch = 4
+        kScopeMismatch = 4,
+        kNotSeekable = 5  // a streaming reader was asked for input it has already released
     };
 
     class ReaderException : public std::exception {
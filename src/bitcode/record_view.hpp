@@ -0,0 +1,93 @@
+#ifndef _BLVM_BITCODE_RECORD_VIEW_HPP
+#define _BLVM_BITCODE_RECORD_VIEW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace blvm {
+namespace bitcode {
+
+    struct ByteSpan {
+        const uint8_t* data;
+        size_t size;
+
+        ByteSpan() : data(nullptr), size(0) {}
+        ByteSpan(const uint8_t* _data, size_t _size) : data(_data), size(_size) {}
+    };
+
+    // A decoded record, valid until the next BitcodeReader::ReadRecord().
+    // Scalar operands live in the reader's reusable operand arena. A trailing blob points straight into the
+    // bitcode buffer, a trailing char6 or byte-sized fixed array is decoded into the reader's byte arena,
+    // both are exposed as bytes and also through operator[] as if they were ordinary operands.
+    class RecordView {
+    public:
+        RecordView() : code_(0), scalars_(nullptr), scalar_count_(0), bytes_(nullptr), byte_count_(0),
+                       is_blob_(false) {}
+        RecordView(uint32_t code, const uint64_t* scalars, size_t scalar_count,
+                   const uint8_t* bytes, size_t byte_count, bool is_blob) :
+                code_(code), scalars_(scalars), scalar_count_(scalar_count), bytes_(bytes), byte_count_(byte_count),
+                is_blob_(is_blob) {}
+
+        uint32_t GetCode() const {
+            return code_;
+        }
+
+        size_t size() const {
+            return scalar_count_ + byte_count_;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        uint64_t operator[](size_t n) const {
+            return n < scalar_count_ ? scalars_[n] : bytes_[n - scalar_count_];
+        }
+
+        // Operands before the trailing bytes (or all of them, if there are no trailing bytes).
+        size_t GetScalarCount() const {
+            return scalar_count_;
+        }
+
+        bool HasBlob() const {
+            return is_blob_;
+        }
+
+        ByteSpan GetBlob() const {
+            return is_blob_ ? ByteSpan(bytes_, byte_count_) : ByteSpan();
+        }
+
+        // Trailing blob or char array, empty if the record has neither.
+        ByteSpan GetBytes() const {
+            return ByteSpan(bytes_, byte_count_);
+        }
+
+        // Operands [first, size()) as chars. The trailing bytes are appended with a single copy.
+        void AppendToString(std::string& out_string, size_t first = 0) const {
+            for (size_t i = first; i < scalar_count_; i++)
+                out_string.push_back((char)scalars_[i]);
+
+            size_t byte_first = first > scalar_count_ ? first - scalar_count_ : 0;
+            if (byte_first < byte_count_)
+                out_string.append(reinterpret_cast<const char*>(bytes_) + byte_first, byte_count_ - byte_first);
+        }
+
+        std::string ToString(size_t first = 0) const {
+            std::string result;
+            AppendToString(result, first);
+            return result;
+        }
+    private:
+        uint32_t code_;
+        const uint64_t* scalars_;
+        size_t scalar_count_;
+        const uint8_t* bytes_;
+        size_t byte_count_;
+        bool is_blob_;
+    };
+
+}
+}
+
+#endif // _BLVM_BITCODE_RECORD_VIEW_HPP
@@ -0,0 +1,121 @@
+#include "snapshot_loader.hpp"
+#include <utility>
+#include "../base/memory_buffer.hpp"
+#include "../core/module.hpp"
+#include "../core/module_snapshot.hpp"
+#include "bitcode_materializer.hpp"
+#include "bitcode_parser.hpp"
+#include "bitcode_reader.hpp"
+#include "block_index.hpp"
+#include "block_info_set.hpp"
+#include "parsing_exception.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    namespace {
+
+        // Function blocks use the BLOCKINFO abbrevs, which LLVM writes at the start of the module block. Only
+        // the records before it are decoded, none with a block index.
+        bool ReadModuleBlockInfo(ParsingContext& parsing_context) {
+            using Entry = BitcodeReader::Entry;
+
+            try {
+                BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
+                const BlockIndexRef& index = parsing_context.GetBlockIndex();
+                const BlockIndexEntry* block_info = index ? index->FindFirst(StandardBlockIds::kBlockInfo) : nullptr;
+                if (block_info) {
+                    reader.SeekToBitPos(block_info->bit_offset);
+                    ReadBlockInfoBlock(reader, parsing_context);
+                    return true;
+                }
+
+                if (!reader.ReadMagic())
+                    return false;
+                while (true) {
+                    Entry entry = reader.ReadNextEntry();
+                    if (entry.kind != Entry::Kind::kSubBlock)
+                        return false;
+                    if (entry.id == BlockIds::kModuleBlock)
+                        break;
+                    reader.SkipSubBlock(entry.id);
+                }
+
+                reader.EnterSubBlock(BlockIds::kModuleBlock);
+                while (true) {
+                    Entry entry = reader.ReadNextEntry();
+                    switch (entry.kind) {
+                        case Entry::Kind::kError:
+                            return false;
+                        case Entry::Kind::kEndBlock:
+                            return true;
+                        case Entry::Kind::kSubBlock:
+                            if (entry.id == StandardBlockIds::kBlockInfo) {
+                                ReadBlockInfoBlock(reader, parsing_context);
+                                return true;
+                            }
+                            reader.SkipSubBlock(entry.id);
+                            break;
+                        case Entry::Kind::kRecord:
+                            reader.ReadRecord(entry.id);
+                            break;
+                    }
+                }
+            } catch (ReaderException&) {
+                return false;
+            } catch (ParserException&) {
+                return false;
+            }
+        }
+
+    }
+
+    bool LoadModuleWithSnapshot(core::BLVMContext& context, core::Module& module, const char* bitcode_filename,
+                                const char* snapshot_filename, bool* out_from_snapshot,
+                                const char* block_index_filename) {
+        if (out_from_snapshot)
+            *out_from_snapshot = false;
+
+        base::MemoryBuffer bitcode_buffer = base::MemoryBuffer::OpenFile(bitcode_filename);
+        if (!bitcode_buffer.IsValid())
+            return false;
+
+        base::MemoryBuffer snapshot = base::MemoryBuffer::OpenFile(snapshot_filename);
+        bool from_snapshot = snapshot.IsValid() &&
+                             core::ModuleSnapshot::Load(context, module, snapshot, bitcode_buffer);
+
+        // Function names point into the bitcode either way, the materializer keeps it mapped.
+        base::RefPtr<BitcodeMaterializer> materializer =
+                new BitcodeMaterializer(context, module, std::move(bitcode_buffer));
+        if (block_index_filename) {
+            ParsingContext& parsing_context = materializer->GetParsingContext();
+            parsing_context.SetBlockIndex(BlockIndex::LoadOrBuild(parsing_context, block_index_filename));
+        }
+        if (from_snapshot) {
+            if (!ReadModuleBlockInfo(materializer->GetParsingContext()))
+                return false;
+            module.SetMaterializer(materializer);
+            if (out_from_snapshot)
+                *out_from_snapshot = true;
+            return true;
+        }
+
+        // Missing or stale snapshot: decode the bitcode and rebuild it.
+        ParsingContext& parsing_context = materializer->GetParsingContext();
+        try {
+            BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
+            BitcodeParser parser(context, parsing_context, reader, module);
+            parser.Parse();
+        } catch (ReaderException&) {
+            return false;
+        } catch (ParserException&) {
+            return false;
+        }
+
+        module.SetMaterializer(materializer);
+        core::ModuleSnapshot::Save(module, *parsing_context.GetBitcodeBuffer(), snapshot_filename);
+        return true;
+    }
+
+}
+}
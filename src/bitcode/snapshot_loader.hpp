@@ -0,0 +1,22 @@
+#ifndef _BLVM_BITCODE_SNAPSHOT_LOADER_HPP
+#define _BLVM_BITCODE_SNAPSHOT_LOADER_HPP
+
+#include "../core/core_fwd.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    // Loads bitcode_filename into an empty module through the snapshot cache at snapshot_filename: a snapshot
+    // built from the same bitcode contents is loaded instead of decoding the bitcode, otherwise the bitcode
+    // is parsed and the snapshot rewritten. A failure to write the snapshot does not fail the load. Either way
+    // function bodies are left to the module's materializer.
+    // out_from_snapshot, if not null, tells which way the module was loaded. With block_index_filename, block
+    // offsets come from that sidecar index, which is rebuilt the same way, see BlockIndex::LoadOrBuild().
+    bool LoadModuleWithSnapshot(core::BLVMContext& context, core::Module& module, const char* bitcode_filename,
+                                const char* snapshot_filename, bool* out_from_snapshot = nullptr,
+                                const char* block_index_filename = nullptr);
+
+}
+}
+
+#endif // _BLVM_BITCODE_SNAPSHOT_LOADER_HPP
@@ -0,0 +1,27 @@
+#include "stream_loader.hpp"
+#include "bitcode_parser.hpp"
+#include "bitcode_reader.hpp"
+#include "parsing_context.hpp"
+#include "parsing_exception.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    bool LoadModuleFromStream(core::BLVMContext& context, core::Module& module, base::StreamInput& stream,
+                              DecodeStats* decode_stats) {
+        ParsingContext parsing_context;
+        parsing_context.SetDecodeStats(decode_stats);
+        try {
+            BitcodeReader reader(parsing_context, stream);
+            BitcodeParser parser(context, parsing_context, reader, module);
+            parser.Parse();
+        } catch (ReaderException&) {
+            return false;
+        } catch (ParserException&) {
+            return false;
+        }
+        return !stream.HasError();
+    }
+
+}
+}
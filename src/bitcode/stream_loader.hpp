@@ -0,0 +1,21 @@
+#ifndef _BLVM_BITCODE_STREAM_LOADER_HPP
+#define _BLVM_BITCODE_STREAM_LOADER_HPP
+
+#include "../base/stream_input.hpp"
+#include "../core/core_fwd.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    class DecodeStats;
+
+    // Loads a module from a non-seekable input (a pipe, a socket) in a single forward pass, every function body
+    // decoded as it arrives. Only a bounded window of the input is held, see base::StreamInput, and nothing
+    // refers back to it afterwards: the module needs no materializer. decode_stats may be null.
+    bool LoadModuleFromStream(core::BLVMContext& context, core::Module& module, base::StreamInput& stream,
+                              DecodeStats* decode_stats = nullptr);
+
+}
+}
+
+#endif // _BLVM_BITCODE_STREAM_LOADER_HPP
@@ -0,0 +1,41 @@
+#ifndef _BLVM_BITCODE_STRING_TABLE_HPP
+#define _BLVM_BITCODE_STRING_TABLE_HPP
+
+#include <cstdint>
+#include "../base/string_piece.hpp"
+#include "record_view.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    // The STRTAB blob: v2 modules and the SYMTAB name things by (offset, size) into it.
+    // The blob points into the bitcode buffer, so do the pieces it hands out.
+    class StringTable {
+    public:
+        StringTable() = default;
+        explicit StringTable(ByteSpan blob) : blob_(blob) {}
+
+        bool IsValid() const {
+            return blob_.data != nullptr;
+        }
+
+        size_t size() const {
+            return blob_.size;
+        }
+
+        bool Contains(uint64_t offset, uint64_t size) const {
+            return offset <= blob_.size && size <= blob_.size - offset;
+        }
+
+        // The caller checks the range with Contains().
+        base::StringPiece Get(uint64_t offset, uint64_t size) const {
+            return base::StringPiece(reinterpret_cast<const char*>(blob_.data + offset), (size_t)size);
+        }
+    private:
+        ByteSpan blob_;
+    };
+
+}
+}
+
+#endif // _BLVM_BITCODE_STRING_TABLE_HPP
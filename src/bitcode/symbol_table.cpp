@@ -0,0 +1,108 @@
+#include "symbol_table.hpp"
+#include "bitcode_llvm.hpp"
+#include "bitcode_reader.hpp"
+#include "bitcode_visitor.hpp"
+#include "parsing_context.hpp"
+#include "parsing_exception.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    namespace {
+
+        // llvm::irsymtab::storage, all fields are little-endian 32-bit words. A Str is {offset, size} into the
+        // STRTAB, a Range is {offset, count} into the SYMTAB itself.
+        const size_t kHeaderVersion = 0;
+        const size_t kHeaderSymbols = 28;
+        const size_t kHeaderTargetTriple = 44;
+        const size_t kHeaderSourceFilename = 52;
+        const size_t kHeaderSize = 76;
+
+        // Symbol: {Str name, Str ir_name, Word comdat_index, Word flags}
+        const size_t kSymbolName = 0;
+        const size_t kSymbolIRName = 8;
+        const size_t kSymbolFlags = 20;
+        const size_t kSymbolSize = 24;
+
+        uint32_t ReadWord(ByteSpan blob, size_t offset) {
+            const uint8_t* p = blob.data + offset;
+            return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        }
+
+        bool ReadStr(ByteSpan blob, size_t offset, const StringTable& strtab, base::StringPiece& out_str) {
+            uint32_t str_offset = ReadWord(blob, offset);
+            uint32_t str_size = ReadWord(blob, offset + 4);
+            if (!strtab.Contains(str_offset, str_size))
+                return false;
+            out_str = strtab.Get(str_offset, str_size);
+            return true;
+        }
+
+        class SymtabVisitor : public BitcodeVisitor {
+        public:
+            virtual Action OnEnterBlock(uint32_t block_id, size_t bit_offset, uint32_t block_size) override {
+                if (block_id == BlockIds::kStrtabBlock || block_id == BlockIds::kSymtabBlock)
+                    return Action::kContinue;
+                return Action::kSkipBlock;
+            }
+
+            // Multi-module files have one STRTAB and SYMTAB per module, the first ones belong to the first module.
+            virtual Action OnBlob(uint32_t block_id, const RecordView& record) override {
+                if (block_id == BlockIds::kStrtabBlock && record.GetCode() == StrtabCodes::kStrtabBlob &&
+                    strtab.data == nullptr)
+                    strtab = record.GetBlob();
+                else if (block_id == BlockIds::kSymtabBlock && record.GetCode() == SymtabCodes::kSymtabBlob &&
+                         symtab.data == nullptr)
+                    symtab = record.GetBlob();
+                return strtab.data != nullptr && symtab.data != nullptr ? Action::kStop : Action::kContinue;
+            }
+
+            ByteSpan strtab;
+            ByteSpan symtab;
+        };
+
+    }
+
+    bool SymbolTable::Parse(ByteSpan symtab, const StringTable& strtab) {
+        symbols_.clear();
+        target_triple_ = base::StringPiece();
+        source_filename_ = base::StringPiece();
+
+        if (symtab.size < kHeaderSize || ReadWord(symtab, kHeaderVersion) != kSupportedVersion)
+            return false;
+
+        uint64_t symbols_offset = ReadWord(symtab, kHeaderSymbols);
+        uint64_t symbol_count = ReadWord(symtab, kHeaderSymbols + 4);
+        if (symbols_offset > symtab.size || symbol_count > (symtab.size - symbols_offset) / kSymbolSize)
+            return false;
+
+        if (!ReadStr(symtab, kHeaderTargetTriple, strtab, target_triple_) ||
+            !ReadStr(symtab, kHeaderSourceFilename, strtab, source_filename_))
+            return false;
+
+        symbols_.resize((size_t)symbol_count);
+        for (size_t i = 0; i < symbols_.size(); i++) {
+            size_t offset = (size_t)symbols_offset + i * kSymbolSize;
+            IRSymbol& symbol = symbols_[i];
+            if (!ReadStr(symtab, offset + kSymbolName, strtab, symbol.name) ||
+                !ReadStr(symtab, offset + kSymbolIRName, strtab, symbol.ir_name)) {
+                symbols_.clear();
+                return false;
+            }
+            symbol.flags = ReadWord(symtab, offset + kSymbolFlags);
+        }
+        return true;
+    }
+
+    bool ReadSymbolTable(ParsingContext& parsing_context, BitcodeReader& reader, SymbolTable& out_table) {
+        SymtabVisitor visitor;
+        BitcodeScanner scanner(parsing_context, reader);
+        scanner.Scan(visitor);
+
+        if (visitor.strtab.data == nullptr || visitor.symtab.data == nullptr)
+            return false;
+        return out_table.Parse(visitor.symtab, StringTable(visitor.strtab));
+    }
+
+}
+}
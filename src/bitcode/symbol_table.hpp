@@ -0,0 +1,84 @@
+#ifndef _BLVM_BITCODE_SYMBOL_TABLE_HPP
+#define _BLVM_BITCODE_SYMBOL_TABLE_HPP
+
+#include <cstdint>
+#include <vector>
+#include "../base/string_piece.hpp"
+#include "record_view.hpp"
+#include "string_table.hpp"
+
+namespace blvm {
+namespace bitcode {
+
+    class BitcodeReader;
+    class ParsingContext;
+
+    // One entry of the prebuilt symbol table (llvm::irsymtab), the names point into the STRTAB.
+    struct IRSymbol {
+        enum Flags : uint32_t {
+            kVisibilityMask = 3,
+            kHasUncommon = 1 << 2,
+            kUndefined = 1 << 3,
+            kWeak = 1 << 4,
+            kCommon = 1 << 5,
+            kIndirect = 1 << 6,
+            kUsed = 1 << 7,
+            kTLS = 1 << 8,
+            kMayOmit = 1 << 9,
+            kGlobal = 1 << 10,
+            kFormatSpecific = 1 << 11,
+            kUnnamedAddr = 1 << 12,
+            kExecutable = 1 << 13
+        };
+
+        base::StringPiece name;     // as the linker sees it, mangled
+        base::StringPiece ir_name;  // empty for symbols that come from module asm
+        uint32_t flags;
+
+        bool IsUndefined() const {
+            return (flags & kUndefined) != 0;
+        }
+
+        bool IsExecutable() const {
+            return (flags & kExecutable) != 0;
+        }
+    };
+
+    // The SYMTAB blob: the module's symbols as a linker wants them, written by the producer so that they can
+    // be listed without reading the module block. Only the current layout (version 3) is understood.
+    class SymbolTable {
+    public:
+        static const uint32_t kSupportedVersion = 3;
+
+        SymbolTable() = default;
+
+        // Returns false if the layout is unknown or a range is out of bounds, the table is empty then.
+        bool Parse(ByteSpan symtab, const StringTable& strtab);
+
+        const std::vector<IRSymbol>& GetSymbols() const {
+            return symbols_;
+        }
+
+        base::StringPiece GetTargetTriple() const {
+            return target_triple_;
+        }
+
+        base::StringPiece GetSourceFilename() const {
+            return source_filename_;
+        }
+    private:
+        std::vector<IRSymbol> symbols_;
+        base::StringPiece target_triple_;
+        base::StringPiece source_filename_;
+    };
+
+    // Reads only the top-level STRTAB and SYMTAB blocks, the module block is skipped by its size.
+    // Starts at the magic number. Returns false if there is no usable SYMTAB (older producers do not write
+    // one), the caller has to parse the module instead. Malformed bitcode throws ReaderException or
+    // ParserException. The symbols point into the reader's buffer.
+    bool ReadSymbolTable(ParsingContext& parsing_context, BitcodeReader& reader, SymbolTable& out_table);
+
+}
+}
+
+#endif // _BLVM_BITCODE_SYMBOL_TABLE_HPP
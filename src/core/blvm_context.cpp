@@ -1,34 +1,210 @@
 #include "blvm_context.hpp"
+#include <algorithm>
 #include "type.hpp"
+#include "../base/hash.hpp"
 
 using namespace blvm::bitcode;
 
 namespace blvm {
 namespace core {
 
-    BLVMContext::BLVMContext() {
-        type_void_ = new Type(TypeCodes::kVoid);
-        type_half_ = new Type(TypeCodes::kHalf);
-        type_float_ = new Type(TypeCodes::kFloat);
-        type_double_ = new Type(TypeCodes::kDouble);
+    BLVMContext::BLVMContext() : layout_types_(nullptr), layout_types_index_(0) {
+        AddLayoutTypes();
+    }
 
-        type_x86_fp80_ = new Type(TypeCodes::kX86_FP80);
-        type_x86_mmx = new Type(TypeCodes::kX86_MMX);
-        type_fp128_ = new Type(TypeCodes::kFP128);
-        type_ppc_fp128_ = new Type(TypeCodes::kPPC_FP128);
-        type_label_ = new Type(TypeCodes::kLabel);
-        type_metadata_ = new Type(TypeCodes::kMetadata);
+    BLVMContext::~BLVMContext() {
 
-        type_int1_ = new IntegerType(1);
-        type_int8_ = new IntegerType(8);
-        type_int16_ = new IntegerType(16);
-        type_int32_ = new IntegerType(32);
-        type_int64_ = new IntegerType(64);
     }
 
-    BLVMContext::~BLVMContext() {
+    size_t BLVMContext::GetUniquedTypeCount() const {
+        size_t count = 0;
+        for (auto& layout_types : layout_types_list_)
+            count += layout_types->uniqued_types.size();
+        return count;
+    }
+
+    // Adds an unbound set of types and selects it.
+    void BLVMContext::AddLayoutTypes() {
+        std::unique_ptr<LayoutTypes> types(new LayoutTypes());
+        types->has_data_layout = false;
+
+        types->type_void = type_arena_.New<Type>(TypeCodes::kVoid);
+        types->type_half = type_arena_.New<Type>(TypeCodes::kHalf);
+        types->type_float = type_arena_.New<Type>(TypeCodes::kFloat);
+        types->type_double = type_arena_.New<Type>(TypeCodes::kDouble);
+
+        types->type_x86_fp80 = type_arena_.New<Type>(TypeCodes::kX86_FP80);
+        types->type_x86_mmx = type_arena_.New<Type>(TypeCodes::kX86_MMX);
+        types->type_fp128 = type_arena_.New<Type>(TypeCodes::kFP128);
+        types->type_ppc_fp128 = type_arena_.New<Type>(TypeCodes::kPPC_FP128);
+        types->type_label = type_arena_.New<Type>(TypeCodes::kLabel);
+        types->type_metadata = type_arena_.New<Type>(TypeCodes::kMetadata);
+
+        types->type_int1 = type_arena_.New<IntegerType>(1);
+        types->type_int8 = type_arena_.New<IntegerType>(8);
+        types->type_int16 = type_arena_.New<IntegerType>(16);
+        types->type_int32 = type_arena_.New<IntegerType>(32);
+        types->type_int64 = type_arena_.New<IntegerType>(64);
+
+        layout_types_ = types.get();
+        layout_types_index_ = layout_types_list_.size();
+        layout_types_list_.push_back(std::move(types));
+    }
+
+    bool BLVMContext::SetDataLayout(const std::string& description) {
+        DataLayout data_layout;
+        if (!data_layout.Parse(description))
+            return false;
+
+        if (!layout_types_->has_data_layout) {
+            layout_types_->data_layout = data_layout;
+            layout_types_->has_data_layout = true;
+            return true;
+        }
+        for (size_t i = 0; i < layout_types_list_.size(); i++) {
+            if (layout_types_list_[i]->data_layout == data_layout) {
+                layout_types_ = layout_types_list_[i].get();
+                layout_types_index_ = i;
+                return true;
+            }
+        }
+
+        AddLayoutTypes();
+        layout_types_->data_layout = data_layout;
+        layout_types_->has_data_layout = true;
+        return true;
+    }
+
+    bool BLVMContext::ComputeTypeLayout(TypeRef type) {
+        if (type->layout_state_ == Type::kLayoutDone)
+            return true;
+        if (type->layout_state_ == Type::kLayoutPending)
+            return false;
+        type->layout_state_ = Type::kLayoutPending;
+
+        uint64_t size_in_bits = 0;
+        uint32_t alignment = 0;
+
+        switch (type->GetTypeCode()) {
+            case TypeCodes::kHalf:
+                size_in_bits = 16;
+                alignment = layout_types_->data_layout.GetFloatAlignment(16);
+                break;
+            case TypeCodes::kFloat:
+                size_in_bits = 32;
+                alignment = layout_types_->data_layout.GetFloatAlignment(32);
+                break;
+            case TypeCodes::kDouble:
+                size_in_bits = 64;
+                alignment = layout_types_->data_layout.GetFloatAlignment(64);
+                break;
+            case TypeCodes::kX86_FP80:
+                size_in_bits = 80;
+                alignment = layout_types_->data_layout.GetFloatAlignment(80);
+                break;
+            case TypeCodes::kFP128:
+            case TypeCodes::kPPC_FP128:
+                size_in_bits = 128;
+                alignment = layout_types_->data_layout.GetFloatAlignment(128);
+                break;
+            case TypeCodes::kX86_MMX:
+                size_in_bits = 64;
+                alignment = layout_types_->data_layout.GetVectorAlignment(64, 8);
+                break;
+            case TypeCodes::kInteger: {
+                uint32_t bit_width = static_cast<IntegerType*>(type)->GetBitWidth();
+                size_in_bits = bit_width;
+                alignment = layout_types_->data_layout.GetIntegerAlignment(bit_width);
+                break;
+            }
+            case TypeCodes::kPointer: {
+                uint32_t address_space = static_cast<PointerType*>(type)->GetAddressSpace();
+                size_in_bits = layout_types_->data_layout.GetPointerSize(address_space) * 8ULL;
+                alignment = layout_types_->data_layout.GetPointerAlignment(address_space);
+                break;
+            }
+            case TypeCodes::kArray: {
+                ArrayType* array_type = static_cast<ArrayType*>(type);
+                TypeRef element_type = array_type->GetElementType();
+                if (!ComputeTypeLayout(element_type) || !element_type->IsSized())
+                    return false;
+                size_in_bits = element_type->alloc_size_ * array_type->GetElementCount() * 8;
+                alignment = element_type->alignment_;
+                break;
+            }
+            case TypeCodes::kVector: {
+                VectorType* vector_type = static_cast<VectorType*>(type);
+                TypeRef element_type = vector_type->GetElementType();
+                if (!ComputeTypeLayout(element_type))
+                    return false;
+                size_in_bits = element_type->size_in_bits_ * vector_type->GetElementCount();
+                alignment = layout_types_->data_layout.GetVectorAlignment(
+                        size_in_bits, element_type->alloc_size_ * vector_type->GetElementCount());
+                break;
+            }
+            case TypeCodes::kStruct_ANON:
+            case TypeCodes::kStruct_NAMED: {
+                StructType* struct_type = static_cast<StructType*>(type);
+                if (struct_type->IsOpaque())
+                    break;
 
+                TypeList members = struct_type->GetMembers();
+                uint64_t* offsets = type_arena_.NewArray<uint64_t>(members.size());
+                uint64_t offset = 0;
+                alignment = struct_type->IsPacked() ? 1 : layout_types_->data_layout.GetAggregateAlignment();
+
+                for (size_t i = 0; i < members.size(); i++) {
+                    TypeRef member = members[i];
+                    if (!ComputeTypeLayout(member) || !member->IsSized())
+                        return false;
+                    if (!struct_type->IsPacked()) {
+                        offset = (offset + member->alignment_ - 1) / member->alignment_ * member->alignment_;
+                        alignment = std::max(alignment, member->alignment_);
+                    }
+                    offsets[i] = offset;
+                    offset += member->alloc_size_;
+                }
+                offset = (offset + alignment - 1) / alignment * alignment;
+                struct_type->member_offsets_ = offsets;
+                size_in_bits = offset * 8;
+                break;
+            }
+            default:
+                // void, label, metadata, function: unsized
+                break;
+        }
+
+        type->size_in_bits_ = size_in_bits;
+        type->alignment_ = alignment;
+        if (alignment != 0) {
+            uint64_t store_size = (size_in_bits + 7) / 8;
+            type->alloc_size_ = (store_size + alignment - 1) / alignment * alignment;
+        }
+        type->layout_state_ = Type::kLayoutDone;
+        return true;
     }
 
+    const TypeRef* BLVMContext::CopyTypeList(const TypeRef* types, size_t count) {
+        TypeRef* copy = type_arena_.NewArray<TypeRef>(count);
+        if (count != 0)
+            std::copy(types, types + count, copy);
+        return copy;
+    }
+
+    bool BLVMContext::TypeKey::operator==(const TypeKey& rhs) const {
+        return type_code == rhs.type_code && operand0 == rhs.operand0 && operand1 == rhs.operand1 &&
+               component_count == rhs.component_count &&
+               std::equal(components, components + component_count, rhs.components);
+    }
+
+    size_t BLVMContext::TypeKeyHash::operator()(const TypeKey& key) const {
+        uint64_t hash = base::HashMix64(static_cast<uint64_t>(key.type_code));
+        hash = base::HashCombine(hash, key.operand0);
+        hash = base::HashCombine(hash, key.operand1);
+        for (size_t i = 0; i < key.component_count; i++)
+            hash = base::HashCombine(hash, base::HashPointer(key.components[i]));
+        return static_cast<size_t>(hash);
+    }
+
+}
 }
-}
\ No newline at end of file
@@ -1,25 +1,129 @@
 #ifndef _BLVM_CORE_BLVM_CONTEXT_HPP
 #define _BLVM_CORE_BLVM_CONTEXT_HPP
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "../base/noncopyable.hpp"
-#include "../base/ref_ptr.hpp"
+#include "../base/arena.hpp"
+#include "../base/string_interner.hpp"
+#include "data_layout.hpp"
 #include "type.hpp"
 
 namespace blvm {
 namespace core {
 
+    // Owns the types shared by every module loaded into it. Structurally identical types obtained
+    // through the Obtain*Type() factories are the same object, so type equality is a pointer compare.
+    // All types are bump-allocated from one arena and released together with the context.
+    // Module-level names (sections, GC strategies, struct names) are interned here as well, so modules loaded
+    // into the same context share them.
+    // Types cache their layout, so they are uniqued per DataLayout: modules with equal layouts share their types,
+    // a module with another layout gets a set of its own.
+    // Not thread safe: types are only created by the module-level parse.
     class BLVMContext {
     public:
         BLVMContext();
         ~BLVMContext();
+
+        size_t GetUniquedTypeCount() const;
+
+        size_t GetTypeArenaSize() const {
+            return type_arena_.GetReservedSize();
+        }
+
+        base::InternedString Intern(base::StringPiece str) {
+            return string_interner_.Intern(str);
+        }
+
+        const base::StringInterner& GetStringInterner() const {
+            return string_interner_;
+        }
+
+        // Selects the types that the Obtain*Type() factories return and ComputeTypeLayout() lays out: those of
+        // an equal layout (DataLayout::operator==) set before, or a new set. The first call keeps the types
+        // obtained so far for description. Returns false on a malformed layout.
+        bool SetDataLayout(const std::string& description);
+
+        const DataLayout& GetDataLayout() const {
+            return layout_types_->data_layout;
+        }
+
+        // Tells which set of types SetDataLayout() selected. Types obtained under another one have to be obtained
+        // again before they are laid out.
+        size_t GetLayoutTypesIndex() const {
+            return layout_types_index_;
+        }
+
+        // Fills in the layout of type and of everything it contains by value, types already laid out are
+        // skipped. Returns false if an aggregate contains an unsized type or itself by value.
+        bool ComputeTypeLayout(TypeRef type);
+    private:
+        // (type code, scalar operands, component types) of a uniqued type. Single component types keep
+        // the component pointer in operand1, lists point at caller storage for lookups and at the arena
+        // once inserted.
+        struct TypeKey {
+            bitcode::TypeCodes type_code;
+            uint64_t operand0;
+            uint64_t operand1;
+            const TypeRef* components;
+            size_t component_count;
+
+            bool operator==(const TypeKey& rhs) const;
+        };
+
+        struct TypeKeyHash {
+            size_t operator()(const TypeKey& key) const;
+        };
+
+        // The types of the modules with one DataLayout.
+        struct LayoutTypes {
+            DataLayout data_layout;
+            bool has_data_layout;  // false until the first SetDataLayout()
+
+            TypeRef type_void, type_half, type_float, type_double;
+            TypeRef type_x86_fp80, type_x86_mmx, type_fp128, type_ppc_fp128;
+            TypeRef type_label, type_metadata;
+            TypeRef type_int1, type_int8, type_int16, type_int32, type_int64;
+
+            std::unordered_map<TypeKey, TypeRef, TypeKeyHash> uniqued_types;
+        };
+
+        // create(components) builds the type around the arena copy of key.components.
+        template <typename CreateFunc>
+        TypeRef ObtainUniquedType(const TypeKey& key, CreateFunc create) {
+            auto& uniqued_types = layout_types_->uniqued_types;
+            auto iter = uniqued_types.find(key);
+            if (iter != uniqued_types.end())
+                return iter->second;
+
+            TypeKey stored_key = key;
+            stored_key.components = CopyTypeList(key.components, key.component_count);
+            TypeRef type = create(stored_key.components);
+            uniqued_types.emplace(stored_key, type);
+            return type;
+        }
+
+        void AddLayoutTypes();
+        const TypeRef* CopyTypeList(const TypeRef* types, size_t count);
     private:
-        TypeRef type_void_, type_half_, type_float_, type_double_;
-        TypeRef type_x86_fp80_, type_x86_mmx, type_fp128_, type_ppc_fp128_;
-        TypeRef type_label_, type_metadata_;
-        TypeRef type_int1_, type_int8_, type_int16_, type_int32_, type_int64_;
+        base::Arena type_arena_;
+        base::StringInterner string_interner_;
+
+        std::vector<std::unique_ptr<LayoutTypes>> layout_types_list_;
+        LayoutTypes* layout_types_;  // selected by SetDataLayout()
+        size_t layout_types_index_;
 
         friend class Type;
         friend class IntegerType;
+        friend class PointerType;
+        friend class ArrayType;
+        friend class VectorType;
+        friend class StructType;
+        friend class FunctionType;
         DISALLOW_COPY_AND_ASSIGN(BLVMContext);
     };
 
@@ -0,0 +1,314 @@
+#include "constant.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "type.hpp"
+
+using namespace blvm::bitcode;
+
+namespace blvm {
+namespace core {
+
+    namespace {
+
+        uint64_t LoadBits(const uint8_t* source, size_t size) {
+            uint64_t value = 0;
+            memcpy(&value, source, std::min<size_t>(size, sizeof(value)));
+            return value;
+        }
+
+        void StoreBits(uint8_t* dest, uint64_t value, size_t size) {
+            memcpy(dest, &value, std::min<size_t>(size, sizeof(value)));
+        }
+
+        uint64_t SignExtend(uint64_t value, uint32_t bit_width) {
+            if (bit_width == 0 || bit_width >= 64)
+                return value;
+            uint64_t sign = 1ull << (bit_width - 1);
+            return ((value & ((sign << 1) - 1)) ^ sign) - sign;
+        }
+
+        uint64_t MaskToWidth(uint64_t value, uint32_t bit_width) {
+            return bit_width >= 64 ? value : value & ((1ull << bit_width) - 1);
+        }
+
+        // An integer of bit_width bits from 64-bit words, least significant first, sign-extended from the
+        // last word. The bits above bit_width in the last byte stay zero.
+        void WriteInteger(uint8_t* dest, const uint64_t* words, size_t word_count, uint32_t bit_width) {
+            size_t size = (bit_width + 7) / 8;
+            uint64_t extension = (int64_t)words[word_count - 1] < 0 ? ~0ull : 0;
+            for (size_t i = 0; i < size; i++) {
+                uint64_t word = i / 8 < word_count ? words[i / 8] : extension;
+                dest[i] = (uint8_t)(word >> (i % 8 * 8));
+            }
+            if (bit_width % 8 != 0)
+                dest[size - 1] &= (uint8_t)((1u << (bit_width % 8)) - 1);
+        }
+
+        uint32_t GetBitWidth(TypeRef type) {
+            if (type->GetTypeCode() == TypeCodes::kInteger)
+                return static_cast<const IntegerType*>(type)->GetBitWidth();
+            return (uint32_t)type->GetSizeInBits();
+        }
+
+        bool IsIntegerOrPointer(TypeRef type) {
+            return type->GetTypeCode() == TypeCodes::kInteger || type->GetTypeCode() == TypeCodes::kPointer;
+        }
+
+        // Element type, count and distance between elements of an array or vector.
+        bool GetSequenceLayout(TypeRef type, TypeRef& out_element, uint64_t& out_count, uint64_t& out_stride) {
+            if (type->GetTypeCode() == TypeCodes::kArray) {
+                auto array_type = static_cast<const ArrayType*>(type);
+                out_element = array_type->GetElementType();
+                out_count = array_type->GetElementCount();
+                out_stride = out_element->GetAllocSize();
+                return true;
+            }
+            if (type->GetTypeCode() == TypeCodes::kVector) {
+                // vector elements are packed, which only has a byte layout for whole-byte elements
+                auto vector_type = static_cast<const VectorType*>(type);
+                out_element = vector_type->GetElementType();
+                out_count = vector_type->GetElementCount();
+                if (out_element->GetSizeInBits() % 8 != 0)
+                    return false;
+                out_stride = out_element->GetSizeInBits() / 8;
+                return true;
+            }
+            return false;
+        }
+
+        // A raw element of a DATA or STRING record.
+        bool WriteElement(uint8_t* dest, TypeRef element_type, uint64_t value) {
+            switch (element_type->GetTypeCode()) {
+                case TypeCodes::kInteger:
+                    WriteInteger(dest, &value, 1, GetBitWidth(element_type));
+                    return true;
+                case TypeCodes::kHalf:
+                case TypeCodes::kFloat:
+                case TypeCodes::kDouble:
+                    StoreBits(dest, value, element_type->GetStoreSize());
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        bool WriteFloat(const ConstantRecord& record, const uint64_t* operands, uint8_t* dest) {
+            if (record.operand_count < 1)
+                return false;
+            switch (record.type->GetTypeCode()) {
+                case TypeCodes::kHalf:
+                case TypeCodes::kFloat:
+                case TypeCodes::kDouble:
+                    StoreBits(dest, operands[0], record.type->GetStoreSize());
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        bool WriteAggregate(const ConstantRecord& record, const uint64_t* operands, ConstantResolver& resolver,
+                            uint8_t* dest) {
+            if (record.type->GetTypeCode() == TypeCodes::kStruct_ANON ||
+                record.type->GetTypeCode() == TypeCodes::kStruct_NAMED) {
+                auto struct_type = static_cast<const StructType*>(record.type);
+                TypeList members = struct_type->GetMembers();
+                if (members.size() != record.operand_count)
+                    return false;
+                for (size_t i = 0; i < members.size(); i++) {
+                    if (!resolver.WriteValueImage(operands[i], members[i], dest + struct_type->GetMemberOffset(i)))
+                        return false;
+                }
+                return true;
+            }
+
+            TypeRef element_type;
+            uint64_t count, stride;
+            if (!GetSequenceLayout(record.type, element_type, count, stride) || count != record.operand_count)
+                return false;
+            for (uint64_t i = 0; i < count; i++) {
+                if (!resolver.WriteValueImage(operands[i], element_type, dest + i * stride))
+                    return false;
+            }
+            return true;
+        }
+
+        // STRING and CSTRING (a STRING with an implicit trailing zero) hold one element per operand, as DATA does.
+        bool WriteElements(const ConstantRecord& record, const uint64_t* operands, uint8_t* dest) {
+            TypeRef element_type;
+            uint64_t count, stride;
+            if (!GetSequenceLayout(record.type, element_type, count, stride))
+                return false;
+            uint64_t expected_count = record.code == ConstantsCodes::kCString ? count - 1 : count;
+            if (count == 0 || record.operand_count != expected_count)
+                return false;
+            for (uint64_t i = 0; i < record.operand_count; i++) {
+                if (!WriteElement(dest + i * stride, element_type, operands[i]))
+                    return false;
+            }
+            return true;
+        }
+
+        // Integer and pointer casts, and bitcasts between same-sized scalars: all fit in 64 bits.
+        bool WriteCast(const ConstantRecord& record, const uint64_t* operands, ConstantResolver& resolver,
+                       uint8_t* dest) {
+            if (record.operand_count != 3)
+                return false;
+            TypeRef source_type = resolver.GetTypeByIndex(operands[1]);
+            TypeRef dest_type = record.type;
+            if (source_type == nullptr || !source_type->IsSized() || source_type->GetStoreSize() > 8 ||
+                dest_type->GetStoreSize() > 8)
+                return false;
+
+            uint8_t source_image[8] = {};
+            if (!resolver.WriteValueImage(operands[2], source_type, source_image))
+                return false;
+            uint64_t value = LoadBits(source_image, sizeof(source_image));
+            uint32_t source_width = GetBitWidth(source_type);
+            uint32_t dest_width = GetBitWidth(dest_type);
+
+            switch ((CastOpcodes)operands[0]) {
+                case CastOpcodes::kTrunc:
+                case CastOpcodes::kZExt:
+                case CastOpcodes::kPtrToInt:
+                case CastOpcodes::kIntToPtr:
+                    if (!IsIntegerOrPointer(source_type) || !IsIntegerOrPointer(dest_type))
+                        return false;
+                    value = MaskToWidth(value, dest_width);
+                    break;
+                case CastOpcodes::kSExt:
+                    if (source_type->GetTypeCode() != TypeCodes::kInteger ||
+                        dest_type->GetTypeCode() != TypeCodes::kInteger)
+                        return false;
+                    value = MaskToWidth(SignExtend(value, source_width), dest_width);
+                    break;
+                case CastOpcodes::kBitCast:
+                case CastOpcodes::kAddrSpaceCast:
+                    if (source_type->GetSizeInBits() != dest_type->GetSizeInBits())
+                        return false;
+                    break;
+                default:
+                    return false;
+            }
+            StoreBits(dest, value, dest_type->GetStoreSize());
+            return true;
+        }
+
+        // [pointee type (when the count is odd), inrange index (kCEGEPWithInrangeIndex only), (type, value)*]
+        bool WriteGEP(const ConstantRecord& record, const uint64_t* operands, ConstantResolver& resolver,
+                      uint8_t* dest) {
+            size_t count = record.operand_count;
+            size_t index = 0;
+            TypeRef source_type = nullptr;
+            if (record.code == ConstantsCodes::kCEGEPWithInrangeIndex || count % 2 == 1) {
+                if (count < 1 || (source_type = resolver.GetTypeByIndex(operands[index++])) == nullptr)
+                    return false;
+            }
+            if (record.code == ConstantsCodes::kCEGEPWithInrangeIndex)
+                index++;
+            if (index > count || (count - index) < 2 || (count - index) % 2 != 0)
+                return false;
+            if (record.type->GetTypeCode() != TypeCodes::kPointer || record.type->GetStoreSize() != 8)
+                return false;
+
+            TypeRef base_type = resolver.GetTypeByIndex(operands[index]);
+            if (base_type == nullptr || base_type->GetTypeCode() != TypeCodes::kPointer)
+                return false;
+            if (source_type == nullptr)
+                source_type = static_cast<const PointerType*>(base_type)->GetPointeeType();
+
+            uint8_t image[8] = {};
+            if (!resolver.WriteValueImage(operands[index + 1], base_type, image))
+                return false;
+            uint64_t address = LoadBits(image, sizeof(image));
+
+            TypeRef current_type = source_type;
+            bool is_first = true;
+            for (index += 2; index < count; index += 2) {
+                TypeRef index_type = resolver.GetTypeByIndex(operands[index]);
+                if (index_type == nullptr || index_type->GetTypeCode() != TypeCodes::kInteger ||
+                    GetBitWidth(index_type) > 64)
+                    return false;
+                memset(image, 0, sizeof(image));
+                if (!resolver.WriteValueImage(operands[index + 1], index_type, image))
+                    return false;
+                uint64_t value = SignExtend(LoadBits(image, sizeof(image)), GetBitWidth(index_type));
+
+                if (!current_type->IsSized())
+                    return false;
+                if (is_first) {
+                    // steps over whole objects of the source type
+                    address += value * current_type->GetAllocSize();
+                    is_first = false;
+                    continue;
+                }
+
+                TypeCodes type_code = current_type->GetTypeCode();
+                if (type_code == TypeCodes::kStruct_ANON || type_code == TypeCodes::kStruct_NAMED) {
+                    auto struct_type = static_cast<const StructType*>(current_type);
+                    if (value >= struct_type->GetMembers().size())
+                        return false;
+                    address += struct_type->GetMemberOffset((size_t)value);
+                    current_type = struct_type->GetMembers()[(size_t)value];
+                } else {
+                    TypeRef element_type;
+                    uint64_t element_count, stride;
+                    if (!GetSequenceLayout(current_type, element_type, element_count, stride))
+                        return false;
+                    address += value * stride;
+                    current_type = element_type;
+                }
+            }
+            StoreBits(dest, address, sizeof(address));
+            return true;
+        }
+
+    }
+
+    bool WriteConstantImage(const ConstantRecord& record, const uint64_t* operands, ConstantResolver& resolver,
+                            uint8_t* dest) {
+        if (!record.type->IsSized())
+            return false;
+
+        switch (record.code) {
+            case ConstantsCodes::kNull:
+            case ConstantsCodes::kUndef:
+            case ConstantsCodes::kPoison:
+                return true;
+            case ConstantsCodes::kInteger: {
+                if (record.operand_count < 1 || record.type->GetTypeCode() != TypeCodes::kInteger)
+                    return false;
+                uint64_t value = DecodeSignRotatedValue(operands[0]);
+                WriteInteger(dest, &value, 1, GetBitWidth(record.type));
+                return true;
+            }
+            case ConstantsCodes::kWideInteger: {
+                if (record.operand_count < 1 || record.type->GetTypeCode() != TypeCodes::kInteger)
+                    return false;
+                std::vector<uint64_t> words(operands, operands + record.operand_count);
+                for (uint64_t& word : words)
+                    word = DecodeSignRotatedValue(word);
+                WriteInteger(dest, words.data(), words.size(), GetBitWidth(record.type));
+                return true;
+            }
+            case ConstantsCodes::kFloat:
+                return WriteFloat(record, operands, dest);
+            case ConstantsCodes::kAggregate:
+                return WriteAggregate(record, operands, resolver, dest);
+            case ConstantsCodes::kString:
+            case ConstantsCodes::kCString:
+            case ConstantsCodes::kData:
+                return WriteElements(record, operands, dest);
+            case ConstantsCodes::kCECast:
+                return WriteCast(record, operands, resolver, dest);
+            case ConstantsCodes::kCEGEP:
+            case ConstantsCodes::kCEInboundsGEP:
+            case ConstantsCodes::kCEGEPWithInrangeIndex:
+                return WriteGEP(record, operands, resolver, dest);
+            default:
+                return false;
+        }
+    }
+
+}
+}
@@ -0,0 +1,44 @@
+#ifndef _BLVM_CORE_CONSTANT_HPP
+#define _BLVM_CORE_CONSTANT_HPP
+
+#include <cstdint>
+#include "../bitcode/bitcode_llvm.hpp"
+#include "core_fwd.hpp"
+
+namespace blvm {
+namespace core {
+
+    // A CONSTANTS_BLOCK record, kept as it was read and evaluated once the values it refers to have
+    // addresses. Operands are as in the bitcode: value ids for aggregates and expressions, raw values for
+    // integers, floats and data arrays.
+    struct ConstantRecord {
+        TypeRef type;
+        bitcode::ConstantsCodes code;
+        uint32_t operand_begin;  // into the operand array of the owner
+        uint32_t operand_count;
+    };
+
+    // The values a constant refers to, by the value ids of the module or function it belongs to.
+    class ConstantResolver {
+    public:
+        // nullptr for an invalid index.
+        virtual TypeRef GetTypeByIndex(uint64_t type_index) = 0;
+
+        // Writes the in-memory image of value_id, which must have the given type, to dest
+        // (type->GetStoreSize() bytes). Returns false if the value has no image.
+        virtual bool WriteValueImage(uint64_t value_id, TypeRef type, uint8_t* dest) = 0;
+    protected:
+        ~ConstantResolver() = default;
+    };
+
+    // Writes the in-memory image of a constant in host byte order: record.type->GetStoreSize() bytes at dest,
+    // which the caller zeroes first (padding and null values stay zero). Returns false for what the evaluation
+    // does not cover: x86_fp80/fp128/ppc_fp128 values, block addresses, inline asm, expressions other than integer
+    // and pointer casts and GEPs. Malformed records fail the same way.
+    bool WriteConstantImage(const ConstantRecord& record, const uint64_t* operands, ConstantResolver& resolver,
+                            uint8_t* dest);
+
+}
+}
+
+#endif // _BLVM_CORE_CONSTANT_HPP
@@ -9,8 +9,21 @@ namespace core {
     class BLVMContext;
     class Module;
 
+    // Types are owned by the context arena, see type.hpp.
     class Type;
-    typedef base::RefPtr<Type> TypeRef;
+    class StructType;
+    typedef Type* TypeRef;
+
+    class Function;
+    typedef base::RefPtr<Function> FunctionRef;
+
+    class GlobalVariable;
+    typedef base::RefPtr<GlobalVariable> GlobalVariableRef;
+
+    class FunctionBody;
+
+    class Materializer;
+    typedef base::RefPtr<Materializer> MaterializerRef;
 
 }
 }
@@ -0,0 +1,233 @@
+#include "data_layout.hpp"
+#include <cstdlib>
+
+namespace blvm {
+namespace core {
+
+    namespace {
+
+        uint64_t PowerOf2Ceil(uint64_t value) {
+            uint64_t result = 1;
+            while (result < value)
+                result <<= 1;
+            return result;
+        }
+
+        // Splits "a:b:c" into its fields.
+        std::vector<std::string> SplitFields(const std::string& spec) {
+            std::vector<std::string> fields;
+            size_t begin = 0;
+            while (true) {
+                size_t end = spec.find(':', begin);
+                fields.push_back(spec.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+                if (end == std::string::npos)
+                    return fields;
+                begin = end + 1;
+            }
+        }
+
+        bool ParseNumber(const std::string& text, uint32_t* out) {
+            if (text.empty() || text.size() > 9)
+                return false;
+            for (char c : text) {
+                if (c < '0' || c > '9')
+                    return false;
+            }
+            *out = static_cast<uint32_t>(strtoul(text.c_str(), nullptr, 10));
+            return true;
+        }
+
+        // Alignment fields are in bits and must be whole bytes, 0 only where allow_zero.
+        bool ParseAlignment(const std::string& text, bool allow_zero, uint32_t* out_bytes) {
+            uint32_t bits = 0;
+            if (!ParseNumber(text, &bits) || bits % 8 != 0 || (bits == 0 && !allow_zero))
+                return false;
+            *out_bytes = bits == 0 ? 1 : bits / 8;
+            return true;
+        }
+
+    }
+
+    DataLayout::DataLayout() :
+            little_endian_(true), stack_alignment_(0), aggregate_alignment_(1) {
+        integer_alignments_ = {{1, 1}, {8, 1}, {16, 2}, {32, 4}, {64, 4}};
+        float_alignments_ = {{16, 2}, {32, 4}, {64, 8}, {128, 16}};
+        vector_alignments_ = {{64, 8}, {128, 16}};
+        pointer_specs_ = {{0, 8, 8}};
+    }
+
+    bool DataLayout::Parse(const std::string& description) {
+        size_t begin = 0;
+        while (begin < description.size()) {
+            size_t end = description.find('-', begin);
+            if (end == std::string::npos)
+                end = description.size();
+            std::string spec = description.substr(begin, end - begin);
+            begin = end + 1;
+
+            if (spec.empty())
+                return false;
+
+            std::vector<std::string> fields = SplitFields(spec);
+            char kind = spec[0];
+            std::string head = fields[0].substr(1);
+
+            switch (kind) {
+                case 'e':
+                case 'E':
+                    if (spec.size() != 1)
+                        return false;
+                    little_endian_ = (kind == 'e');
+                    break;
+                case 'S':
+                    if (!ParseAlignment(head, true, &stack_alignment_))
+                        return false;
+                    if (head == "0")
+                        stack_alignment_ = 0;
+                    break;
+                case 'p': {
+                    // p[n]:<size>:<abi>[:<pref>[:<idx>]]
+                    PointerSpec pointer = {0, 0, 0};
+                    uint32_t size_bits = 0;
+                    if (!head.empty() && !ParseNumber(head, &pointer.address_space))
+                        return false;
+                    if (fields.size() < 3 || !ParseNumber(fields[1], &size_bits) || size_bits == 0 ||
+                        size_bits % 8 != 0 || !ParseAlignment(fields[2], false, &pointer.abi_alignment))
+                        return false;
+                    pointer.size = size_bits / 8;
+
+                    bool replaced = false;
+                    for (PointerSpec& existing : pointer_specs_) {
+                        if (existing.address_space == pointer.address_space) {
+                            existing = pointer;
+                            replaced = true;
+                        }
+                    }
+                    if (!replaced)
+                        pointer_specs_.push_back(pointer);
+                    break;
+                }
+                case 'i':
+                case 'f':
+                case 'v': {
+                    // <kind><size>:<abi>[:<pref>]
+                    uint32_t bit_width = 0;
+                    uint32_t abi_alignment = 0;
+                    if (!ParseNumber(head, &bit_width) || bit_width == 0 || fields.size() < 2 ||
+                        !ParseAlignment(fields[1], false, &abi_alignment))
+                        return false;
+                    if (kind == 'i')
+                        SetAlignSpec(integer_alignments_, bit_width, abi_alignment);
+                    else if (kind == 'f')
+                        SetAlignSpec(float_alignments_, bit_width, abi_alignment);
+                    else
+                        SetAlignSpec(vector_alignments_, bit_width, abi_alignment);
+                    break;
+                }
+                case 'a':
+                    // a[0]:<abi>[:<pref>]
+                    if (fields.size() < 2 || !ParseAlignment(fields[1], true, &aggregate_alignment_))
+                        return false;
+                    break;
+                case 'm':  // symbol mangling
+                case 'n':  // native integer widths, also "ni" non-integral address spaces
+                case 'A':  // alloca address space
+                case 'P':  // program address space
+                case 'G':  // global address space
+                case 'F':  // function pointer alignment
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool DataLayout::operator==(const DataLayout& rhs) const {
+        if (little_endian_ != rhs.little_endian_ || stack_alignment_ != rhs.stack_alignment_ ||
+            aggregate_alignment_ != rhs.aggregate_alignment_)
+            return false;
+
+        // Vector alignments fall back on the element size, only the same explicit specs are sure to agree.
+        if (vector_alignments_.size() != rhs.vector_alignments_.size())
+            return false;
+        for (size_t i = 0; i < vector_alignments_.size(); i++) {
+            if (vector_alignments_[i].bit_width != rhs.vector_alignments_[i].bit_width ||
+                vector_alignments_[i].abi_alignment != rhs.vector_alignments_[i].abi_alignment)
+                return false;
+        }
+
+        // Every other lookup only changes at a width or address space listed by one of the two, so the layouts
+        // agree everywhere if they agree there.
+        for (const DataLayout* layout : {this, &rhs}) {
+            for (const PointerSpec& spec : layout->pointer_specs_) {
+                if (GetPointerSize(spec.address_space) != rhs.GetPointerSize(spec.address_space) ||
+                    GetPointerAlignment(spec.address_space) != rhs.GetPointerAlignment(spec.address_space))
+                    return false;
+            }
+            for (const AlignSpec& spec : layout->integer_alignments_) {
+                if (GetIntegerAlignment(spec.bit_width) != rhs.GetIntegerAlignment(spec.bit_width))
+                    return false;
+            }
+            for (const AlignSpec& spec : layout->float_alignments_) {
+                if (GetFloatAlignment(spec.bit_width) != rhs.GetFloatAlignment(spec.bit_width))
+                    return false;
+            }
+        }
+        // integers wider than any spec take the widest one
+        return GetIntegerAlignment(UINT32_MAX) == rhs.GetIntegerAlignment(UINT32_MAX);
+    }
+
+    void DataLayout::SetAlignSpec(std::vector<AlignSpec>& specs, uint32_t bit_width, uint32_t abi_alignment) {
+        auto iter = specs.begin();
+        while (iter != specs.end() && iter->bit_width < bit_width)
+            ++iter;
+        if (iter != specs.end() && iter->bit_width == bit_width)
+            iter->abi_alignment = abi_alignment;
+        else
+            specs.insert(iter, {bit_width, abi_alignment});
+    }
+
+    const DataLayout::PointerSpec& DataLayout::GetPointerSpec(uint32_t address_space) const {
+        for (const PointerSpec& spec : pointer_specs_) {
+            if (spec.address_space == address_space)
+                return spec;
+        }
+        return pointer_specs_.front();
+    }
+
+    uint32_t DataLayout::GetPointerSize(uint32_t address_space) const {
+        return GetPointerSpec(address_space).size;
+    }
+
+    uint32_t DataLayout::GetPointerAlignment(uint32_t address_space) const {
+        return GetPointerSpec(address_space).abi_alignment;
+    }
+
+    // Same fallback as LLVM: the next wider specified integer, else the widest one.
+    uint32_t DataLayout::GetIntegerAlignment(uint32_t bit_width) const {
+        for (const AlignSpec& spec : integer_alignments_) {
+            if (spec.bit_width >= bit_width)
+                return spec.abi_alignment;
+        }
+        return integer_alignments_.back().abi_alignment;
+    }
+
+    uint32_t DataLayout::GetFloatAlignment(uint32_t bit_width) const {
+        for (const AlignSpec& spec : float_alignments_) {
+            if (spec.bit_width == bit_width)
+                return spec.abi_alignment;
+        }
+        return static_cast<uint32_t>(PowerOf2Ceil((bit_width + 7) / 8));
+    }
+
+    uint32_t DataLayout::GetVectorAlignment(uint64_t bit_width, uint64_t elements_alloc_size) const {
+        for (const AlignSpec& spec : vector_alignments_) {
+            if (spec.bit_width == bit_width)
+                return spec.abi_alignment;
+        }
+        return static_cast<uint32_t>(PowerOf2Ceil(elements_alloc_size));
+    }
+
+}
+}
@@ -0,0 +1,76 @@
+#ifndef _BLVM_CORE_DATA_LAYOUT_HPP
+#define _BLVM_CORE_DATA_LAYOUT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace blvm {
+namespace core {
+
+    // Target layout rules from an LLVM datalayout string. Sizes and alignments are in bytes,
+    // only ABI alignments are kept. Specs that do not affect type layout (mangling, native
+    // integer widths, address spaces of allocas/globals/programs) are accepted and ignored.
+    class DataLayout {
+    public:
+        // LLVM's built-in defaults, what an empty datalayout string means.
+        DataLayout();
+
+        // Applies the specs of description on top of the current rules. Returns false if a spec is malformed.
+        bool Parse(const std::string& description);
+
+        bool IsLittleEndian() const {
+            return little_endian_;
+        }
+
+        uint32_t GetStackAlignment() const {
+            return stack_alignment_;
+        }
+
+        uint32_t GetAggregateAlignment() const {
+            return aggregate_alignment_;
+        }
+
+        uint32_t GetPointerSize(uint32_t address_space) const;
+        uint32_t GetPointerAlignment(uint32_t address_space) const;
+        uint32_t GetIntegerAlignment(uint32_t bit_width) const;
+        uint32_t GetFloatAlignment(uint32_t bit_width) const;
+        // Unspecified widths get natural alignment: elements_alloc_size (element alloc size * count)
+        // rounded up to a power of 2.
+        uint32_t GetVectorAlignment(uint64_t bit_width, uint64_t elements_alloc_size) const;
+
+        // By the rules, not the spelling: specs that restate a default or a fallback (an empty string against
+        // LLVM's defaults written out, a pointer spec matching address space 0) do not make a difference.
+        bool operator==(const DataLayout& rhs) const;
+
+        bool operator!=(const DataLayout& rhs) const {
+            return !(*this == rhs);
+        }
+    private:
+        struct AlignSpec {
+            uint32_t bit_width;
+            uint32_t abi_alignment;
+        };
+
+        struct PointerSpec {
+            uint32_t address_space;
+            uint32_t size;
+            uint32_t abi_alignment;
+        };
+
+        static void SetAlignSpec(std::vector<AlignSpec>& specs, uint32_t bit_width, uint32_t abi_alignment);
+        const PointerSpec& GetPointerSpec(uint32_t address_space) const;
+    private:
+        bool little_endian_;
+        uint32_t stack_alignment_;
+        uint32_t aggregate_alignment_;
+        std::vector<AlignSpec> integer_alignments_;  // sorted by bit_width
+        std::vector<AlignSpec> float_alignments_;
+        std::vector<AlignSpec> vector_alignments_;
+        std::vector<PointerSpec> pointer_specs_;     // address space 0 first
+    };
+
+}
+}
+
+#endif // _BLVM_CORE_DATA_LAYOUT_HPP
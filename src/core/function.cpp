@@ -1,9 +1,43 @@
 #include "function.hpp"
+#include "function_body.hpp"
+#include "type.hpp"
 
 namespace blvm {
 namespace core {
 
+    namespace {
 
+        const char* const kNoOpIntrinsicPrefixes[] = {
+            "llvm.dbg.",
+            "llvm.lifetime.",
+            "llvm.assume",
+            "llvm.donothing",
+            "llvm.experimental.noalias.scope.decl"
+        };
+
+    }
+
+    Function::Function(TypeRef function_type, Linkage linkage, bool is_declaration) :
+            function_type_(function_type), linkage_(linkage), is_declaration_(is_declaration),
+            is_materialized_(false), body_bit_offset_(0), basic_block_count_(0), instruction_count_(0) {}
+
+    Function::~Function() {
+
+    }
+
+    bool Function::IsNoOpIntrinsic() const {
+        if (!is_declaration_ || !name_.StartsWith("llvm."))
+            return false;
+        for (const char* prefix : kNoOpIntrinsicPrefixes) {
+            if (name_.StartsWith(prefix))
+                return true;
+        }
+        return false;
+    }
+
+    void Function::SetBody(std::unique_ptr<FunctionBody> body) {
+        body_ = std::move(body);
+    }
 
 }
 }
@@ -1,18 +1,92 @@
 #ifndef _BLVM_CORE_FUNCTION_HPP
 #define _BLVM_CORE_FUNCTION_HPP
 
+#include <cstdint>
+#include <memory>
 #include "../base/ref_base.hpp"
+#include "../base/string_piece.hpp"
+#include "core_fwd.hpp"
+#include "linkage.hpp"
 
 namespace blvm {
 namespace core {
 
     class Function : public base::RefBase {
     public:
-        Function() = default;
-        virtual ~Function() override = default;
+        Function(TypeRef function_type, Linkage linkage, bool is_declaration);
+        virtual ~Function() override;
 
-    private:
+        TypeRef GetFunctionType() const {
+            return function_type_;
+        }
+
+        // Points into the bitcode buffer (the STRTAB of a v2 module), which the module's materializer keeps
+        // alive, or into the context's interned strings for a module read from a stream. Empty for v1 modules.
+        base::StringPiece GetName() const {
+            return name_;
+        }
+
+        void SetName(base::StringPiece name) {
+            name_ = name;
+        }
+
+        // Intrinsics without an effect on execution: debug info, lifetime markers, assumptions. Their calls
+        // can be dropped. False while the function has no name yet.
+        bool IsNoOpIntrinsic() const;
+
+        Linkage GetLinkage() const {
+            return linkage_;
+        }
+
+        // Declarations (prototypes) have no body to materialize.
+        bool IsDeclaration() const {
+            return is_declaration_;
+        }
+
+        bool IsMaterialized() const {
+            return is_materialized_;
+        }
 
+        // Bit offset of the FUNCTION_BLOCK in the bitcode, right after its block id. 0 if unknown.
+        uint64_t GetBodyBitOffset() const {
+            return body_bit_offset_;
+        }
+
+        void SetBodyBitOffset(uint64_t bit_offset) {
+            body_bit_offset_ = bit_offset;
+        }
+
+        uint32_t GetBasicBlockCount() const {
+            return basic_block_count_;
+        }
+
+        uint32_t GetInstructionCount() const {
+            return instruction_count_;
+        }
+
+        void SetBodyInfo(uint32_t basic_block_count, uint32_t instruction_count) {
+            basic_block_count_ = basic_block_count;
+            instruction_count_ = instruction_count;
+            is_materialized_ = true;
+        }
+
+        // The lowered body, set when the function is materialized. nullptr if it uses something the lowering
+        // does not cover, the function is materialized all the same but cannot be executed.
+        FunctionBody* GetBody() const {
+            return body_.get();
+        }
+
+        void SetBody(std::unique_ptr<FunctionBody> body);
+    private:
+        TypeRef function_type_;
+        base::StringPiece name_;
+        Linkage linkage_;
+        bool is_declaration_;
+        bool is_materialized_;
+        uint64_t body_bit_offset_;
+        uint32_t basic_block_count_;
+        uint32_t instruction_count_;
+        std::unique_ptr<FunctionBody> body_;
     };
 
 }
@@ -0,0 +1,138 @@
+#include "function_body.hpp"
+#include <string>
+
+namespace blvm {
+namespace core {
+
+    namespace {
+
+        std::string GetTypeSuffix(const Instruction& instruction) {
+            if (instruction.type == ValueType::kIntN)
+                return ".i" + std::to_string(instruction.width);
+            return std::string(".") + GetValueTypeName(instruction.type);
+        }
+
+        const char* GetPredicateName(Opcode opcode, uint8_t predicate) {
+            static const char* const kFCmpNames[] = {"false", "oeq", "ogt", "oge", "olt", "ole", "one", "ord",
+                                                     "uno", "ueq", "ugt", "uge", "ult", "ule", "une", "true"};
+            static const char* const kICmpNames[] = {"eq", "ne", "ugt", "uge", "ult", "ule", "sgt", "sge", "slt",
+                                                     "sle"};
+            if (opcode == Opcode::kFCmp)
+                return predicate < 16 ? kFCmpNames[predicate] : "?";
+            return predicate >= 32 && predicate < 42 ? kICmpNames[predicate - 32] : "?";
+        }
+
+    }
+
+    void FunctionBody::Dump(FILE* out) const {
+        fprintf(out, "  ; %zu registers, %u arguments, %u blocks\n", registers.size(), argument_count,
+                basic_block_count);
+        for (size_t i = argument_count; i < registers.size(); i++) {
+            if (registers[i] != 0)
+                fprintf(out, "  ; %%%zu = 0x%llx\n", i, (unsigned long long)registers[i]);
+        }
+
+        for (size_t pc = 0; pc < code.size(); pc++) {
+            const Instruction& instruction = code[pc];
+            Opcode generic = GetGenericOpcode(instruction.opcode);
+            bool is_generic = generic == instruction.opcode;
+            const char* name = GetOpcodeName(instruction.opcode);
+            // the names of specialized opcodes carry their types and predicate
+            std::string suffix = is_generic ? GetTypeSuffix(instruction) : std::string();
+            fprintf(out, "%6zu  ", pc);
+
+            switch (generic) {
+                case Opcode::kFNeg:
+                case Opcode::kMove:
+                case Opcode::kLoad:
+                    fprintf(out, "%%%u = %s%s %%%u\n", instruction.dest, name, suffix.c_str(), instruction.a);
+                    break;
+                case Opcode::kTrunc:
+                case Opcode::kZExt:
+                case Opcode::kSExt:
+                case Opcode::kFPToUI:
+                case Opcode::kFPToSI:
+                case Opcode::kUIToFP:
+                case Opcode::kSIToFP:
+                case Opcode::kFPTrunc:
+                case Opcode::kFPExt:
+                case Opcode::kPtrToInt:
+                case Opcode::kIntToPtr:
+                    if (is_generic) {
+                        fprintf(out, "%%%u = %s%s %%%u from %s/%u\n", instruction.dest, name, suffix.c_str(),
+                                instruction.a, GetValueTypeName((ValueType)instruction.aux), instruction.b);
+                    } else {
+                        fprintf(out, "%%%u = %s %%%u\n", instruction.dest, name, instruction.a);
+                    }
+                    break;
+                case Opcode::kICmp:
+                case Opcode::kFCmp:
+                    if (is_generic) {
+                        fprintf(out, "%%%u = %s.%s%s %%%u, %%%u\n", instruction.dest, name,
+                                GetPredicateName(instruction.opcode, instruction.aux), suffix.c_str(), instruction.a,
+                                instruction.b);
+                    } else {
+                        fprintf(out, "%%%u = %s %%%u, %%%u\n", instruction.dest, name, instruction.a, instruction.b);
+                    }
+                    break;
+                case Opcode::kSelect:
+                    fprintf(out, "%%%u = %s%s %%%u, %%%u, %%%u\n", instruction.dest, name, suffix.c_str(),
+                            instruction.a, instruction.b, instruction.c);
+                    break;
+                case Opcode::kAlloca:
+                    fprintf(out, "%%%u = %s %%%u x %u align %u\n", instruction.dest, name, instruction.a,
+                            instruction.b, instruction.c);
+                    break;
+                case Opcode::kStore:
+                    fprintf(out, "%s%s %%%u, %%%u\n", name, suffix.c_str(), instruction.a, instruction.b);
+                    break;
+                case Opcode::kPtrAdd:
+                    fprintf(out, "%%%u = %s %%%u, %lld\n", instruction.dest, name, instruction.a,
+                            (long long)((uint64_t)instruction.b | (uint64_t)instruction.c << 32));
+                    break;
+                case Opcode::kPtrAddScaled:
+                    fprintf(out, "%%%u = %s%s %%%u, %%%u x %u\n", instruction.dest, name, suffix.c_str(),
+                            instruction.a, instruction.b, instruction.c);
+                    break;
+                case Opcode::kCall:
+                    if (instruction.dest != kNoRegister)
+                        fprintf(out, "%%%u = ", instruction.dest);
+                    fprintf(out, "%s%s %%%u(", name, suffix.c_str(), instruction.a);
+                    for (uint32_t i = 0; i < instruction.c; i++)
+                        fprintf(out, "%s%%%u", i == 0 ? "" : ", ", call_arguments[instruction.b + i]);
+                    fprintf(out, ")\n");
+                    break;
+                case Opcode::kRet:
+                    if (instruction.a == kNoRegister)
+                        fprintf(out, "%s\n", name);
+                    else
+                        fprintf(out, "%s%s %%%u\n", name, suffix.c_str(), instruction.a);
+                    break;
+                case Opcode::kBr:
+                    fprintf(out, "%s @%u\n", name, instruction.a);
+                    break;
+                case Opcode::kCondBr:
+                    fprintf(out, "%s %%%u, @%u, @%u\n", name, instruction.a, instruction.b, instruction.c);
+                    break;
+                case Opcode::kSwitch:
+                    fprintf(out, "%s%s %%%u, default @%u", name, suffix.c_str(), instruction.a,
+                            switch_cases[instruction.b].target);
+                    for (uint32_t i = 1; i <= instruction.c; i++) {
+                        const SwitchCase& switch_case = switch_cases[instruction.b + i];
+                        fprintf(out, ", %llu: @%u", (unsigned long long)switch_case.value, switch_case.target);
+                    }
+                    fprintf(out, "\n");
+                    break;
+                case Opcode::kUnreachable:
+                    fprintf(out, "%s\n", name);
+                    break;
+                default:
+                    fprintf(out, "%%%u = %s%s %%%u, %%%u\n", instruction.dest, name, suffix.c_str(), instruction.a,
+                            instruction.b);
+                    break;
+            }
+        }
+    }
+
+}
+}
@@ -0,0 +1,45 @@
+#ifndef _BLVM_CORE_FUNCTION_BODY_HPP
+#define _BLVM_CORE_FUNCTION_BODY_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "../base/noncopyable.hpp"
+#include "instruction.hpp"
+
+namespace blvm {
+namespace core {
+
+    // The executable form of a function: a flat array of fixed-size instructions over a file of 64-bit
+    // registers, one per SSA value. Operands are register indexes and branch targets code indexes, both
+    // resolved while the bitcode is decoded (see bitcode::FunctionBlockParser), so there is no IR in between.
+    // Arguments take the first registers, constants are preset in `registers`, which a call copies into its
+    // frame. Phis are gone: their copies sit on the incoming edges.
+    class FunctionBody {
+    public:
+        struct SwitchCase {
+            uint64_t value;   // zero-extended like a register, unused for the default
+            uint32_t target;  // code index
+        };
+
+        std::vector<Instruction> code;
+        std::vector<uint64_t> registers;  // initial register file
+        std::vector<SwitchCase> switch_cases;
+        std::vector<uint32_t> call_arguments;  // argument registers of the calls
+        uint32_t argument_count;
+        uint32_t basic_block_count;
+        // The table Instruction::handler was filled from, nullptr until an interpreter has threaded the code.
+        const void* const* handler_table;
+    public:
+        FunctionBody() : argument_count(0), basic_block_count(0), handler_table(nullptr) {}
+
+        // One instruction per line, registers as %N.
+        void Dump(FILE* out) const;
+    private:
+        DISALLOW_COPY_AND_ASSIGN(FunctionBody);
+    };
+
+}
+}
+
+#endif // _BLVM_CORE_FUNCTION_BODY_HPP
@@ -1,9 +1,17 @@
 #include "global_variable.hpp"
+#include "type.hpp"
 
 namespace blvm {
 namespace core {
 
+    GlobalVariable::GlobalVariable(TypeRef value_type, Linkage linkage, bool is_constant, uint32_t alignment,
+                                   uint64_t initializer_id) :
+            value_type_(value_type), linkage_(linkage), is_constant_(is_constant), alignment_(alignment),
+            initializer_id_(initializer_id), storage_(nullptr) {}
 
+    GlobalVariable::~GlobalVariable() {
+
+    }
 
 }
 }
@@ -1,11 +1,78 @@
 #ifndef _BLVM_CORE_GLOBAL_VARIABLE_HPP
 #define _BLVM_CORE_GLOBAL_VARIABLE_HPP
 
+#include <cstdint>
+#include "../base/ref_base.hpp"
+#include "../base/string_piece.hpp"
+#include "core_fwd.hpp"
+#include "linkage.hpp"
+
 namespace blvm {
 namespace core {
 
-    class GlobalVariable {
+    class GlobalVariable : public base::RefBase {
+    public:
+        static const uint64_t kNoInitializer = UINT64_MAX;
+
+        // initializer_id is the module-level value id of the initializer, kNoInitializer for a declaration.
+        GlobalVariable(TypeRef value_type, Linkage linkage, bool is_constant, uint32_t alignment,
+                       uint64_t initializer_id);
+        virtual ~GlobalVariable() override;
+
+        // The type of the memory, the global itself is a pointer to it.
+        TypeRef GetValueType() const {
+            return value_type_;
+        }
+
+        // Same lifetime as Function::GetName().
+        base::StringPiece GetName() const {
+            return name_;
+        }
+
+        void SetName(base::StringPiece name) {
+            name_ = name;
+        }
+
+        Linkage GetLinkage() const {
+            return linkage_;
+        }
+
+        // Declared `constant` rather than `global`.
+        bool IsConstant() const {
+            return is_constant_;
+        }
+
+        // Declarations are defined in another module and have no initializer.
+        bool IsDeclaration() const {
+            return initializer_id_ == kNoInitializer;
+        }
+
+        uint64_t GetInitializerId() const {
+            return initializer_id_;
+        }
+
+        // In bytes, 0 if the module does not ask for one.
+        uint32_t GetAlignment() const {
+            return alignment_;
+        }
+
+        // The memory of the global, set up by Module::InitializeGlobals(). nullptr for declarations and for
+        // initializers the constant evaluation does not cover.
+        void* GetStorage() const {
+            return storage_;
+        }
 
+        void SetStorage(void* storage) {
+            storage_ = storage;
+        }
+    private:
+        TypeRef value_type_;
+        base::StringPiece name_;
+        Linkage linkage_;
+        bool is_constant_;
+        uint32_t alignment_;
+        uint64_t initializer_id_;
+        void* storage_;
     };
 
 }
@@ -0,0 +1,193 @@
+#include "instruction.hpp"
+#include "type.hpp"
+
+using namespace blvm::bitcode;
+
+namespace blvm {
+namespace core {
+
+    namespace {
+
+        // Offsets into BLVM_NATIVE_INTEGER_VARIANTS and BLVM_FLOATING_POINT_VARIANTS families.
+        const int kI32Variant = 2;
+        const int kI64Variant = 3;
+
+        int GetIntegerVariant(ValueType type) {
+            switch (type) {
+                case ValueType::kI8: return 0;
+                case ValueType::kI16: return 1;
+                case ValueType::kI32: return kI32Variant;
+                case ValueType::kI64: return kI64Variant;
+                case ValueType::kPointer: return kI64Variant;
+                default: return -1;
+            }
+        }
+
+        int GetFloatingPointVariant(ValueType type) {
+            switch (type) {
+                case ValueType::kFloat: return 0;
+                case ValueType::kDouble: return 1;
+                default: return -1;
+            }
+        }
+
+        // Loads and stores move bits: float is accessed as i32, double as i64.
+        int GetMemoryVariant(ValueType type) {
+            switch (type) {
+                case ValueType::kFloat: return kI32Variant;
+                case ValueType::kDouble: return kI64Variant;
+                default: return GetIntegerVariant(type);
+            }
+        }
+
+        Opcode SelectVariant(Opcode generic, Opcode first_variant, int variant) {
+            return variant < 0 ? generic : static_cast<Opcode>((int)first_variant + variant);
+        }
+
+    }
+
+    bool GetRegisterType(TypeRef type, RegisterType& out_type) {
+        switch (type->GetTypeCode()) {
+            case TypeCodes::kVoid:
+                out_type = {ValueType::kVoid, 0};
+                return true;
+            case TypeCodes::kFloat:
+                out_type = {ValueType::kFloat, 32};
+                return true;
+            case TypeCodes::kDouble:
+                out_type = {ValueType::kDouble, 64};
+                return true;
+            case TypeCodes::kPointer:
+                if (type->GetSizeInBits() != 64)
+                    return false;
+                out_type = {ValueType::kPointer, 64};
+                return true;
+            case TypeCodes::kInteger: {
+                uint32_t width = static_cast<const IntegerType*>(type)->GetBitWidth();
+                switch (width) {
+                    case 1: out_type = {ValueType::kI1, width}; return true;
+                    case 8: out_type = {ValueType::kI8, width}; return true;
+                    case 16: out_type = {ValueType::kI16, width}; return true;
+                    case 32: out_type = {ValueType::kI32, width}; return true;
+                    case 64: out_type = {ValueType::kI64, width}; return true;
+                }
+                if (width > 64)
+                    return false;
+                out_type = {ValueType::kIntN, width};
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    const char* GetValueTypeName(ValueType type) {
+        switch (type) {
+            case ValueType::kVoid: return "void";
+            case ValueType::kI1: return "i1";
+            case ValueType::kI8: return "i8";
+            case ValueType::kI16: return "i16";
+            case ValueType::kI32: return "i32";
+            case ValueType::kI64: return "i64";
+            case ValueType::kIntN: return "iN";
+            case ValueType::kFloat: return "float";
+            case ValueType::kDouble: return "double";
+            case ValueType::kPointer: return "ptr";
+            default: return "?";
+        }
+    }
+
+    const char* GetOpcodeName(Opcode opcode) {
+        static const char* const kNames[] = {
+        #define BLVM_OPCODE_NAME(name, text, generic) text,
+            BLVM_OPCODE_LIST(BLVM_OPCODE_NAME)
+        #undef BLVM_OPCODE_NAME
+        };
+        return opcode < Opcode::kCount ? kNames[(size_t)opcode] : "?";
+    }
+
+    Opcode GetGenericOpcode(Opcode opcode) {
+        static const Opcode kGenericOpcodes[] = {
+        #define BLVM_GENERIC_OPCODE(name, text, generic) Opcode::k##generic,
+            BLVM_OPCODE_LIST(BLVM_GENERIC_OPCODE)
+        #undef BLVM_GENERIC_OPCODE
+        };
+        return opcode < Opcode::kCount ? kGenericOpcodes[(size_t)opcode] : opcode;
+    }
+
+    Opcode SpecializeOpcode(const Instruction& instruction) {
+        Opcode opcode = instruction.opcode;
+        int integer = GetIntegerVariant(instruction.type);
+        int floating_point = GetFloatingPointVariant(instruction.type);
+        int source_integer = GetIntegerVariant((ValueType)instruction.aux);
+        int source_floating_point = GetFloatingPointVariant((ValueType)instruction.aux);
+        uint32_t predicate = instruction.aux;
+
+        switch (opcode) {
+            case Opcode::kAdd: return SelectVariant(opcode, Opcode::kAddI8, integer);
+            case Opcode::kSub: return SelectVariant(opcode, Opcode::kSubI8, integer);
+            case Opcode::kMul: return SelectVariant(opcode, Opcode::kMulI8, integer);
+            case Opcode::kUDiv: return SelectVariant(opcode, Opcode::kUDivI8, integer);
+            case Opcode::kSDiv: return SelectVariant(opcode, Opcode::kSDivI8, integer);
+            case Opcode::kURem: return SelectVariant(opcode, Opcode::kURemI8, integer);
+            case Opcode::kSRem: return SelectVariant(opcode, Opcode::kSRemI8, integer);
+            case Opcode::kShl: return SelectVariant(opcode, Opcode::kShlI8, integer);
+            case Opcode::kLShr: return SelectVariant(opcode, Opcode::kLShrI8, integer);
+            case Opcode::kAShr: return SelectVariant(opcode, Opcode::kAShrI8, integer);
+            case Opcode::kFAdd: return SelectVariant(opcode, Opcode::kFAddF32, floating_point);
+            case Opcode::kFSub: return SelectVariant(opcode, Opcode::kFSubF32, floating_point);
+            case Opcode::kFMul: return SelectVariant(opcode, Opcode::kFMulF32, floating_point);
+            case Opcode::kFDiv: return SelectVariant(opcode, Opcode::kFDivF32, floating_point);
+            case Opcode::kFRem: return SelectVariant(opcode, Opcode::kFRemF32, floating_point);
+            case Opcode::kFNeg: return SelectVariant(opcode, Opcode::kFNegF32, floating_point);
+            case Opcode::kTrunc:
+                return integer < kI64Variant ? SelectVariant(opcode, Opcode::kTruncI8, integer) : opcode;
+            case Opcode::kSExt: {
+                // the variants from i8 come first, then from i16, then from i32
+                static const int kFirstFromSource[] = {0, 3, 5};
+                if (source_integer < 0 || source_integer >= kI64Variant || integer <= source_integer)
+                    return opcode;
+                return SelectVariant(opcode, Opcode::kSExtI8I16,
+                                     kFirstFromSource[source_integer] + integer - source_integer - 1);
+            }
+            case Opcode::kFPToUI:
+            case Opcode::kFPToSI:
+                if (source_floating_point < 0 || integer < kI32Variant)
+                    return opcode;
+                return SelectVariant(opcode, opcode == Opcode::kFPToUI ? Opcode::kFPToUIF32I32 : Opcode::kFPToSIF32I32,
+                                     source_floating_point * 2 + integer - kI32Variant);
+            case Opcode::kUIToFP:
+            case Opcode::kSIToFP:
+                if (source_integer < kI32Variant || floating_point < 0)
+                    return opcode;
+                return SelectVariant(opcode, opcode == Opcode::kUIToFP ? Opcode::kUIToFPI32F32 : Opcode::kSIToFPI32F32,
+                                     (source_integer - kI32Variant) * 2 + floating_point);
+            case Opcode::kICmp:
+                if (predicate >= (uint32_t)CmpPredicates::kICmpEQ && predicate <= (uint32_t)CmpPredicates::kICmpULE)
+                    return SelectVariant(opcode, Opcode::kICmpEq, predicate - (uint32_t)CmpPredicates::kICmpEQ);
+                if (predicate < (uint32_t)CmpPredicates::kICmpSGT || predicate > (uint32_t)CmpPredicates::kICmpSLE ||
+                    integer < 0)
+                    return opcode;
+                return SelectVariant(opcode, Opcode::kICmpSgtI8,
+                                     (predicate - (uint32_t)CmpPredicates::kICmpSGT) * 4 + integer);
+            case Opcode::kFCmp:
+                if (predicate < (uint32_t)CmpPredicates::kFCmpOEQ || predicate > (uint32_t)CmpPredicates::kFCmpUNE ||
+                    floating_point < 0)
+                    return opcode;
+                return SelectVariant(opcode, Opcode::kFCmpOeqF32,
+                                     (predicate - (uint32_t)CmpPredicates::kFCmpOEQ) * 2 + floating_point);
+            case Opcode::kLoad:
+                return SelectVariant(opcode, Opcode::kLoadI8, GetMemoryVariant(instruction.type));
+            case Opcode::kStore:
+                return SelectVariant(opcode, Opcode::kStoreI8, GetMemoryVariant(instruction.type));
+            case Opcode::kPtrAddScaled:
+                if (integer < kI32Variant)
+                    return opcode;
+                return SelectVariant(opcode, Opcode::kPtrAddScaledI32, integer - kI32Variant);
+            default:
+                return opcode;
+        }
+    }
+
+}
+}
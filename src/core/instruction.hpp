@@ -0,0 +1,267 @@
+#ifndef _BLVM_CORE_INSTRUCTION_HPP
+#define _BLVM_CORE_INSTRUCTION_HPP
+
+#include <cstdint>
+#include "core_fwd.hpp"
+
+namespace blvm {
+namespace core {
+
+    // How a value sits in its 64-bit register. Integers are kept zero-extended to 64 bits, a float in the
+    // low 32 bits, pointers are host addresses.
+    enum class ValueType : uint8_t {
+        kVoid,
+        kI1,
+        kI8,
+        kI16,
+        kI32,
+        kI64,
+        kIntN,  // any other width up to 64, see RegisterType::width
+        kFloat,
+        kDouble,
+        kPointer
+    };
+
+    struct RegisterType {
+        ValueType type;
+        uint32_t width;  // in bits, 0 for void
+
+        bool operator==(const RegisterType& rhs) const {
+            return type == rhs.type && width == rhs.width;
+        }
+
+        bool operator!=(const RegisterType& rhs) const {
+            return !(*this == rhs);
+        }
+
+        bool IsInteger() const {
+            return type >= ValueType::kI1 && type <= ValueType::kIntN;
+        }
+
+        bool IsFloatingPoint() const {
+            return type == ValueType::kFloat || type == ValueType::kDouble;
+        }
+    };
+
+    // The register representation of a first-class type. Returns false for what has no single register:
+    // aggregates, vectors, integers wider than 64 bits, floating point formats other than float and double,
+    // pointers that are not 64 bits wide.
+    bool GetRegisterType(TypeRef type, RegisterType& out_type);
+
+    const char* GetValueTypeName(ValueType type);
+
+    // V(name, text, generic). The generic opcodes are what the lowering emits, SpecializeOpcode() then picks the
+    // variant for the operand types where there is one. The generic handlers check the type at run time and are
+    // left for the rest: integer widths other than 8, 16, 32 and 64 bits, mostly.
+    //
+    // Operands are register indexes unless noted. Instructions that produce a value write it to dest.
+    // Instruction::type is the type the operation works on: the result type, except where noted.
+    #define BLVM_GENERIC_OPCODE_LIST(V) \
+        /* integer arithmetic: dest = a op b */ \
+        V(Add, "add", Add) \
+        V(Sub, "sub", Sub) \
+        V(Mul, "mul", Mul) \
+        V(UDiv, "udiv", UDiv) \
+        V(SDiv, "sdiv", SDiv) \
+        V(URem, "urem", URem) \
+        V(SRem, "srem", SRem) \
+        V(Shl, "shl", Shl) \
+        V(LShr, "lshr", LShr) \
+        V(AShr, "ashr", AShr) \
+        V(And, "and", And) \
+        V(Or, "or", Or) \
+        V(Xor, "xor", Xor) \
+        /* floating point: dest = a op b, kFNeg: dest = -a */ \
+        V(FAdd, "fadd", FAdd) \
+        V(FSub, "fsub", FSub) \
+        V(FMul, "fmul", FMul) \
+        V(FDiv, "fdiv", FDiv) \
+        V(FRem, "frem", FRem) \
+        V(FNeg, "fneg", FNeg) \
+        /* conversions of a, whose ValueType is in aux and width in b */ \
+        V(Trunc, "trunc", Trunc) \
+        V(ZExt, "zext", ZExt) \
+        V(SExt, "sext", SExt) \
+        V(FPToUI, "fptoui", FPToUI) \
+        V(FPToSI, "fptosi", FPToSI) \
+        V(UIToFP, "uitofp", UIToFP) \
+        V(SIToFP, "sitofp", SIToFP) \
+        V(FPTrunc, "fptrunc", FPTrunc) \
+        V(FPExt, "fpext", FPExt) \
+        V(PtrToInt, "ptrtoint", PtrToInt) \
+        V(IntToPtr, "inttoptr", IntToPtr) \
+        /* dest = a pred b, an i1. The predicate is in aux (bitcode::CmpPredicates), type is the operand type. */ \
+        V(ICmp, "icmp", ICmp) \
+        V(FCmp, "fcmp", FCmp) \
+        V(Select, "select", Select)                    /* dest = a ? b : c */ \
+        V(Move, "move", Move)                          /* dest = a: bitcasts, freeze, phi copies */ \
+        /* dest = frame memory for a elements of b bytes, aligned to c */ \
+        V(Alloca, "alloca", Alloca) \
+        V(Load, "load", Load)                          /* dest = *a */ \
+        V(Store, "store", Store)                       /* *a = b, type is the stored type */ \
+        V(PtrAdd, "ptradd", PtrAdd)                    /* dest = a + (b | c << 32) */ \
+        V(PtrAddScaled, "ptradd.scaled", PtrAddScaled) /* dest = a + sext(b) * c, type is the type of b */ \
+        /* dest = a(args), a holds a Function*, args are FunctionBody::call_arguments[b, b + c) */ \
+        V(Call, "call", Call) \
+        V(Ret, "ret", Ret)                             /* returns a, kNoRegister for void */ \
+        /* targets are code indexes */ \
+        V(Br, "br", Br)                                /* to a */ \
+        V(CondBr, "condbr", CondBr)                    /* to b if a, else to c */ \
+        /* on a of type: FunctionBody::switch_cases[b] is the default, the c cases follow it */ \
+        V(Switch, "switch", Switch) \
+        V(Unreachable, "unreachable", Unreachable)
+
+    // The variants of a family, in this order. Integer variants are named after the width, pointers take the
+    // i64 variants, memory accesses by float and double the i32 and i64 ones.
+    #define BLVM_NATIVE_INTEGER_VARIANTS(V, name, text, generic) \
+        V(name##I8, text ".i8", generic) \
+        V(name##I16, text ".i16", generic) \
+        V(name##I32, text ".i32", generic) \
+        V(name##I64, text ".i64", generic)
+    #define BLVM_FLOATING_POINT_VARIANTS(V, name, text, generic) \
+        V(name##F32, text ".f32", generic) \
+        V(name##F64, text ".f64", generic)
+
+    // Each handler is a single native operation, the operands and semantics are those of the generic opcode.
+    #define BLVM_SPECIALIZED_OPCODE_LIST(V) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, Add, "add", Add) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, Sub, "sub", Sub) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, Mul, "mul", Mul) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, UDiv, "udiv", UDiv) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, SDiv, "sdiv", SDiv) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, URem, "urem", URem) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, SRem, "srem", SRem) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, Shl, "shl", Shl) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, LShr, "lshr", LShr) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, AShr, "ashr", AShr) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FAdd, "fadd", FAdd) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FSub, "fsub", FSub) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FMul, "fmul", FMul) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FDiv, "fdiv", FDiv) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FRem, "frem", FRem) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FNeg, "fneg", FNeg) \
+        /* conversions are named after the source type, then the result type */ \
+        V(TruncI8, "trunc.i8", Trunc) \
+        V(TruncI16, "trunc.i16", Trunc) \
+        V(TruncI32, "trunc.i32", Trunc) \
+        V(SExtI8I16, "sext.i8.i16", SExt) \
+        V(SExtI8I32, "sext.i8.i32", SExt) \
+        V(SExtI8I64, "sext.i8.i64", SExt) \
+        V(SExtI16I32, "sext.i16.i32", SExt) \
+        V(SExtI16I64, "sext.i16.i64", SExt) \
+        V(SExtI32I64, "sext.i32.i64", SExt) \
+        V(FPToUIF32I32, "fptoui.f32.i32", FPToUI) \
+        V(FPToUIF32I64, "fptoui.f32.i64", FPToUI) \
+        V(FPToUIF64I32, "fptoui.f64.i32", FPToUI) \
+        V(FPToUIF64I64, "fptoui.f64.i64", FPToUI) \
+        V(FPToSIF32I32, "fptosi.f32.i32", FPToSI) \
+        V(FPToSIF32I64, "fptosi.f32.i64", FPToSI) \
+        V(FPToSIF64I32, "fptosi.f64.i32", FPToSI) \
+        V(FPToSIF64I64, "fptosi.f64.i64", FPToSI) \
+        V(UIToFPI32F32, "uitofp.i32.f32", UIToFP) \
+        V(UIToFPI32F64, "uitofp.i32.f64", UIToFP) \
+        V(UIToFPI64F32, "uitofp.i64.f32", UIToFP) \
+        V(UIToFPI64F64, "uitofp.i64.f64", UIToFP) \
+        V(SIToFPI32F32, "sitofp.i32.f32", SIToFP) \
+        V(SIToFPI32F64, "sitofp.i32.f64", SIToFP) \
+        V(SIToFPI64F32, "sitofp.i64.f32", SIToFP) \
+        V(SIToFPI64F64, "sitofp.i64.f64", SIToFP) \
+        /* equality and the unsigned predicates do not depend on the width of zero-extended operands */ \
+        V(ICmpEq, "icmp.eq", ICmp) \
+        V(ICmpNe, "icmp.ne", ICmp) \
+        V(ICmpUgt, "icmp.ugt", ICmp) \
+        V(ICmpUge, "icmp.uge", ICmp) \
+        V(ICmpUlt, "icmp.ult", ICmp) \
+        V(ICmpUle, "icmp.ule", ICmp) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, ICmpSgt, "icmp.sgt", ICmp) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, ICmpSge, "icmp.sge", ICmp) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, ICmpSlt, "icmp.slt", ICmp) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, ICmpSle, "icmp.sle", ICmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpOeq, "fcmp.oeq", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpOgt, "fcmp.ogt", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpOge, "fcmp.oge", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpOlt, "fcmp.olt", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpOle, "fcmp.ole", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpOne, "fcmp.one", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpOrd, "fcmp.ord", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpUno, "fcmp.uno", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpUeq, "fcmp.ueq", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpUgt, "fcmp.ugt", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpUge, "fcmp.uge", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpUlt, "fcmp.ult", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpUle, "fcmp.ule", FCmp) \
+        BLVM_FLOATING_POINT_VARIANTS(V, FCmpUne, "fcmp.une", FCmp) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, Load, "load", Load) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, Store, "store", Store) \
+        /* by the type of the index */ \
+        V(PtrAddScaledI32, "ptradd.scaled.i32", PtrAddScaled) \
+        V(PtrAddScaledI64, "ptradd.scaled.i64", PtrAddScaled)
+
+    // Superinstructions, see FuseSuperinstructions(): the first instruction of a sequence does the work of the
+    // whole sequence, whose other instructions stay in place behind it. Its generic opcode is that of the first
+    // instruction. Chosen from the opcode pairs of loop-heavy code (bli --run --pairs).
+    #define BLVM_FUSED_OPCODE_LIST(V) \
+        /* icmp, then the condbr on its result */ \
+        V(ICmpEqCondBr, "icmp.eq+condbr", ICmp) \
+        V(ICmpNeCondBr, "icmp.ne+condbr", ICmp) \
+        V(ICmpUgtCondBr, "icmp.ugt+condbr", ICmp) \
+        V(ICmpUgeCondBr, "icmp.uge+condbr", ICmp) \
+        V(ICmpUltCondBr, "icmp.ult+condbr", ICmp) \
+        V(ICmpUleCondBr, "icmp.ule+condbr", ICmp) \
+        V(ICmpSgtI32CondBr, "icmp.sgt.i32+condbr", ICmp) \
+        V(ICmpSgtI64CondBr, "icmp.sgt.i64+condbr", ICmp) \
+        V(ICmpSgeI32CondBr, "icmp.sge.i32+condbr", ICmp) \
+        V(ICmpSgeI64CondBr, "icmp.sge.i64+condbr", ICmp) \
+        V(ICmpSltI32CondBr, "icmp.slt.i32+condbr", ICmp) \
+        V(ICmpSltI64CondBr, "icmp.slt.i64+condbr", ICmp) \
+        V(ICmpSleI32CondBr, "icmp.sle.i32+condbr", ICmp) \
+        V(ICmpSleI64CondBr, "icmp.sle.i64+condbr", ICmp) \
+        /* ptradd.scaled.i64, then a load or store through its result */ \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, PtrAddScaledI64Load, "ptradd.scaled.i64+load", PtrAddScaled) \
+        BLVM_NATIVE_INTEGER_VARIANTS(V, PtrAddScaledI64Store, "ptradd.scaled.i64+store", PtrAddScaled) \
+        /* load, an add to the loaded value, then a store of the sum to the same address */ \
+        V(LoadAddStoreI32, "load+add+store.i32", Load) \
+        V(LoadAddStoreI64, "load+add+store.i64", Load) \
+        /* phi copies: a copy and the br after it, or two copies */ \
+        V(MoveBr, "move+br", Move) \
+        V(MoveMove, "move+move", Move)
+
+    #define BLVM_OPCODE_LIST(V) \
+        BLVM_GENERIC_OPCODE_LIST(V) \
+        BLVM_SPECIALIZED_OPCODE_LIST(V) \
+        BLVM_FUSED_OPCODE_LIST(V)
+
+    enum class Opcode : uint16_t {
+    #define BLVM_DECLARE_OPCODE(name, text, generic) k##name,
+        BLVM_OPCODE_LIST(BLVM_DECLARE_OPCODE)
+    #undef BLVM_DECLARE_OPCODE
+        kCount
+    };
+
+    const char* GetOpcodeName(Opcode opcode);
+
+    // The generic opcode an opcode is a variant of, the opcode itself for generic opcodes.
+    Opcode GetGenericOpcode(Opcode opcode);
+
+    const uint32_t kNoRegister = UINT32_MAX;
+
+    // 32 bytes, a flat array of them is the body of a function.
+    struct Instruction {
+        const void* handler;  // baked in by the interpreter, see FunctionBody::handler_table
+        Opcode opcode;
+        ValueType type;
+        uint8_t aux;
+        uint32_t width;  // bit width of type
+        uint32_t dest;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+    };
+
+    // The variant of the generic opcode of instruction for its types (and predicate), or that generic opcode.
+    Opcode SpecializeOpcode(const Instruction& instruction);
+
+}
+}
+
+#endif // _BLVM_CORE_INSTRUCTION_HPP
@@ -0,0 +1,28 @@
+#ifndef _BLVM_CORE_MATERIALIZER_HPP
+#define _BLVM_CORE_MATERIALIZER_HPP
+
+#include <cstddef>
+#include "../base/ref_base.hpp"
+#include "core_fwd.hpp"
+
+namespace blvm {
+namespace core {
+
+    // Decodes function bodies on demand, installed into a Module by whoever loaded it.
+    class Materializer : public base::RefBase {
+    public:
+        Materializer() = default;
+        virtual ~Materializer() override = default;
+
+        // Returns false if the body could not be decoded, the function stays unmaterialized.
+        virtual bool Materialize(Function& function) = 0;
+
+        // Decodes every body that is not materialized yet, using up to thread_count threads (0: one per core).
+        // Returns false if any body failed, those functions stay unmaterialized and the rest are usable.
+        virtual bool MaterializeAll(size_t thread_count) = 0;
+    };
+
+}
+}
+
+#endif // _BLVM_CORE_MATERIALIZER_HPP
@@ -1,9 +1,27 @@
 #include "module.hpp"
+#include <algorithm>
+#include <cstring>
 #include "type.hpp"
+#include "function.hpp"
+#include "global_variable.hpp"
+#include "materializer.hpp"
 
 namespace blvm {
 namespace core {
 
+    namespace {
+
+        // constant_image_offsets_ entries that are not offsets
+        const uint64_t kImagePending = UINT64_MAX;
+        const uint64_t kImageInProgress = UINT64_MAX - 1;
+        const uint64_t kImageFailed = UINT64_MAX - 2;
+
+        // Larger globals and constants are left without memory rather than reserved up front.
+        const uint64_t kMaxImageSize = 1ull << 30;
+        const uint32_t kMaxGlobalAlignment = 1u << 16;
+
+    }
+
     Module::Module() : module_version(0) {
 
     }
@@ -11,5 +29,139 @@ namespace core {
     Module::~Module() {
 
     }
+
+    void Module::InitializeGlobals() {
+        // Evaluates constants on first use, so that operands come before the constants that refer to them.
+        class ImageBuilder : public ConstantResolver {
+        public:
+            explicit ImageBuilder(Module& module) : module_(module) {}
+
+            bool Evaluate(size_t index) {
+                uint64_t state = module_.constant_image_offsets_[index];
+                if (state == kImageInProgress || state == kImageFailed)
+                    return false;  // in progress: the constant contains itself
+                if (state != kImagePending)
+                    return true;
+
+                module_.constant_image_offsets_[index] = kImageInProgress;
+                const ConstantRecord& record = module_.constant_list[index];
+                const std::vector<uint64_t>& operands = module_.constant_operands;
+                bool succeeded = record.type->IsSized() && record.type->GetStoreSize() <= kMaxImageSize &&
+                                 record.operand_begin <= operands.size() &&
+                                 record.operand_count <= operands.size() - record.operand_begin;
+                std::vector<uint8_t> image;
+                if (succeeded) {
+                    image.resize((size_t)record.type->GetStoreSize(), 0);
+                    succeeded = WriteConstantImage(record, operands.data() + record.operand_begin, *this,
+                                                   image.data());
+                }
+                if (!succeeded) {
+                    module_.constant_image_offsets_[index] = kImageFailed;
+                    return false;
+                }
+                module_.constant_image_offsets_[index] = module_.constant_images_.size();
+                module_.constant_images_.insert(module_.constant_images_.end(), image.begin(), image.end());
+                return true;
+            }
+
+            virtual TypeRef GetTypeByIndex(uint64_t type_index) override {
+                return type_index < module_.type_table.size() ? module_.type_table[type_index] : nullptr;
+            }
+
+            virtual bool WriteValueImage(uint64_t value_id, TypeRef type, uint8_t* dest) override {
+                if (value_id < module_.value_table.size()) {
+                    const ModuleValue& value = module_.value_table[value_id];
+                    if (value.kind == ModuleValue::Kind::kConstant && !Evaluate(value.index))
+                        return false;
+                }
+                return module_.WriteValueImage(value_id, type, dest);
+            }
+        private:
+            Module& module_;
+        };
+
+        for (const GlobalVariableRef& global : global_list) {
+            TypeRef type = global->GetValueType();
+            uint32_t alignment = std::max(global->GetAlignment(), type->GetAlignment());
+            if (global->IsDeclaration() || !type->IsSized() || type->GetAllocSize() > kMaxImageSize ||
+                alignment > kMaxGlobalAlignment)
+                continue;
+            size_t size = std::max<size_t>((size_t)type->GetAllocSize(), 1);
+            void* storage = global_arena_.Allocate(size, alignment);
+            memset(storage, 0, size);
+            global->SetStorage(storage);
+        }
+
+        constant_images_.clear();
+        constant_image_offsets_.assign(constant_list.size(), kImagePending);
+        ImageBuilder builder(*this);
+        for (size_t i = 0; i < constant_list.size(); i++)
+            builder.Evaluate(i);
+
+        for (const GlobalVariableRef& global : global_list) {
+            if (global->GetStorage() == nullptr)
+                continue;
+            if (!WriteValueImage(global->GetInitializerId(), global->GetValueType(),
+                                 static_cast<uint8_t*>(global->GetStorage())))
+                global->SetStorage(nullptr);
+        }
+    }
+
+    bool Module::WriteValueImage(uint64_t value_id, TypeRef type, uint8_t* dest) const {
+        if (value_id >= value_table.size())
+            return false;
+
+        const ModuleValue& value = value_table[value_id];
+        const void* address = nullptr;
+        switch (value.kind) {
+            case ModuleValue::Kind::kConstant: {
+                const ConstantRecord& record = constant_list[value.index];
+                if (record.type != type || value.index >= constant_image_offsets_.size())
+                    return false;
+                uint64_t offset = constant_image_offsets_[value.index];
+                if (offset == kImagePending || offset == kImageInProgress || offset == kImageFailed)
+                    return false;
+                memcpy(dest, constant_images_.data() + offset, (size_t)type->GetStoreSize());
+                return true;
+            }
+            case ModuleValue::Kind::kFunction:
+                address = function_list[value.index].Get();
+                break;
+            case ModuleValue::Kind::kGlobalVariable:
+                address = global_list[value.index]->GetStorage();
+                if (address == nullptr)
+                    return false;
+                break;
+            default:
+                return false;
+        }
+        if (type->GetTypeCode() != bitcode::TypeCodes::kPointer || type->GetStoreSize() != sizeof(address))
+            return false;
+        memcpy(dest, &address, sizeof(address));
+        return true;
+    }
+
+    void Module::SetMaterializer(const MaterializerRef& materializer) {
+        materializer_ = materializer;
+    }
+
+    bool Module::MaterializeFunction(Function& function) {
+        if (function.IsMaterialized())
+            return true;
+        if (function.IsDeclaration() || !materializer_)
+            return false;
+        return materializer_->Materialize(function);
+    }
+
+    bool Module::MaterializeAll(size_t thread_count) {
+        if (!materializer_) {
+            for (auto& function : function_list) {
+                if (!function->IsDeclaration() && !function->IsMaterialized())
+                    return false;
+            }
+            return true;
+        }
+        return materializer_->MaterializeAll(thread_count);
+    }
 }
 }
@@ -3,13 +3,28 @@
 
 #include <string>
 #include <vector>
+#include "../base/arena.hpp"
 #include "../base/ref_ptr.hpp"
+#include "../base/string_interner.hpp"
+#include "constant.hpp"
+#include "core_fwd.hpp"
 
 namespace blvm {
 namespace core {
 
-    class Type;
-    typedef base::RefPtr<Type> TypeRef;
+    // What a module-level value id stands for. Ids are handed out in record order: globals, functions and
+    // aliases as the MODULE block declares them, then the constants of its CONSTANTS block.
+    struct ModuleValue {
+        enum class Kind : uint8_t {
+            kGlobalVariable,
+            kFunction,
+            kAlias,  // aliases and ifuncs, not resolved
+            kConstant
+        };
+
+        Kind kind;
+        uint32_t index;  // into global_list, function_list or constant_list
+    };
 
     class Module {
     public:
@@ -17,16 +32,43 @@ namespace core {
         std::string target_triple;
         std::string target_datalayout;
         std::vector<TypeRef> type_table;
-        std::vector<std::string> section_name_table;
-        std::vector<std::string> gc_name_table;
+        std::vector<base::InternedString> section_name_table;  // interned by the context
+        std::vector<base::InternedString> gc_name_table;
+        std::vector<FunctionRef> function_list;
+        std::vector<GlobalVariableRef> global_list;
+        std::vector<ModuleValue> value_table;
+        std::vector<ConstantRecord> constant_list;
+        std::vector<uint64_t> constant_operands;
     public:
         Module();
         ~Module();
         bool IsValidTypeIndex(uint32_t type_index) {
             return type_index < type_table.size();
         }
+
+        // Allocates the memory of the defined globals, evaluates the module-level constants and writes the
+        // initializers. Runs once, after the types are laid out.
+        void InitializeGlobals();
+
+        // The in-memory image of a module-level value (type->GetStoreSize() bytes): the address of a function
+        // or of a global's storage, the bytes of a constant. Returns false if the value has none or is not of
+        // the given type. Thread safe once InitializeGlobals() is done.
+        bool WriteValueImage(uint64_t value_id, TypeRef type, uint8_t* dest) const;
+
+        void SetMaterializer(const MaterializerRef& materializer);
+
+        // Decodes the body of a lazily loaded function, on the first call only.
+        // Returns whether the function has a usable body afterwards.
+        bool MaterializeFunction(Function& function);
+
+        // Decodes all remaining function bodies up front, in parallel when thread_count != 1.
+        bool MaterializeAll(size_t thread_count = 0);
     private:
+        MaterializerRef materializer_;
 
+        base::Arena global_arena_;                     // storage of the globals
+        std::vector<uint8_t> constant_images_;
+        std::vector<uint64_t> constant_image_offsets_;  // per constant, into constant_images_
     };
 
 }
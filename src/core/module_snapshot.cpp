@@ -0,0 +1,688 @@
+#include "module_snapshot.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../base/hash.hpp"
+#include "blvm_context.hpp"
+#include "function.hpp"
+#include "global_variable.hpp"
+#include "module.hpp"
+#include "type.hpp"
+
+using namespace blvm::bitcode;
+
+namespace blvm {
+namespace core {
+
+    namespace {
+
+        const char kSnapshotMagic[8] = {'B', 'L', 'V', 'M', 'S', 'N', 'A', 'P'};
+        const uint32_t kSnapshotVersion = 3;
+        const uint32_t kByteOrderMark = 0x01020304;  // snapshots are host byte order
+
+        struct SnapshotString {
+            uint32_t offset;  // into the string pool
+            uint32_t length;
+        };
+
+        // One record per type. Components are indexes into the type records:
+        // pointer: pointee, array/vector: element, function: return type then params, struct: members.
+        struct SnapshotType {
+            enum : uint32_t {
+                kPacked = 1,
+                kOpaque = 2,
+                kVarArg = 4
+            };
+
+            uint32_t type_code;
+            uint32_t flags;
+            uint64_t operand;  // integer width, element count or address space
+            uint32_t first_component;
+            uint32_t component_count;
+            SnapshotString name;  // named structs
+        };
+
+        // Bodies are not kept, a function is materialized again from the source on demand.
+        struct SnapshotFunction {
+            enum : uint32_t {
+                kDeclaration = 1
+            };
+
+            uint32_t function_type;
+            uint32_t linkage;
+            uint32_t flags;
+            uint32_t name_length;
+            uint64_t body_bit_offset;
+            uint64_t name_offset;  // into the source bitcode, the name stays a view into it
+        };
+
+        // The storage is set up again from the initializer on load.
+        struct SnapshotGlobal {
+            enum : uint32_t {
+                kConstant = 1
+            };
+
+            uint32_t value_type;
+            uint32_t linkage;
+            uint32_t flags;
+            uint32_t alignment;
+            uint64_t initializer_id;  // GlobalVariable::kNoInitializer for a declaration
+            uint64_t name_offset;     // as in SnapshotFunction
+            uint32_t name_length;
+            uint32_t reserved;
+        };
+
+        struct SnapshotValue {
+            uint32_t kind;   // ModuleValue::Kind
+            uint32_t index;
+        };
+
+        // Operands are indexes into the constant operand section.
+        struct SnapshotConstant {
+            uint32_t type;
+            uint32_t code;
+            uint32_t operand_begin;
+            uint32_t operand_count;
+        };
+
+        // Sections are 8-byte aligned, offsets are from the start of the file.
+        struct SnapshotHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order_mark;
+            uint64_t source_size;
+            uint64_t source_hash;
+
+            int32_t module_version;
+            SnapshotString target_triple;
+            SnapshotString target_datalayout;
+
+            uint32_t type_count;
+            uint32_t component_count;
+            uint32_t type_table_size;
+            uint32_t section_name_count;
+            uint32_t gc_name_count;
+            uint32_t function_count;
+            uint32_t global_count;
+            uint32_t value_count;
+            uint32_t constant_count;
+            uint32_t constant_operand_count;
+
+            uint64_t types_offset;       // SnapshotType[type_count]
+            uint64_t components_offset;  // uint32_t[component_count]
+            uint64_t type_table_offset;  // uint32_t[type_table_size]
+            uint64_t names_offset;       // SnapshotString[section_name_count + gc_name_count]
+            uint64_t functions_offset;   // SnapshotFunction[function_count]
+            uint64_t globals_offset;     // SnapshotGlobal[global_count]
+            uint64_t values_offset;      // SnapshotValue[value_count]
+            uint64_t constants_offset;   // SnapshotConstant[constant_count]
+            uint64_t constant_operands_offset;  // uint64_t[constant_operand_count]
+            uint64_t strings_offset;
+            uint64_t strings_size;
+        };
+
+        class SnapshotWriter {
+        public:
+            SnapshotWriter() {
+                data_.resize(sizeof(SnapshotHeader));
+            }
+
+            SnapshotString AddString(const char* str, size_t length) {
+                SnapshotString result = {(uint32_t)strings_.size(), (uint32_t)length};
+                strings_.append(str, length);
+                return result;
+            }
+
+            SnapshotString AddString(const std::string& str) {
+                return AddString(str.data(), str.size());
+            }
+
+            SnapshotString AddString(base::InternedString str) {
+                return AddString(str.c_str(), str.size());
+            }
+
+            // Post-order, so a type's components come before it, except that a named struct is numbered
+            // on first sight: the loader creates all named structs up front, which breaks the cycles.
+            uint32_t AddType(TypeRef type) {
+                auto iter = type_indexes_.find(type);
+                if (iter != type_indexes_.end())
+                    return iter->second;
+
+                TypeCodes type_code = type->GetTypeCode();
+                SnapshotType record = {(uint32_t)type_code, 0, 0, 0, 0, {0, 0}};
+                std::vector<uint32_t> components;
+
+                switch (type_code) {
+                    case TypeCodes::kInteger:
+                        record.operand = static_cast<const IntegerType*>(type)->GetBitWidth();
+                        break;
+                    case TypeCodes::kPointer: {
+                        auto pointer_type = static_cast<const PointerType*>(type);
+                        record.operand = pointer_type->GetAddressSpace();
+                        components.push_back(AddType(pointer_type->GetPointeeType()));
+                        break;
+                    }
+                    case TypeCodes::kArray: {
+                        auto array_type = static_cast<const ArrayType*>(type);
+                        record.operand = array_type->GetElementCount();
+                        components.push_back(AddType(array_type->GetElementType()));
+                        break;
+                    }
+                    case TypeCodes::kVector: {
+                        auto vector_type = static_cast<const VectorType*>(type);
+                        record.operand = vector_type->GetElementCount();
+                        components.push_back(AddType(vector_type->GetElementType()));
+                        break;
+                    }
+                    case TypeCodes::kFunction: {
+                        auto function_type = static_cast<const FunctionType*>(type);
+                        record.flags = function_type->IsVarArg() ? SnapshotType::kVarArg : 0;
+                        components.push_back(AddType(function_type->GetReturnType()));
+                        for (TypeRef param_type : function_type->GetParamTypes())
+                            components.push_back(AddType(param_type));
+                        break;
+                    }
+                    case TypeCodes::kStruct_NAMED: {
+                        auto struct_type = static_cast<const StructType*>(type);
+                        record.flags = (struct_type->IsPacked() ? SnapshotType::kPacked : 0) |
+                                       (struct_type->IsOpaque() ? SnapshotType::kOpaque : 0);
+                        record.name = AddString(struct_type->GetName());
+                        uint32_t index = PushType(type, record);
+                        for (TypeRef member_type : struct_type->GetMembers())
+                            components.push_back(AddType(member_type));
+                        SetComponents(index, components);
+                        return index;
+                    }
+                    case TypeCodes::kStruct_ANON: {
+                        auto struct_type = static_cast<const StructType*>(type);
+                        record.flags = struct_type->IsPacked() ? SnapshotType::kPacked : 0;
+                        for (TypeRef member_type : struct_type->GetMembers())
+                            components.push_back(AddType(member_type));
+                        break;
+                    }
+                    default:
+                        break;
+                }
+
+                // A component may have led back here through a named struct.
+                iter = type_indexes_.find(type);
+                if (iter != type_indexes_.end())
+                    return iter->second;
+
+                uint32_t index = PushType(type, record);
+                SetComponents(index, components);
+                return index;
+            }
+
+            void AddFunction(const Function& function, const base::MemoryBuffer& source_buffer) {
+                SnapshotFunction record;
+                record.function_type = AddType(function.GetFunctionType());
+                record.linkage = (uint32_t)function.GetLinkage();
+                record.flags = function.IsDeclaration() ? SnapshotFunction::kDeclaration : 0;
+                record.body_bit_offset = function.GetBodyBitOffset();
+                GetSourceName(function.GetName(), source_buffer, record.name_offset, record.name_length);
+                functions_.push_back(record);
+            }
+
+            void AddGlobal(const GlobalVariable& global, const base::MemoryBuffer& source_buffer) {
+                SnapshotGlobal record;
+                record.value_type = AddType(global.GetValueType());
+                record.linkage = (uint32_t)global.GetLinkage();
+                record.flags = global.IsConstant() ? SnapshotGlobal::kConstant : 0;
+                record.alignment = global.GetAlignment();
+                record.initializer_id = global.GetInitializerId();
+                GetSourceName(global.GetName(), source_buffer, record.name_offset, record.name_length);
+                record.reserved = 0;
+                globals_.push_back(record);
+            }
+
+            bool Write(const Module& module, const base::MemoryBuffer& source_buffer, const char* filename) {
+                SnapshotHeader header;
+                memset(&header, 0, sizeof(header));
+                memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+                header.version = kSnapshotVersion;
+                header.byte_order_mark = kByteOrderMark;
+                header.source_size = source_buffer.size();
+                header.source_hash = ModuleSnapshot::HashSource(source_buffer);
+                header.module_version = module.module_version;
+                header.target_triple = AddString(module.target_triple);
+                header.target_datalayout = AddString(module.target_datalayout);
+
+                std::vector<uint32_t> type_table;
+                type_table.reserve(module.type_table.size());
+                for (TypeRef type : module.type_table)
+                    type_table.push_back(AddType(type));
+
+                std::vector<SnapshotString> names;
+                for (base::InternedString name : module.section_name_table)
+                    names.push_back(AddString(name));
+                for (base::InternedString name : module.gc_name_table)
+                    names.push_back(AddString(name));
+
+                functions_.reserve(module.function_list.size());
+                for (const FunctionRef& function : module.function_list)
+                    AddFunction(*function, source_buffer);
+                globals_.reserve(module.global_list.size());
+                for (const GlobalVariableRef& global : module.global_list)
+                    AddGlobal(*global, source_buffer);
+
+                std::vector<SnapshotValue> values;
+                values.reserve(module.value_table.size());
+                for (const ModuleValue& value : module.value_table)
+                    values.push_back({(uint32_t)value.kind, value.index});
+                std::vector<SnapshotConstant> constants;
+                constants.reserve(module.constant_list.size());
+                for (const ConstantRecord& record : module.constant_list)
+                    constants.push_back({AddType(record.type), (uint32_t)record.code, record.operand_begin,
+                                         record.operand_count});
+
+                header.type_count = (uint32_t)types_.size();
+                header.component_count = (uint32_t)components_.size();
+                header.type_table_size = (uint32_t)type_table.size();
+                header.section_name_count = (uint32_t)module.section_name_table.size();
+                header.gc_name_count = (uint32_t)module.gc_name_table.size();
+                header.function_count = (uint32_t)functions_.size();
+                header.global_count = (uint32_t)globals_.size();
+                header.value_count = (uint32_t)values.size();
+                header.constant_count = (uint32_t)constants.size();
+                header.constant_operand_count = (uint32_t)module.constant_operands.size();
+
+                header.types_offset = AppendSection(types_.data(), types_.size() * sizeof(SnapshotType));
+                header.components_offset = AppendSection(components_.data(), components_.size() * sizeof(uint32_t));
+                header.type_table_offset = AppendSection(type_table.data(), type_table.size() * sizeof(uint32_t));
+                header.names_offset = AppendSection(names.data(), names.size() * sizeof(SnapshotString));
+                header.functions_offset = AppendSection(functions_.data(),
+                                                        functions_.size() * sizeof(SnapshotFunction));
+                header.globals_offset = AppendSection(globals_.data(), globals_.size() * sizeof(SnapshotGlobal));
+                header.values_offset = AppendSection(values.data(), values.size() * sizeof(SnapshotValue));
+                header.constants_offset = AppendSection(constants.data(), constants.size() * sizeof(SnapshotConstant));
+                header.constant_operands_offset = AppendSection(module.constant_operands.data(),
+                                                                module.constant_operands.size() * sizeof(uint64_t));
+                header.strings_offset = AppendSection(strings_.data(), strings_.size());
+                header.strings_size = strings_.size();
+                memcpy(data_.data(), &header, sizeof(header));
+
+                FILE* file = fopen(filename, "wb");
+                if (!file)
+                    return false;
+                bool succeeded = fwrite(data_.data(), 1, data_.size(), file) == data_.size();
+                succeeded = (fclose(file) == 0) && succeeded;
+                if (!succeeded)
+                    remove(filename);
+                return succeeded;
+            }
+        private:
+            // Names point into the STRTAB of the source, anything else is not kept.
+            static void GetSourceName(base::StringPiece name, const base::MemoryBuffer& source_buffer,
+                                      uint64_t& out_offset, uint32_t& out_length) {
+                const char* source_begin = reinterpret_cast<const char*>(source_buffer.begin());
+                if (!name.empty() && name.data() >= source_begin &&
+                    name.size() <= source_buffer.size() - (size_t)(name.data() - source_begin)) {
+                    out_length = (uint32_t)name.size();
+                    out_offset = (uint64_t)(name.data() - source_begin);
+                } else {
+                    out_length = 0;
+                    out_offset = 0;
+                }
+            }
+
+            uint32_t PushType(TypeRef type, const SnapshotType& record) {
+                uint32_t index = (uint32_t)types_.size();
+                types_.push_back(record);
+                type_indexes_.emplace(type, index);
+                return index;
+            }
+
+            void SetComponents(uint32_t index, const std::vector<uint32_t>& components) {
+                types_[index].first_component = (uint32_t)components_.size();
+                types_[index].component_count = (uint32_t)components.size();
+                components_.insert(components_.end(), components.begin(), components.end());
+            }
+
+            uint64_t AppendSection(const void* section, size_t size) {
+                data_.resize((data_.size() + 7) & ~size_t(7));
+                uint64_t offset = data_.size();
+                const uint8_t* bytes = static_cast<const uint8_t*>(section);
+                data_.insert(data_.end(), bytes, bytes + size);
+                return offset;
+            }
+        private:
+            std::vector<uint8_t> data_;
+            std::string strings_;
+            std::vector<SnapshotType> types_;
+            std::vector<uint32_t> components_;
+            std::vector<SnapshotFunction> functions_;
+            std::vector<SnapshotGlobal> globals_;
+            std::unordered_map<TypeRef, uint32_t> type_indexes_;
+        };
+
+
+        class SnapshotReader {
+        public:
+            SnapshotReader(BLVMContext& context, const base::MemoryBuffer& snapshot) :
+                    context_(context), data_(snapshot.begin()), size_(snapshot.size()) {}
+
+            // Fills a scratch module and hands its contents over only once everything checked out.
+            bool Read(Module& target_module, const base::MemoryBuffer& source_buffer) {
+                Module module;
+                if (size_ < sizeof(SnapshotHeader))
+                    return false;
+                memcpy(&header_, data_, sizeof(header_));
+                if (memcmp(header_.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+                    header_.version != kSnapshotVersion || header_.byte_order_mark != kByteOrderMark)
+                    return false;
+                // Size first, the hash reads the whole source.
+                if (header_.source_size != source_buffer.size() ||
+                    header_.source_hash != ModuleSnapshot::HashSource(source_buffer))
+                    return false;
+
+                if (!IsValidSection(header_.types_offset, header_.type_count, sizeof(SnapshotType)) ||
+                    !IsValidSection(header_.components_offset, header_.component_count, sizeof(uint32_t)) ||
+                    !IsValidSection(header_.type_table_offset, header_.type_table_size, sizeof(uint32_t)) ||
+                    !IsValidSection(header_.names_offset,
+                                    (uint64_t)header_.section_name_count + header_.gc_name_count,
+                                    sizeof(SnapshotString)) ||
+                    !IsValidSection(header_.functions_offset, header_.function_count, sizeof(SnapshotFunction)) ||
+                    !IsValidSection(header_.globals_offset, header_.global_count, sizeof(SnapshotGlobal)) ||
+                    !IsValidSection(header_.values_offset, header_.value_count, sizeof(SnapshotValue)) ||
+                    !IsValidSection(header_.constants_offset, header_.constant_count, sizeof(SnapshotConstant)) ||
+                    !IsValidSection(header_.constant_operands_offset, header_.constant_operand_count,
+                                    sizeof(uint64_t)) ||
+                    !IsValidSection(header_.strings_offset, header_.strings_size, 1))
+                    return false;
+
+                module.module_version = header_.module_version;
+                if (!GetString(header_.target_triple, module.target_triple) ||
+                    !GetString(header_.target_datalayout, module.target_datalayout))
+                    return false;
+
+                // Types are obtained among those of the module's layout, see BLVMContext::SetDataLayout().
+                if (!context_.SetDataLayout(module.target_datalayout) || !ReadTypes())
+                    return false;
+
+                module.type_table.resize(header_.type_table_size);
+                for (uint32_t i = 0; i < header_.type_table_size; i++) {
+                    uint32_t type_index = GetRecord<uint32_t>(header_.type_table_offset, i);
+                    if (type_index >= types_.size())
+                        return false;
+                    module.type_table[i] = types_[type_index];
+                }
+
+                uint32_t name_count = header_.section_name_count + header_.gc_name_count;
+                for (uint32_t i = 0; i < name_count; i++) {
+                    base::StringPiece name;
+                    if (!GetString(GetRecord<SnapshotString>(header_.names_offset, i), name))
+                        return false;
+                    if (i < header_.section_name_count)
+                        module.section_name_table.push_back(context_.Intern(name));
+                    else
+                        module.gc_name_table.push_back(context_.Intern(name));
+                }
+
+                module.function_list.reserve(header_.function_count);
+                for (uint32_t i = 0; i < header_.function_count; i++) {
+                    SnapshotFunction record = GetRecord<SnapshotFunction>(header_.functions_offset, i);
+                    if (record.function_type >= types_.size() ||
+                        types_[record.function_type]->GetTypeCode() != TypeCodes::kFunction)
+                        return false;
+
+                    FunctionRef function = new Function(types_[record.function_type], (Linkage)record.linkage,
+                                                        (record.flags & SnapshotFunction::kDeclaration) != 0);
+                    base::StringPiece name;
+                    if (!GetSourceName(record.name_offset, record.name_length, source_buffer, name))
+                        return false;
+                    function->SetName(name);
+                    function->SetBodyBitOffset(record.body_bit_offset);
+                    module.function_list.push_back(function);
+                }
+
+                module.global_list.reserve(header_.global_count);
+                for (uint32_t i = 0; i < header_.global_count; i++) {
+                    SnapshotGlobal record = GetRecord<SnapshotGlobal>(header_.globals_offset, i);
+                    if (record.value_type >= types_.size())
+                        return false;
+                    GlobalVariableRef global = new GlobalVariable(types_[record.value_type], (Linkage)record.linkage,
+                                                                  (record.flags & SnapshotGlobal::kConstant) != 0,
+                                                                  record.alignment, record.initializer_id);
+                    base::StringPiece name;
+                    if (!GetSourceName(record.name_offset, record.name_length, source_buffer, name))
+                        return false;
+                    global->SetName(name);
+                    module.global_list.push_back(global);
+                }
+
+                if (!ReadConstants(module))
+                    return false;
+
+                // Same as after a bitcode parse, see BitcodeParser::ComputeTypeLayouts().
+                for (TypeRef type : module.type_table) {
+                    if (!context_.ComputeTypeLayout(type))
+                        return false;
+                }
+
+                target_module.module_version = module.module_version;
+                target_module.target_triple.swap(module.target_triple);
+                target_module.target_datalayout.swap(module.target_datalayout);
+                target_module.type_table.swap(module.type_table);
+                target_module.section_name_table.swap(module.section_name_table);
+                target_module.gc_name_table.swap(module.gc_name_table);
+                target_module.function_list.swap(module.function_list);
+                target_module.global_list.swap(module.global_list);
+                target_module.value_table.swap(module.value_table);
+                target_module.constant_list.swap(module.constant_list);
+                target_module.constant_operands.swap(module.constant_operands);
+                target_module.InitializeGlobals();
+                return true;
+            }
+        private:
+            bool IsValidSection(uint64_t offset, uint64_t count, size_t record_size) const {
+                return offset % 8 == 0 && offset <= size_ && count <= (size_ - offset) / record_size;
+            }
+
+            template <typename T>
+            T GetRecord(uint64_t section_offset, size_t index) const {
+                T record;
+                memcpy(&record, data_ + section_offset + index * sizeof(T), sizeof(T));
+                return record;
+            }
+
+            // The value table and the constants it refers to, checked against the other sections.
+            bool ReadConstants(Module& module) {
+                module.constant_operands.resize(header_.constant_operand_count);
+                if (header_.constant_operand_count != 0)
+                    memcpy(module.constant_operands.data(), data_ + header_.constant_operands_offset,
+                           header_.constant_operand_count * sizeof(uint64_t));
+
+                module.constant_list.reserve(header_.constant_count);
+                for (uint32_t i = 0; i < header_.constant_count; i++) {
+                    SnapshotConstant record = GetRecord<SnapshotConstant>(header_.constants_offset, i);
+                    if (record.type >= types_.size() || record.operand_begin > header_.constant_operand_count ||
+                        record.operand_count > header_.constant_operand_count - record.operand_begin)
+                        return false;
+                    module.constant_list.push_back({types_[record.type], (ConstantsCodes)record.code,
+                                                    record.operand_begin, record.operand_count});
+                }
+
+                module.value_table.reserve(header_.value_count);
+                for (uint32_t i = 0; i < header_.value_count; i++) {
+                    SnapshotValue record = GetRecord<SnapshotValue>(header_.values_offset, i);
+                    bool is_valid;
+                    switch ((ModuleValue::Kind)record.kind) {
+                        case ModuleValue::Kind::kGlobalVariable:
+                            is_valid = record.index < module.global_list.size();
+                            break;
+                        case ModuleValue::Kind::kFunction:
+                            is_valid = record.index < module.function_list.size();
+                            break;
+                        case ModuleValue::Kind::kAlias:
+                            is_valid = true;
+                            break;
+                        case ModuleValue::Kind::kConstant:
+                            is_valid = record.index < module.constant_list.size();
+                            break;
+                        default:
+                            is_valid = false;
+                            break;
+                    }
+                    if (!is_valid)
+                        return false;
+                    module.value_table.push_back({(ModuleValue::Kind)record.kind, record.index});
+                }
+                return true;
+            }
+
+            // Empty for a zero length, otherwise the piece points into the source.
+            bool GetSourceName(uint64_t offset, uint32_t length, const base::MemoryBuffer& source_buffer,
+                               base::StringPiece& out_name) const {
+                if (length == 0) {
+                    out_name = base::StringPiece();
+                    return true;
+                }
+                if (offset > source_buffer.size() || length > source_buffer.size() - offset)
+                    return false;
+                out_name = base::StringPiece(reinterpret_cast<const char*>(source_buffer.begin() + offset), length);
+                return true;
+            }
+
+            // The piece points into the mapped snapshot.
+            bool GetString(const SnapshotString& str, base::StringPiece& out_string) const {
+                if (str.offset > header_.strings_size || str.length > header_.strings_size - str.offset)
+                    return false;
+                const uint8_t* begin = data_ + header_.strings_offset + str.offset;
+                out_string = base::StringPiece(reinterpret_cast<const char*>(begin), str.length);
+                return true;
+            }
+
+            bool GetString(const SnapshotString& str, std::string& out_string) const {
+                base::StringPiece piece;
+                if (!GetString(str, piece))
+                    return false;
+                out_string.assign(piece.data(), piece.size());
+                return true;
+            }
+
+            // Named structs first, then everything else in record order (components precede their users),
+            // then the struct bodies.
+            bool ReadTypes() {
+                types_.assign(header_.type_count, nullptr);
+                base::StringPiece name;
+
+                for (uint32_t i = 0; i < header_.type_count; i++) {
+                    SnapshotType record = GetRecord<SnapshotType>(header_.types_offset, i);
+                    if (record.first_component > header_.component_count ||
+                        record.component_count > header_.component_count - record.first_component)
+                        return false;
+                    if ((TypeCodes)record.type_code != TypeCodes::kStruct_NAMED)
+                        continue;
+                    if (!GetString(record.name, name))
+                        return false;
+                    bool is_packed = (record.flags & SnapshotType::kPacked) != 0;
+                    types_[i] = StructType::CreateNamedStructType(context_, is_packed, name);
+                }
+
+                std::vector<TypeRef> components;
+                for (uint32_t i = 0; i < header_.type_count; i++) {
+                    SnapshotType record = GetRecord<SnapshotType>(header_.types_offset, i);
+                    TypeCodes type_code = (TypeCodes)record.type_code;
+                    if (type_code == TypeCodes::kStruct_NAMED)
+                        continue;
+                    if (!GetComponents(record, components))
+                        return false;
+
+                    TypeRef type = nullptr;
+                    switch (type_code) {
+                        case TypeCodes::kInteger:
+                            if (record.operand == 0 || record.operand > (1u << 23))
+                                return false;
+                            type = IntegerType::ObtainIntegerType(context_, (uint32_t)record.operand);
+                            break;
+                        case TypeCodes::kPointer:
+                            if (components.size() != 1 || record.operand > UINT32_MAX)
+                                return false;
+                            type = PointerType::ObtainPointerType(context_, components[0], (uint32_t)record.operand);
+                            break;
+                        case TypeCodes::kArray:
+                            if (components.size() != 1)
+                                return false;
+                            type = ArrayType::ObtainArrayType(context_, record.operand, components[0]);
+                            break;
+                        case TypeCodes::kVector:
+                            if (components.size() != 1 || record.operand > UINT32_MAX)
+                                return false;
+                            type = VectorType::ObtainVectorType(context_, (uint32_t)record.operand, components[0]);
+                            break;
+                        case TypeCodes::kFunction: {
+                            if (components.empty())
+                                return false;
+                            std::vector<TypeRef> param_types(components.begin() + 1, components.end());
+                            bool is_vararg = (record.flags & SnapshotType::kVarArg) != 0;
+                            type = FunctionType::ObtainFunctionType(context_, is_vararg, components[0], param_types);
+                            break;
+                        }
+                        case TypeCodes::kStruct_ANON:
+                            type = StructType::ObtainLiteralStructType(context_,
+                                                                       (record.flags & SnapshotType::kPacked) != 0,
+                                                                       components);
+                            break;
+                        default:
+                            type = Type::ObtainSimpleType(context_, type_code);
+                            break;
+                    }
+                    if (type == nullptr)
+                        return false;
+                    types_[i] = type;
+                }
+
+                for (uint32_t i = 0; i < header_.type_count; i++) {
+                    SnapshotType record = GetRecord<SnapshotType>(header_.types_offset, i);
+                    if ((TypeCodes)record.type_code != TypeCodes::kStruct_NAMED ||
+                        (record.flags & SnapshotType::kOpaque))
+                        continue;
+                    if (!GetComponents(record, components))
+                        return false;
+                    bool is_packed = (record.flags & SnapshotType::kPacked) != 0;
+                    static_cast<StructType*>(types_[i])->SetBody(context_, is_packed, components);
+                }
+                return true;
+            }
+
+            // Components must already exist: named structs, or records created before this one.
+            bool GetComponents(const SnapshotType& record, std::vector<TypeRef>& out_components) {
+                out_components.clear();
+                for (uint32_t i = 0; i < record.component_count; i++) {
+                    uint32_t index = GetRecord<uint32_t>(header_.components_offset, record.first_component + i);
+                    if (index >= header_.type_count || types_[index] == nullptr)
+                        return false;
+                    out_components.push_back(types_[index]);
+                }
+                return true;
+            }
+        private:
+            BLVMContext& context_;
+            const uint8_t* data_;
+            size_t size_;
+            SnapshotHeader header_;
+            std::vector<TypeRef> types_;
+        };
+
+    }
+
+    uint64_t ModuleSnapshot::HashSource(const base::MemoryBuffer& source_buffer) {
+        return base::HashBytes(source_buffer.begin(), source_buffer.size());
+    }
+
+    bool ModuleSnapshot::Save(const Module& module, const base::MemoryBuffer& source_buffer, const char* filename) {
+        SnapshotWriter writer;
+        return writer.Write(module, source_buffer, filename);
+    }
+
+    bool ModuleSnapshot::Load(BLVMContext& context, Module& module, const base::MemoryBuffer& snapshot,
+                              const base::MemoryBuffer& source_buffer) {
+        SnapshotReader reader(context, snapshot);
+        return reader.Read(module, source_buffer);
+    }
+
+}
+}
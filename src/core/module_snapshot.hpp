@@ -0,0 +1,38 @@
+#ifndef _BLVM_CORE_MODULE_SNAPSHOT_HPP
+#define _BLVM_CORE_MODULE_SNAPSHOT_HPP
+
+#include <cstdint>
+#include "../base/memory_buffer.hpp"
+#include "core_fwd.hpp"
+
+namespace blvm {
+namespace core {
+
+    // A decoded Module in a flat, position-independent file: fixed-size records that refer to each other
+    // by index and to a shared string pool by (offset, length), so loading is a pass over the mapped file
+    // without any bitstream decoding. The snapshot is keyed by the size and content hash of the bitcode it
+    // was built from and uses host byte order; a snapshot that does not match is rejected and should be
+    // rebuilt, see bitcode::LoadModuleWithSnapshot().
+    //
+    // Function bodies are not kept: a function is materialized again from its body offset on demand, and
+    // global storage is set up again from the kept constants. Function and global names are kept as offsets
+    // into the source and point into source_buffer after a load, like after a bitcode parse, so the source has
+    // to stay mapped as long as the module is used.
+    class ModuleSnapshot {
+    public:
+        static uint64_t HashSource(const base::MemoryBuffer& source_buffer);
+
+        static bool Save(const Module& module, const base::MemoryBuffer& source_buffer, const char* filename);
+
+        // Fills an empty module, creating its types in context. Returns false and leaves module untouched if
+        // snapshot is malformed or was not built from source_buffer.
+        static bool Load(BLVMContext& context, Module& module, const base::MemoryBuffer& snapshot,
+                         const base::MemoryBuffer& source_buffer);
+    private:
+        ModuleSnapshot() = delete;
+    };
+
+}
+}
+
+#endif // _BLVM_CORE_MODULE_SNAPSHOT_HPP
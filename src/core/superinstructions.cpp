@@ -0,0 +1,106 @@
+#include "superinstructions.hpp"
+#include "function_body.hpp"
+
+namespace blvm {
+namespace core {
+
+    namespace {
+
+        // Offset of a BLVM_NATIVE_INTEGER_VARIANTS member from the first member of its family.
+        int GetVariant(Opcode opcode, Opcode first_variant) {
+            return (int)opcode - (int)first_variant;
+        }
+
+        bool IsInFamily(Opcode opcode, Opcode first_variant, int variant_count) {
+            return opcode >= first_variant && GetVariant(opcode, first_variant) < variant_count;
+        }
+
+        Opcode GetOpcode(Opcode first, int offset) {
+            return static_cast<Opcode>((int)first + offset);
+        }
+
+        // The superinstruction for an icmp and the condbr on its result, kCount if there is none.
+        Opcode FuseCompareBranch(Opcode compare) {
+            if (IsInFamily(compare, Opcode::kICmpEq, 6))
+                return GetOpcode(Opcode::kICmpEqCondBr, GetVariant(compare, Opcode::kICmpEq));
+            if (!IsInFamily(compare, Opcode::kICmpSgtI8, 16))
+                return Opcode::kCount;
+            // signed predicates come in four widths, the superinstructions in i32 and i64 only
+            int predicate = GetVariant(compare, Opcode::kICmpSgtI8) / 4;
+            int width = GetVariant(compare, Opcode::kICmpSgtI8) % 4;
+            if (width < 2)
+                return Opcode::kCount;
+            return GetOpcode(Opcode::kICmpSgtI32CondBr, predicate * 2 + width - 2);
+        }
+
+        // A load, an add of the loaded value and a store of the sum through the same address register.
+        bool IsLoadAddStore(const std::vector<Instruction>& code, size_t index) {
+            if (code.size() - index < 3)
+                return false;
+            const Instruction& load = code[index];
+            const Instruction& add = code[index + 1];
+            const Instruction& store = code[index + 2];
+            bool is_i32 = load.opcode == Opcode::kLoadI32;
+            if (!is_i32 && load.opcode != Opcode::kLoadI64)
+                return false;
+            return add.opcode == (is_i32 ? Opcode::kAddI32 : Opcode::kAddI64) &&
+                   (add.a == load.dest || add.b == load.dest) && load.dest != load.a && add.dest != load.a &&
+                   store.opcode == (is_i32 ? Opcode::kStoreI32 : Opcode::kStoreI64) && store.a == load.a &&
+                   store.b == add.dest;
+        }
+
+        // Returns how many instructions the sequence at code[index] covers, 1 if nothing was fused.
+        size_t Fuse(std::vector<Instruction>& code, size_t index) {
+            Instruction& first = code[index];
+            size_t remaining = code.size() - index;
+            if (remaining < 2)
+                return 1;
+            const Instruction& second = code[index + 1];
+
+            Opcode fused = FuseCompareBranch(first.opcode);
+            if (fused != Opcode::kCount && second.opcode == Opcode::kCondBr && second.a == first.dest) {
+                first.opcode = fused;
+                return 2;
+            }
+
+            if (first.opcode == Opcode::kPtrAddScaledI64 && second.a == first.dest) {
+                // a load that starts a load+add+store saves more there
+                if (IsInFamily(second.opcode, Opcode::kLoadI8, 4) && !IsLoadAddStore(code, index + 1)) {
+                    int width = GetVariant(second.opcode, Opcode::kLoadI8);
+                    first.opcode = GetOpcode(Opcode::kPtrAddScaledI64LoadI8, width);
+                    return 2;
+                }
+                if (IsInFamily(second.opcode, Opcode::kStoreI8, 4)) {
+                    int width = GetVariant(second.opcode, Opcode::kStoreI8);
+                    first.opcode = GetOpcode(Opcode::kPtrAddScaledI64StoreI8, width);
+                    return 2;
+                }
+            }
+
+            if (IsLoadAddStore(code, index)) {
+                first.opcode = first.opcode == Opcode::kLoadI32 ? Opcode::kLoadAddStoreI32 : Opcode::kLoadAddStoreI64;
+                return 3;
+            }
+
+            if (first.opcode == Opcode::kMove) {
+                if (second.opcode == Opcode::kBr) {
+                    first.opcode = Opcode::kMoveBr;
+                    return 2;
+                }
+                if (second.opcode == Opcode::kMove) {
+                    first.opcode = Opcode::kMoveMove;
+                    return 2;
+                }
+            }
+            return 1;
+        }
+
+    }
+
+    void FuseSuperinstructions(FunctionBody& body) {
+        for (size_t index = 0; index < body.code.size();)
+            index += Fuse(body.code, index);
+    }
+
+}
+}
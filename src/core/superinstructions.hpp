@@ -0,0 +1,18 @@
+#ifndef _BLVM_CORE_SUPERINSTRUCTIONS_HPP
+#define _BLVM_CORE_SUPERINSTRUCTIONS_HPP
+
+#include "core_fwd.hpp"
+
+namespace blvm {
+namespace core {
+
+    // Peephole over specialized code (see SpecializeOpcode()): the first instruction of each sequence in
+    // BLVM_FUSED_OPCODE_LIST becomes a superinstruction that reads the operands of the others and continues
+    // past them, one dispatch instead of several. The others stay where they are, so no code index moves and
+    // a branch into the sequence still finds them. Sequences do not overlap, the first match from the front wins.
+    void FuseSuperinstructions(FunctionBody& body);
+
+}
+}
+
+#endif // _BLVM_CORE_SUPERINSTRUCTIONS_HPP
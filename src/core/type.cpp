@@ -9,25 +9,25 @@ namespace core {
     TypeRef Type::ObtainSimpleType(BLVMContext& context, bitcode::TypeCodes type_code) {
         switch (type_code) {
             case TypeCodes::kVoid:
-                return context.type_void_;
+                return context.layout_types_->type_void;
             case TypeCodes::kHalf:
-                return context.type_half_;
+                return context.layout_types_->type_half;
             case TypeCodes::kFloat:
-                return context.type_float_;
+                return context.layout_types_->type_float;
             case TypeCodes::kDouble:
-                return context.type_double_;
+                return context.layout_types_->type_double;
             case TypeCodes::kX86_FP80:
-                return context.type_x86_fp80_;
+                return context.layout_types_->type_x86_fp80;
             case TypeCodes::kX86_MMX:
-                return context.type_x86_mmx;
+                return context.layout_types_->type_x86_mmx;
             case TypeCodes::kFP128:
-                return context.type_fp128_;
+                return context.layout_types_->type_fp128;
             case TypeCodes::kPPC_FP128:
-                return context.type_ppc_fp128_;
+                return context.layout_types_->type_ppc_fp128;
             case TypeCodes::kLabel:
-                return context.type_label_;
+                return context.layout_types_->type_label;
             case TypeCodes::kMetadata:
-                return context.type_metadata_;
+                return context.layout_types_->type_metadata;
             default:
                 return nullptr;
         }
@@ -43,17 +43,20 @@ namespace core {
     TypeRef IntegerType::ObtainIntegerType(BLVMContext& context, uint32_t bit_width) {
         switch (bit_width) {
             case 1:
-                return context.type_int1_;
+                return context.layout_types_->type_int1;
             case 8:
-                return context.type_int8_;
+                return context.layout_types_->type_int8;
             case 16:
-                return context.type_int16_;
+                return context.layout_types_->type_int16;
             case 32:
-                return context.type_int32_;
+                return context.layout_types_->type_int32;
             case 64:
-                return context.type_int64_;
+                return context.layout_types_->type_int64;
         }
-        return nullptr;
+        BLVMContext::TypeKey key = {TypeCodes::kInteger, bit_width, 0, nullptr, 0};
+        return context.ObtainUniquedType(key, [&](const TypeRef*) -> TypeRef {
+            return context.type_arena_.New<IntegerType>(bit_width);
+        });
     }
 
     bool PointerType::IsValidTargetType(bitcode::TypeCodes type_code) {
@@ -62,6 +65,14 @@ namespace core {
                type_code != TypeCodes::kMetadata;
     }
 
+    TypeRef PointerType::ObtainPointerType(BLVMContext& context, TypeRef pointee_type, uint32_t address_space) {
+        BLVMContext::TypeKey key = {TypeCodes::kPointer, address_space, reinterpret_cast<uintptr_t>(pointee_type),
+                                    nullptr, 0};
+        return context.ObtainUniquedType(key, [&](const TypeRef*) -> TypeRef {
+            return context.type_arena_.New<PointerType>(pointee_type, address_space);
+        });
+    }
+
     bool ArrayType::IsValidElementType(bitcode::TypeCodes type_code) {
         return type_code != TypeCodes::kVoid &&
                type_code != TypeCodes::kLabel &&
@@ -70,6 +81,14 @@ namespace core {
                type_code != TypeCodes::kFunction_Old;
     }
 
+    TypeRef ArrayType::ObtainArrayType(BLVMContext& context, uint64_t element_count, TypeRef element_type) {
+        BLVMContext::TypeKey key = {TypeCodes::kArray, element_count, reinterpret_cast<uintptr_t>(element_type),
+                                    nullptr, 0};
+        return context.ObtainUniquedType(key, [&](const TypeRef*) -> TypeRef {
+            return context.type_arena_.New<ArrayType>(element_count, element_type);
+        });
+    }
+
     bool VectorType::IsValidElementType(bitcode::TypeCodes type_code) {
         return type_code == TypeCodes::kInteger ||
                type_code == TypeCodes::kHalf ||
@@ -78,15 +97,55 @@ namespace core {
                type_code == TypeCodes::kPointer;
     }
 
+    TypeRef VectorType::ObtainVectorType(BLVMContext& context, uint32_t element_count, TypeRef element_type) {
+        BLVMContext::TypeKey key = {TypeCodes::kVector, element_count, reinterpret_cast<uintptr_t>(element_type),
+                                    nullptr, 0};
+        return context.ObtainUniquedType(key, [&](const TypeRef*) -> TypeRef {
+            return context.type_arena_.New<VectorType>(element_count, element_type);
+        });
+    }
+
     bool StructType::IsValidMemberType(bitcode::TypeCodes type_code) {
         return ArrayType::IsValidElementType(type_code);
     }
 
+    TypeRef StructType::ObtainLiteralStructType(BLVMContext& context, bool is_packed,
+                                                const std::vector<TypeRef>& members) {
+        BLVMContext::TypeKey key = {TypeCodes::kStruct_ANON, is_packed, 0, members.data(), members.size()};
+        return context.ObtainUniquedType(key, [&](const TypeRef* stored_members) -> TypeRef {
+            return context.type_arena_.New<StructType>(is_packed, TypeList(stored_members, members.size()));
+        });
+    }
+
+    StructType* StructType::CreateNamedStructType(BLVMContext& context, bool is_packed, base::StringPiece name) {
+        return context.type_arena_.New<StructType>(is_packed, context.Intern(name));
+    }
+
+    void StructType::SetName(BLVMContext& context, base::StringPiece name) {
+        struct_name_ = context.Intern(name);
+    }
+
+    void StructType::SetBody(BLVMContext& context, bool is_packed, const std::vector<TypeRef>& members) {
+        is_packed_ = is_packed;
+        is_opaque_ = false;
+        members_ = TypeList(context.CopyTypeList(members.data(), members.size()), members.size());
+    }
+
     bool FunctionType::IsValidArgumentType(TypeCodes type_code) {
         return type_code != TypeCodes::kVoid &&
                type_code != TypeCodes::kFunction &&
                type_code != TypeCodes::kFunction_Old;
     }
 
+    TypeRef FunctionType::ObtainFunctionType(BLVMContext& context, bool is_vararg, TypeRef return_type,
+                                             const std::vector<TypeRef>& param_types) {
+        BLVMContext::TypeKey key = {TypeCodes::kFunction, is_vararg, reinterpret_cast<uintptr_t>(return_type),
+                                    param_types.data(), param_types.size()};
+        return context.ObtainUniquedType(key, [&](const TypeRef* stored_params) -> TypeRef {
+            return context.type_arena_.New<FunctionType>(is_vararg, return_type,
+                                                         TypeList(stored_params, param_types.size()));
+        });
+    }
+
 }
 }
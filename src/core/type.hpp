@@ -1,29 +1,103 @@
 #ifndef _BLVM_CORE_TYPE_HPP
 #define _BLVM_CORE_TYPE_HPP
 
-#include "../base/ref_base.hpp"
-#include "../base/ref_ptr.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../base/string_interner.hpp"
 #include "../bitcode/bitcode_llvm.hpp"
 #include "core_fwd.hpp"
 
 namespace blvm {
 namespace core {
 
-    class Type;
-    typedef base::RefPtr<Type> TypeRef;
-
-    class Type : public base::RefBase {
+    // Types live in the arena of the BLVMContext that created them and are never freed individually,
+    // so they carry no refcount and no vtable, and a TypeRef is a plain pointer. Subclasses are told
+    // apart by GetTypeCode().
+    class Type {
     public:
-        Type(bitcode::TypeCodes type_code) : type_code_(type_code) {}
-        virtual ~Type() = default;
+        explicit Type(bitcode::TypeCodes type_code) :
+                type_code_(type_code), layout_state_(kLayoutNone), alignment_(0), size_in_bits_(0), alloc_size_(0) {}
 
         bitcode::TypeCodes GetTypeCode() const {
             return type_code_;
         }
+
+        // Size and ABI alignment under the context's DataLayout, filled in by BLVMContext::ComputeTypeLayout()
+        // once the module that uses the type is loaded. Unsized types (void, label, metadata, functions,
+        // opaque structs) have alignment 0.
+        bool HasLayout() const {
+            return layout_state_ == kLayoutDone;
+        }
+
+        bool IsSized() const {
+            return alignment_ != 0;
+        }
+
+        uint64_t GetSizeInBits() const {
+            return size_in_bits_;
+        }
+
+        uint64_t GetStoreSize() const {
+            return (size_in_bits_ + 7) / 8;
+        }
+
+        // Store size padded to the alignment, the distance between array elements.
+        uint64_t GetAllocSize() const {
+            return alloc_size_;
+        }
+
+        uint32_t GetAlignment() const {
+            return alignment_;
+        }
     public:
         static TypeRef ObtainSimpleType(BLVMContext& context, bitcode::TypeCodes type_code);
     private:
+        enum : uint8_t {
+            kLayoutNone,
+            kLayoutPending,  // on the ComputeTypeLayout() path, seeing it again means the type contains itself
+            kLayoutDone
+        };
+
         bitcode::TypeCodes type_code_;
+        uint8_t layout_state_;
+        uint32_t alignment_;
+        uint64_t size_in_bits_;
+        uint64_t alloc_size_;
+
+        friend class BLVMContext;
+    };
+
+
+    // Read-only view of a component type list stored in the context arena.
+    class TypeList {
+    public:
+        TypeList() : data_(nullptr), size_(0) {}
+        TypeList(const TypeRef* data, size_t size) : data_(data), size_(static_cast<uint32_t>(size)) {}
+
+        const TypeRef* begin() const {
+            return data_;
+        }
+
+        const TypeRef* end() const {
+            return data_ + size_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        TypeRef operator[](size_t index) const {
+            return data_[index];
+        }
+    private:
+        const TypeRef* data_;
+        uint32_t size_;
     };
 
 
@@ -31,13 +105,13 @@ namespace core {
     public:
         explicit IntegerType(uint32_t bit_width) :
                 Type(bitcode::TypeCodes::kInteger), bit_width_(bit_width) {}
-        virtual ~IntegerType() override = default;
 
         uint32_t GetBitWidth() const {
             return bit_width_;
         }
     public:
         static bool IsCommonBitwidth(uint32_t bit_width);
+        // Common widths come from the context's fixed slots, any other width is uniqued in its type table.
         static TypeRef ObtainIntegerType(BLVMContext& context, uint32_t bit_width);
     private:
         uint32_t bit_width_;
@@ -46,83 +120,152 @@ namespace core {
 
     class PointerType : public Type {
     public:
-        PointerType(uint32_t pointee_type_index, uint32_t address_space = 0) :
+        PointerType(TypeRef pointee_type, uint32_t address_space = 0) :
                 Type(bitcode::TypeCodes::kPointer),
-                pointee_type_index_(pointee_type_index), address_space_(address_space) {}
-        virtual ~PointerType() override = default;
+                pointee_type_(pointee_type), address_space_(address_space) {}
+
+        TypeRef GetPointeeType() const {
+            return pointee_type_;
+        }
+
+        uint32_t GetAddressSpace() const {
+            return address_space_;
+        }
     public:
         static bool IsValidTargetType(bitcode::TypeCodes type_code);
+        static TypeRef ObtainPointerType(BLVMContext& context, TypeRef pointee_type, uint32_t address_space);
     private:
-        uint32_t pointee_type_index_;
+        TypeRef pointee_type_;
         uint32_t address_space_;
     };
 
 
     class ArrayType : public Type {
     public:
-        ArrayType(uint32_t element_count, uint32_t element_type_index) :
+        ArrayType(uint64_t element_count, TypeRef element_type) :
                 Type(bitcode::TypeCodes::kArray),
-                element_count_(element_count), element_type_index_(element_type_index) {}
-        virtual ~ArrayType() override = default;
+                element_count_(element_count), element_type_(element_type) {}
+
+        uint64_t GetElementCount() const {
+            return element_count_;
+        }
+
+        TypeRef GetElementType() const {
+            return element_type_;
+        }
     public:
         static bool IsValidElementType(bitcode::TypeCodes type_code);
+        static TypeRef ObtainArrayType(BLVMContext& context, uint64_t element_count, TypeRef element_type);
     private:
-        uint32_t element_count_;
-        uint32_t element_type_index_;
+        uint64_t element_count_;
+        TypeRef element_type_;
     };
 
 
     class VectorType : public Type {
     public:
-        VectorType(uint32_t element_count, uint32_t element_type_index) :
-                Type(bitcode::TypeCodes::kArray),
-                element_count_(element_count), element_type_index_(element_type_index) {}
-        virtual ~VectorType() override = default;
+        VectorType(uint32_t element_count, TypeRef element_type) :
+                Type(bitcode::TypeCodes::kVector),
+                element_count_(element_count), element_type_(element_type) {}
+
+        uint32_t GetElementCount() const {
+            return element_count_;
+        }
+
+        TypeRef GetElementType() const {
+            return element_type_;
+        }
     public:
         static bool IsValidElementType(bitcode::TypeCodes type_code);
+        static TypeRef ObtainVectorType(BLVMContext& context, uint32_t element_count, TypeRef element_type);
     private:
         uint32_t element_count_;
-        uint32_t element_type_index_;
+        TypeRef element_type_;
     };
 
 
+    // Literal structs are uniqued by the context like every other composite type, named (identified)
+    // structs are distinct objects even when their bodies match. A named struct is opaque until
+    // SetBody(), which also lets the type block create it early for a forward reference.
     class StructType : public Type {
     public:
-        StructType(bool is_packed) :
-                Type(bitcode::TypeCodes::kStruct_ANON), is_packed_(is_packed) {}
-        StructType(bool is_packed, const std::string& struct_name) :
-                Type(bitcode::TypeCodes::kStruct_NAMED), is_packed_(is_packed), struct_name_(struct_name) {}
-        virtual ~StructType() override = default;
+        StructType(bool is_packed, TypeList members) :
+                Type(bitcode::TypeCodes::kStruct_ANON), is_packed_(is_packed), is_opaque_(false),
+                members_(members), member_offsets_(nullptr) {}
+        StructType(bool is_packed, base::InternedString struct_name) :
+                Type(bitcode::TypeCodes::kStruct_NAMED), is_packed_(is_packed), is_opaque_(true),
+                struct_name_(struct_name), member_offsets_(nullptr) {}
 
-        void FillMembers(const std::vector<uint32_t>& members) {
-            members_type_index_list_ = members;
+        bool IsPacked() const {
+            return is_packed_;
         }
 
-        void FillMembers(std::vector<uint32_t>&& members) {
-            members_type_index_list_ = std::move(members);
+        bool IsOpaque() const {
+            return is_opaque_;
         }
+
+        bool IsLiteral() const {
+            return GetTypeCode() == bitcode::TypeCodes::kStruct_ANON;
+        }
+
+        // Empty for literal structs. Interned by the context.
+        base::InternedString GetName() const {
+            return struct_name_;
+        }
+
+        TypeList GetMembers() const {
+            return members_;
+        }
+
+        // Byte offset of a member, valid once HasLayout().
+        uint64_t GetMemberOffset(size_t index) const {
+            return member_offsets_[index];
+        }
+
+        // Named structs only, the member list is copied into the context arena.
+        void SetName(BLVMContext& context, base::StringPiece name);
+        void SetBody(BLVMContext& context, bool is_packed, const std::vector<TypeRef>& members);
     public:
         static bool IsValidMemberType(bitcode::TypeCodes type_code);
+        static TypeRef ObtainLiteralStructType(BLVMContext& context, bool is_packed,
+                                               const std::vector<TypeRef>& members);
+        static StructType* CreateNamedStructType(BLVMContext& context, bool is_packed, base::StringPiece name);
     private:
         bool is_packed_;
-        std::string struct_name_;
-        std::vector<uint32_t> members_type_index_list_;
+        bool is_opaque_;
+        base::InternedString struct_name_;
+        TypeList members_;
+        const uint64_t* member_offsets_;
+
+        friend class BLVMContext;
     };
 
 
     class FunctionType : public Type {
     public:
-        FunctionType(bool is_vararg, uint32_t return_type_index, std::vector<uint32_t>&& type_index_list) :
+        FunctionType(bool is_vararg, TypeRef return_type, TypeList param_types) :
                 Type(bitcode::TypeCodes::kFunction), is_vararg_(is_vararg),
-                return_type_index_(return_type_index), param_type_index_list_(std::move(type_index_list)) {}
-        virtual ~FunctionType() override = default;
+                return_type_(return_type), param_types_(param_types) {}
+
+        bool IsVarArg() const {
+            return is_vararg_;
+        }
 
+        TypeRef GetReturnType() const {
+            return return_type_;
+        }
+
+        TypeList GetParamTypes() const {
+            return param_types_;
+        }
     public:
         static bool IsValidArgumentType(bitcode::TypeCodes type_code);
+        static TypeRef ObtainFunctionType(BLVMContext& context, bool is_vararg, TypeRef return_type,
+                                          const std::vector<TypeRef>& param_types);
     private:
         bool is_vararg_;
-        uint32_t return_type_index_;
-        std::vector<uint32_t> param_type_index_list_;
+        TypeRef return_type_;
+        TypeList param_types_;
     };
 
 }
@@ -7,9 +7,14 @@
 #include "bitcode/bitcode_llvm.hpp"
 #include "bitcode/bitcode_reader.hpp"
 #include "bitcode/bitcode_parser.hpp"
+#include "bitcode/bitcode_materializer.hpp"
+#include "bitcode/block_index.hpp"
+#include "bitcode/decode_stats.hpp"
 #include "bitcode/parsing_exception.hpp"
+#include "bitcode/snapshot_loader.hpp"
 #include "core/blvm_context.hpp"
 #include "core/module.hpp"
+#include "core/function.hpp"
 #include "base/logging.hpp"
 
 namespace blvm {
@@ -30,34 +35,55 @@ namespace blvm {
         int dummy_integer_ = 12450;
     };
 
-    int dummy_parse(const char* filename) {
+    // With decode_stats, every function body is decoded as well so that the statistics cover the whole file.
+    int dummy_parse(const char* filename, const char* snapshot_filename, const char* block_index_filename,
+                    bitcode::DecodeStats* decode_stats) {
         base::RefPtr<FooClass> pfoo = new FooClass;
 
-        FILE* input_file = fopen(filename, "rb");
-        DCHECK(input_file);
-
-        fseek(input_file, 0, SEEK_END);
-        size_t size = static_cast<size_t>(ftell(input_file));
-        fseek(input_file, 0, SEEK_SET);
-
-        base::MemoryBuffer buffer(base::MemoryBuffer::kAllocateInternally, size);
-        fread(const_cast<uint8_t*>(buffer.begin()), 1, size, input_file);
-
-        fclose(input_file);
-
         core::BLVMContext context;
-        bitcode::ParsingContext parsing_context(std::move(buffer));
         core::Module module;
 
-        bitcode::BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
-        bitcode::BitcodeParser parser(context, parsing_context, reader, module);
+        if (snapshot_filename) {
+            bool from_snapshot = false;
+            if (!bitcode::LoadModuleWithSnapshot(context, module, filename, snapshot_filename, &from_snapshot,
+                                                  block_index_filename))
+                return -1;
+            printf("loaded from: %s\n", from_snapshot ? snapshot_filename : filename);
+        } else {
+            base::MemoryBuffer buffer = base::MemoryBuffer::OpenFile(filename);
+            DCHECK(buffer.IsValid());
+            if (!buffer.IsValid())
+                return -1;
+
+            base::RefPtr<bitcode::BitcodeMaterializer> materializer =
+                    new bitcode::BitcodeMaterializer(context, module, std::move(buffer));
+            bitcode::ParsingContext& parsing_context = materializer->GetParsingContext();
+            if (block_index_filename)
+                parsing_context.SetBlockIndex(bitcode::BlockIndex::LoadOrBuild(parsing_context, block_index_filename));
+            parsing_context.SetDecodeStats(decode_stats);
+
+            {
+                bitcode::BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
+                bitcode::BitcodeParser parser(context, parsing_context, reader, module);
+
+                parser.Parse();
+            }
+            module.SetMaterializer(materializer);
+            if (decode_stats)
+                module.MaterializeAll();
+        }
 
-        parser.Parse();
+        size_t defined_count = 0;
+        for (auto& function : module.function_list) {
+            if (!function->IsDeclaration())
+                defined_count++;
+        }
 
         printf("module_version: %d\n", module.module_version);
         printf("datalayout: %s\n", module.target_datalayout.c_str());
         printf("target_triple: %s\n", module.target_triple.c_str());
-        printf("type_count: %d\n\n", (int)module.type_table.size());
+        printf("type_count: %d\n", (int)module.type_table.size());
+        printf("function_count: %d (%d defined)\n\n", (int)module.function_list.size(), (int)defined_count);
 
 
         return pfoo->Fuck(233);
@@ -0,0 +1,42 @@
+#include "dispatch_stats.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace blvm {
+namespace execution {
+
+    DispatchStats::DispatchStats() : pair_counts_(kOpcodeSlots * kOpcodeSlots, 0) {
+
+    }
+
+    uint64_t DispatchStats::GetDispatchCount() const {
+        uint64_t count = 0;
+        for (uint64_t pair_count : pair_counts_)
+            count += pair_count;
+        return count;
+    }
+
+    void DispatchStats::PrintPairs(FILE* out, size_t limit) const {
+        std::vector<std::pair<size_t, uint64_t>> pairs;
+        for (size_t i = 0; i < pair_counts_.size(); i++) {
+            if (pair_counts_[i] != 0)
+                pairs.push_back(std::make_pair(i, pair_counts_[i]));
+        }
+        std::stable_sort(pairs.begin(), pairs.end(),
+                         [](const std::pair<size_t, uint64_t>& lhs, const std::pair<size_t, uint64_t>& rhs) {
+                             return lhs.second > rhs.second;
+                         });
+
+        uint64_t total = GetDispatchCount();
+        fprintf(out, "%llu dispatches\n%-24s %-24s %14s %7s\n", (unsigned long long)total, "previous", "opcode",
+                "count", "%");
+        for (size_t i = 0; i < pairs.size() && i < limit; i++) {
+            core::Opcode previous = (core::Opcode)(pairs[i].first / kOpcodeSlots);
+            core::Opcode opcode = (core::Opcode)(pairs[i].first % kOpcodeSlots);
+            fprintf(out, "%-24s %-24s %14llu %7.2f\n", previous == core::Opcode::kCount ? "-" : GetOpcodeName(previous),
+                    GetOpcodeName(opcode), (unsigned long long)pairs[i].second, 100.0 * pairs[i].second / total);
+        }
+    }
+
+}
+}
@@ -0,0 +1,49 @@
+#ifndef _BLVM_EXECUTION_DISPATCH_STATS_HPP
+#define _BLVM_EXECUTION_DISPATCH_STATS_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "../base/noncopyable.hpp"
+#include "../core/instruction.hpp"
+
+// Build with -DBLVM_DISPATCH_STATS=1 (CMake option BLVM_DISPATCH_STATS) to count the opcodes the interpreter
+// dispatches. Otherwise the counting is compiled out of the dispatch loop and a DispatchStats stays empty.
+#ifndef BLVM_DISPATCH_STATS
+    #define BLVM_DISPATCH_STATS 0
+#endif
+
+namespace blvm {
+namespace execution {
+
+    // How often each opcode was dispatched right after each other one: the pairs worth a superinstruction
+    // (see core::FuseSuperinstructions). The first opcode of a run follows kCount.
+    class DispatchStats {
+    public:
+        DispatchStats();
+        ~DispatchStats() = default;
+
+        static constexpr bool IsEnabled() {
+            return BLVM_DISPATCH_STATS != 0;
+        }
+
+        void Count(core::Opcode previous, core::Opcode opcode) {
+            pair_counts_[(size_t)previous * kOpcodeSlots + (size_t)opcode]++;
+        }
+
+        uint64_t GetDispatchCount() const;
+
+        // The limit most frequent pairs, with their share of all dispatches.
+        void PrintPairs(FILE* out, size_t limit) const;
+    private:
+        static const size_t kOpcodeSlots = (size_t)core::Opcode::kCount + 1;
+
+        std::vector<uint64_t> pair_counts_;  // previous * kOpcodeSlots + opcode
+
+        DISALLOW_COPY_AND_ASSIGN(DispatchStats);
+    };
+
+}
+}
+
+#endif // _BLVM_EXECUTION_DISPATCH_STATS_HPP
@@ -0,0 +1,911 @@
+#include "interpreter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include "../bitcode/bitcode_llvm.hpp"
+#include "../core/function.hpp"
+#include "../core/function_body.hpp"
+#include "../core/module.hpp"
+
+namespace blvm {
+namespace execution {
+
+    using core::Instruction;
+    using core::Opcode;
+    using core::ValueType;
+    using bitcode::CmpPredicates;
+
+    namespace {
+
+        inline uint64_t GetMask(uint32_t width) {
+            return width >= 64 ? ~0ull : (1ull << width) - 1;
+        }
+
+        inline int64_t SignExtend(uint64_t value, uint32_t width) {
+            if (width >= 64)
+                return (int64_t)value;
+            uint64_t sign = 1ull << (width - 1);
+            return (int64_t)(((value & GetMask(width)) ^ sign) - sign);
+        }
+
+        inline float ToFloat(uint64_t bits) {
+            uint32_t low = (uint32_t)bits;
+            float value;
+            memcpy(&value, &low, sizeof(value));
+            return value;
+        }
+
+        inline uint64_t FromFloat(float value) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        inline double ToDouble(uint64_t bits) {
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        inline uint64_t FromDouble(double value) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        template <typename F>
+        F FromBits(uint64_t bits);
+
+        template <>
+        inline float FromBits<float>(uint64_t bits) {
+            return ToFloat(bits);
+        }
+
+        template <>
+        inline double FromBits<double>(uint64_t bits) {
+            return ToDouble(bits);
+        }
+
+        inline uint64_t ToBits(float value) {
+            return FromFloat(value);
+        }
+
+        inline uint64_t ToBits(double value) {
+            return FromDouble(value);
+        }
+
+        // Every float is exact as a double, so float operands can be widened where the operation allows it.
+        inline double ToFloatingPoint(ValueType type, uint64_t bits) {
+            return type == ValueType::kFloat ? ToFloat(bits) : ToDouble(bits);
+        }
+
+        bool CompareIntegers(uint8_t predicate, uint64_t lhs, uint64_t rhs, uint32_t width) {
+            switch (static_cast<CmpPredicates>(predicate)) {
+                case CmpPredicates::kICmpEQ:  return lhs == rhs;
+                case CmpPredicates::kICmpNE:  return lhs != rhs;
+                case CmpPredicates::kICmpUGT: return lhs > rhs;
+                case CmpPredicates::kICmpUGE: return lhs >= rhs;
+                case CmpPredicates::kICmpULT: return lhs < rhs;
+                case CmpPredicates::kICmpULE: return lhs <= rhs;
+                case CmpPredicates::kICmpSGT: return SignExtend(lhs, width) > SignExtend(rhs, width);
+                case CmpPredicates::kICmpSGE: return SignExtend(lhs, width) >= SignExtend(rhs, width);
+                case CmpPredicates::kICmpSLT: return SignExtend(lhs, width) < SignExtend(rhs, width);
+                case CmpPredicates::kICmpSLE: return SignExtend(lhs, width) <= SignExtend(rhs, width);
+                default:                      return false;
+            }
+        }
+
+        bool CompareFloatingPoint(uint8_t predicate, double lhs, double rhs) {
+            bool unordered = std::isnan(lhs) || std::isnan(rhs);
+            switch (static_cast<CmpPredicates>(predicate)) {
+                case CmpPredicates::kFCmpFalse: return false;
+                case CmpPredicates::kFCmpOEQ:   return !unordered && lhs == rhs;
+                case CmpPredicates::kFCmpOGT:   return !unordered && lhs > rhs;
+                case CmpPredicates::kFCmpOGE:   return !unordered && lhs >= rhs;
+                case CmpPredicates::kFCmpOLT:   return !unordered && lhs < rhs;
+                case CmpPredicates::kFCmpOLE:   return !unordered && lhs <= rhs;
+                case CmpPredicates::kFCmpONE:   return !unordered && lhs != rhs;
+                case CmpPredicates::kFCmpORD:   return !unordered;
+                case CmpPredicates::kFCmpUNO:   return unordered;
+                case CmpPredicates::kFCmpUEQ:   return unordered || lhs == rhs;
+                case CmpPredicates::kFCmpUGT:   return unordered || lhs > rhs;
+                case CmpPredicates::kFCmpUGE:   return unordered || lhs >= rhs;
+                case CmpPredicates::kFCmpULT:   return unordered || lhs < rhs;
+                case CmpPredicates::kFCmpULE:   return unordered || lhs <= rhs;
+                case CmpPredicates::kFCmpUNE:   return unordered || lhs != rhs;
+                default:                        return true;
+            }
+        }
+
+        // Out of range values and NaN give poison in LLVM, 0 here.
+        uint64_t ConvertToInteger(double value, bool is_signed, uint32_t width) {
+            if (std::isnan(value))
+                return 0;
+            value = std::trunc(value);
+            if (is_signed) {
+                double limit = std::ldexp(1.0, (int)width - 1);
+                if (value < -limit || value >= limit)
+                    return 0;
+                return (uint64_t)(int64_t)value & GetMask(width);
+            }
+            if (value < 0.0 || value >= std::ldexp(1.0, (int)width))
+                return 0;
+            return (uint64_t)value;
+        }
+
+        // ConvertToInteger() for a native integer type I. The bounds are exact doubles: the value converts if its
+        // integer part is in range.
+        template <typename F, typename I>
+        inline uint64_t ConvertToNativeInteger(uint64_t bits) {
+            typedef std::numeric_limits<I> Limits;
+            const double upper = std::ldexp(1.0, Limits::digits);
+            const double lower = !Limits::is_signed ? -1.0
+                                 : Limits::digits < 53 ? -upper - 1.0
+                                                       : -upper * (1.0 + std::numeric_limits<double>::epsilon());
+            double value = FromBits<F>(bits);
+            if (!(value > lower && value < upper))
+                return 0;
+            return (typename std::make_unsigned<I>::type)(I)value;
+        }
+
+        // Memory holds the store size of the type, little-endian like the host.
+        inline uint64_t LoadValue(const Instruction& instruction, const uint8_t* address) {
+            uint64_t value = 0;
+            switch (instruction.type) {
+                case ValueType::kI1:
+                    return *address & 1;
+                case ValueType::kI8:
+                    return *address;
+                case ValueType::kI16:
+                    memcpy(&value, address, 2);
+                    return value;
+                case ValueType::kI32:
+                case ValueType::kFloat:
+                    memcpy(&value, address, 4);
+                    return value;
+                case ValueType::kIntN:
+                    memcpy(&value, address, (instruction.width + 7) / 8);
+                    return value & GetMask(instruction.width);
+                default:
+                    memcpy(&value, address, 8);
+                    return value;
+            }
+        }
+
+        inline void StoreValue(const Instruction& instruction, uint8_t* address, uint64_t value) {
+            switch (instruction.type) {
+                case ValueType::kI1:
+                case ValueType::kI8:
+                    *address = (uint8_t)value;
+                    break;
+                case ValueType::kI16:
+                    memcpy(address, &value, 2);
+                    break;
+                case ValueType::kI32:
+                case ValueType::kFloat:
+                    memcpy(address, &value, 4);
+                    break;
+                case ValueType::kIntN:
+                    memcpy(address, &value, (instruction.width + 7) / 8);
+                    break;
+                default:
+                    memcpy(address, &value, 8);
+                    break;
+            }
+        }
+
+        inline uint8_t* AlignUp(uint8_t* address, uint64_t alignment) {
+            return reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(address) + alignment - 1) &
+                                              ~(uintptr_t)(alignment - 1));
+        }
+
+    }
+
+    Interpreter::Interpreter(core::Module& module, size_t stack_size)
+        : module_(module),
+          handlers_(nullptr),
+          dispatch_stats_(nullptr),
+          stack_(new uint64_t[(stack_size + 7) / 8]),
+          stack_size_((stack_size + 7) / 8 * 8) {
+        uint64_t unused;
+        Run(nullptr, unused);
+    }
+
+    Interpreter::~Interpreter() {
+
+    }
+
+    bool Interpreter::Execute(core::Function& function, const std::vector<uint64_t>& arguments,
+                              uint64_t* out_result) {
+        error_.clear();
+        core::FunctionBody* body = PrepareBody(function);
+        if (body == nullptr) {
+            error_ = "@" + function.GetName().ToString() + " has no body to execute";
+            return false;
+        }
+        if (arguments.size() != body->argument_count) {
+            error_ = "@" + function.GetName().ToString() + " takes " + std::to_string(body->argument_count) +
+                     " arguments";
+            return false;
+        }
+        if (body->registers.size() * sizeof(uint64_t) > stack_size_) {
+            error_ = "stack overflow";
+            return false;
+        }
+
+        uint64_t* registers = stack_.get();
+        std::copy(body->registers.begin(), body->registers.end(), registers);
+        std::copy(arguments.begin(), arguments.end(), registers);
+        frames_.clear();
+        uint64_t result = 0;
+        if (!Run(&function, result))
+            return false;
+        if (out_result != nullptr)
+            *out_result = result;
+        return true;
+    }
+
+    core::FunctionBody* Interpreter::PrepareBody(core::Function& function) {
+        if (!module_.MaterializeFunction(function))
+            return nullptr;
+        core::FunctionBody* body = function.GetBody();
+        if (body == nullptr || body->handler_table == handlers_)
+            return body;
+        for (Instruction& instruction : body->code)
+            instruction.handler = handlers_[(size_t)instruction.opcode];
+        body->handler_table = handlers_;
+        return body;
+    }
+
+    bool Interpreter::Run(core::Function* function, uint64_t& out_result) {
+    #if BLVM_THREADED_DISPATCH
+        #define BLVM_HANDLER_ADDRESS(name, text, generic) &&handler_##name,
+        static const void* const kHandlers[] = { BLVM_OPCODE_LIST(BLVM_HANDLER_ADDRESS) };
+        #undef BLVM_HANDLER_ADDRESS
+        #define BLVM_HANDLER(name) handler_##name:
+        #define BLVM_DISPATCH() do { BLVM_COUNT_DISPATCH(); goto *pc->handler; } while (0)
+    #else
+        // Nothing to thread, but PrepareBody() still marks bodies as prepared with it.
+        static const void* const kHandlers[(size_t)Opcode::kCount] = {};
+        #define BLVM_HANDLER(name) case Opcode::k##name:
+        #define BLVM_DISPATCH() goto dispatch
+    #endif
+    #if BLVM_DISPATCH_STATS
+        #define BLVM_COUNT_DISPATCH() \
+            do { \
+                if (dispatch_stats_ != nullptr) { \
+                    dispatch_stats_->Count(previous_opcode, pc->opcode); \
+                    previous_opcode = pc->opcode; \
+                } \
+            } while (0)
+    #else
+        #define BLVM_COUNT_DISPATCH() do {} while (0)
+    #endif
+        #define BLVM_NEXT() do { pc++; BLVM_DISPATCH(); } while (0)
+        #define BLVM_TRAP(message) do { error_ = message; goto trapped; } while (0)
+
+        if (function == nullptr) {
+            handlers_ = kHandlers;
+            return true;
+        }
+
+        // The state of the innermost call, saved in frames_ across calls.
+        const core::FunctionBody* body = function->GetBody();
+        const Instruction* code = body->code.data();
+        const Instruction* pc = code;
+        uint64_t* r = stack_.get();
+        uint8_t* sp = reinterpret_cast<uint8_t*>(r + body->registers.size());
+        uint8_t* const stack_end = reinterpret_cast<uint8_t*>(stack_.get()) + stack_size_;
+    #if BLVM_DISPATCH_STATS
+        Opcode previous_opcode = Opcode::kCount;
+    #endif
+
+    #if BLVM_THREADED_DISPATCH
+        BLVM_DISPATCH();
+    #else
+    dispatch:
+        BLVM_COUNT_DISPATCH();
+        switch (pc->opcode) {
+    #endif
+
+        BLVM_HANDLER(Add) {
+            r[pc->dest] = (r[pc->a] + r[pc->b]) & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Sub) {
+            r[pc->dest] = (r[pc->a] - r[pc->b]) & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Mul) {
+            r[pc->dest] = (r[pc->a] * r[pc->b]) & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(UDiv) {
+            if (r[pc->b] == 0)
+                BLVM_TRAP("division by zero");
+            r[pc->dest] = r[pc->a] / r[pc->b];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(SDiv) {
+            int64_t lhs = SignExtend(r[pc->a], pc->width);
+            int64_t rhs = SignExtend(r[pc->b], pc->width);
+            if (rhs == 0)
+                BLVM_TRAP("division by zero");
+            if (rhs == -1 && lhs == INT64_MIN)
+                BLVM_TRAP("division overflow");
+            r[pc->dest] = (uint64_t)(lhs / rhs) & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(URem) {
+            if (r[pc->b] == 0)
+                BLVM_TRAP("division by zero");
+            r[pc->dest] = r[pc->a] % r[pc->b];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(SRem) {
+            int64_t lhs = SignExtend(r[pc->a], pc->width);
+            int64_t rhs = SignExtend(r[pc->b], pc->width);
+            if (rhs == 0)
+                BLVM_TRAP("division by zero");
+            if (rhs == -1 && lhs == INT64_MIN)
+                BLVM_TRAP("division overflow");
+            r[pc->dest] = (uint64_t)(lhs % rhs) & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        // Shifting by the width or more gives poison in LLVM, 0 here.
+        BLVM_HANDLER(Shl) {
+            uint64_t amount = r[pc->b];
+            r[pc->dest] = amount < pc->width ? (r[pc->a] << amount) & GetMask(pc->width) : 0;
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(LShr) {
+            uint64_t amount = r[pc->b];
+            r[pc->dest] = amount < pc->width ? r[pc->a] >> amount : 0;
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(AShr) {
+            uint64_t amount = r[pc->b];
+            r[pc->dest] = amount < pc->width
+                              ? (uint64_t)(SignExtend(r[pc->a], pc->width) >> amount) & GetMask(pc->width)
+                              : 0;
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(And) {
+            r[pc->dest] = r[pc->a] & r[pc->b];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Or) {
+            r[pc->dest] = r[pc->a] | r[pc->b];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Xor) {
+            r[pc->dest] = r[pc->a] ^ r[pc->b];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FAdd) {
+            if (pc->type == ValueType::kFloat)
+                r[pc->dest] = FromFloat(ToFloat(r[pc->a]) + ToFloat(r[pc->b]));
+            else
+                r[pc->dest] = FromDouble(ToDouble(r[pc->a]) + ToDouble(r[pc->b]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FSub) {
+            if (pc->type == ValueType::kFloat)
+                r[pc->dest] = FromFloat(ToFloat(r[pc->a]) - ToFloat(r[pc->b]));
+            else
+                r[pc->dest] = FromDouble(ToDouble(r[pc->a]) - ToDouble(r[pc->b]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FMul) {
+            if (pc->type == ValueType::kFloat)
+                r[pc->dest] = FromFloat(ToFloat(r[pc->a]) * ToFloat(r[pc->b]));
+            else
+                r[pc->dest] = FromDouble(ToDouble(r[pc->a]) * ToDouble(r[pc->b]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FDiv) {
+            if (pc->type == ValueType::kFloat)
+                r[pc->dest] = FromFloat(ToFloat(r[pc->a]) / ToFloat(r[pc->b]));
+            else
+                r[pc->dest] = FromDouble(ToDouble(r[pc->a]) / ToDouble(r[pc->b]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FRem) {
+            if (pc->type == ValueType::kFloat)
+                r[pc->dest] = FromFloat(std::fmod(ToFloat(r[pc->a]), ToFloat(r[pc->b])));
+            else
+                r[pc->dest] = FromDouble(std::fmod(ToDouble(r[pc->a]), ToDouble(r[pc->b])));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FNeg) {
+            r[pc->dest] = r[pc->a] ^ (pc->type == ValueType::kFloat ? 1ull << 31 : 1ull << 63);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Trunc) {
+            r[pc->dest] = r[pc->a] & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(ZExt) {
+            r[pc->dest] = r[pc->a];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(SExt) {
+            r[pc->dest] = (uint64_t)SignExtend(r[pc->a], pc->b) & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FPToUI) {
+            r[pc->dest] = ConvertToInteger(ToFloatingPoint((ValueType)pc->aux, r[pc->a]), false, pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FPToSI) {
+            r[pc->dest] = ConvertToInteger(ToFloatingPoint((ValueType)pc->aux, r[pc->a]), true, pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(UIToFP) {
+            uint64_t value = r[pc->a];
+            r[pc->dest] = pc->type == ValueType::kFloat ? FromFloat((float)value) : FromDouble((double)value);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(SIToFP) {
+            int64_t value = SignExtend(r[pc->a], pc->b);
+            r[pc->dest] = pc->type == ValueType::kFloat ? FromFloat((float)value) : FromDouble((double)value);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FPTrunc) {
+            r[pc->dest] = FromFloat((float)ToDouble(r[pc->a]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FPExt) {
+            r[pc->dest] = FromDouble((double)ToFloat(r[pc->a]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(PtrToInt) {
+            r[pc->dest] = r[pc->a] & GetMask(pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(IntToPtr) {
+            r[pc->dest] = r[pc->a];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(ICmp) {
+            r[pc->dest] = CompareIntegers(pc->aux, r[pc->a], r[pc->b], pc->width);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FCmp) {
+            r[pc->dest] = CompareFloatingPoint(pc->aux, ToFloatingPoint(pc->type, r[pc->a]),
+                                               ToFloatingPoint(pc->type, r[pc->b]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Select) {
+            r[pc->dest] = (r[pc->a] & 1) ? r[pc->b] : r[pc->c];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Move) {
+            r[pc->dest] = r[pc->a];
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Alloca) {
+            uint8_t* address = AlignUp(sp, pc->c);
+            uint64_t count = r[pc->a];
+            if (address > stack_end || count > (uint64_t)(stack_end - address) / (pc->b == 0 ? 1 : pc->b))
+                BLVM_TRAP("stack overflow");
+            sp = address + count * pc->b;
+            r[pc->dest] = reinterpret_cast<uintptr_t>(address);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Load) {
+            r[pc->dest] = LoadValue(*pc, reinterpret_cast<const uint8_t*>(r[pc->a]));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Store) {
+            StoreValue(*pc, reinterpret_cast<uint8_t*>(r[pc->a]), r[pc->b]);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(PtrAdd) {
+            r[pc->dest] = r[pc->a] + (pc->b | (uint64_t)pc->c << 32);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(PtrAddScaled) {
+            r[pc->dest] = r[pc->a] + (uint64_t)SignExtend(r[pc->b], pc->width) * pc->c;
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Call) {
+            core::Function* callee = reinterpret_cast<core::Function*>(r[pc->a]);
+            const core::FunctionBody* callee_body = callee->GetBody();
+            if (callee_body == nullptr || callee_body->handler_table != handlers_) {
+                if (callee->IsNoOpIntrinsic())
+                    BLVM_NEXT();
+                callee_body = PrepareBody(*callee);
+                if (callee_body == nullptr)
+                    BLVM_TRAP("call to @" + callee->GetName().ToString() + ", which has no body to execute");
+            }
+            if (callee_body->argument_count != pc->c)
+                BLVM_TRAP("call to @" + callee->GetName().ToString() + " with the wrong number of arguments");
+            if (frames_.size() >= kMaxCallDepth)
+                BLVM_TRAP("call depth exceeded");
+
+            uint8_t* frame = AlignUp(sp, alignof(uint64_t));
+            size_t frame_size = callee_body->registers.size() * sizeof(uint64_t);
+            if (frame > stack_end || frame_size > (size_t)(stack_end - frame))
+                BLVM_TRAP("stack overflow");
+            uint64_t* callee_registers = reinterpret_cast<uint64_t*>(frame);
+            memcpy(callee_registers, callee_body->registers.data(), frame_size);
+            const uint32_t* arguments = body->call_arguments.data() + pc->b;
+            for (uint32_t i = 0; i < pc->c; i++)
+                callee_registers[i] = r[arguments[i]];
+
+            frames_.push_back({function, body, pc, r});
+            function = callee;
+            body = callee_body;
+            code = body->code.data();
+            pc = code;
+            r = callee_registers;
+            sp = frame + frame_size;
+            BLVM_DISPATCH();
+        }
+        BLVM_HANDLER(Ret) {
+            uint64_t value = pc->a == core::kNoRegister ? 0 : r[pc->a];
+            if (frames_.empty()) {
+                out_result = value;
+                return true;
+            }
+            sp = reinterpret_cast<uint8_t*>(r);
+            const Frame& caller = frames_.back();
+            function = caller.function;
+            body = caller.body;
+            code = body->code.data();
+            pc = caller.call;
+            r = caller.registers;
+            frames_.pop_back();
+            if (pc->dest != core::kNoRegister)
+                r[pc->dest] = value;
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(Br) {
+            pc = code + pc->a;
+            BLVM_DISPATCH();
+        }
+        BLVM_HANDLER(CondBr) {
+            pc = code + ((r[pc->a] & 1) ? pc->b : pc->c);
+            BLVM_DISPATCH();
+        }
+        BLVM_HANDLER(Switch) {
+            uint64_t value = r[pc->a];
+            const core::FunctionBody::SwitchCase* cases = body->switch_cases.data() + pc->b;
+            uint32_t target = cases[0].target;
+            for (uint32_t i = 1; i <= pc->c; i++) {
+                if (cases[i].value == value) {
+                    target = cases[i].target;
+                    break;
+                }
+            }
+            pc = code + target;
+            BLVM_DISPATCH();
+        }
+        BLVM_HANDLER(Unreachable) {
+            BLVM_TRAP("unreachable executed");
+        }
+
+        // The specialized handlers. T is the unsigned and S the signed type of an integer width, operands are
+        // zero-extended: truncating a result to T is all the masking there is.
+        #define BLVM_FOR_NATIVE_INTEGERS(HANDLER, name, ...) \
+            HANDLER(name##I8, uint8_t, int8_t, __VA_ARGS__) \
+            HANDLER(name##I16, uint16_t, int16_t, __VA_ARGS__) \
+            HANDLER(name##I32, uint32_t, int32_t, __VA_ARGS__) \
+            HANDLER(name##I64, uint64_t, int64_t, __VA_ARGS__)
+        #define BLVM_FOR_FLOATING_POINT(HANDLER, name, ...) \
+            HANDLER(name##F32, float, __VA_ARGS__) \
+            HANDLER(name##F64, double, __VA_ARGS__)
+
+        #define BLVM_INTEGER_OPERATION(name, T, S, op) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = (T)(r[pc->a] op r[pc->b]); \
+                BLVM_NEXT(); \
+            }
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_INTEGER_OPERATION, Add, +)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_INTEGER_OPERATION, Sub, -)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_INTEGER_OPERATION, Mul, *)
+        #undef BLVM_INTEGER_OPERATION
+
+        #define BLVM_UNSIGNED_DIVISION(name, T, S, op) \
+            BLVM_HANDLER(name) { \
+                T rhs = (T)r[pc->b]; \
+                if (rhs == 0) \
+                    BLVM_TRAP("division by zero"); \
+                r[pc->dest] = (T)((T)r[pc->a] op rhs); \
+                BLVM_NEXT(); \
+            }
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_UNSIGNED_DIVISION, UDiv, /)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_UNSIGNED_DIVISION, URem, %)
+        #undef BLVM_UNSIGNED_DIVISION
+
+        #define BLVM_SIGNED_DIVISION(name, T, S, op) \
+            BLVM_HANDLER(name) { \
+                S lhs = (S)r[pc->a]; \
+                S rhs = (S)r[pc->b]; \
+                if (rhs == 0) \
+                    BLVM_TRAP("division by zero"); \
+                if (rhs == -1 && lhs == std::numeric_limits<S>::min()) \
+                    BLVM_TRAP("division overflow"); \
+                r[pc->dest] = (T)(lhs op rhs); \
+                BLVM_NEXT(); \
+            }
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_SIGNED_DIVISION, SDiv, /)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_SIGNED_DIVISION, SRem, %)
+        #undef BLVM_SIGNED_DIVISION
+
+        // value is the operand as U, shifted by amount
+        #define BLVM_SHIFT(name, T, S, U, op) \
+            BLVM_HANDLER(name) { \
+                uint64_t amount = r[pc->b]; \
+                r[pc->dest] = amount < sizeof(T) * 8 ? (T)((U)r[pc->a] op amount) : 0; \
+                BLVM_NEXT(); \
+            }
+        #define BLVM_UNSIGNED_SHIFT(name, T, S, op) BLVM_SHIFT(name, T, S, T, op)
+        #define BLVM_SIGNED_SHIFT(name, T, S, op) BLVM_SHIFT(name, T, S, S, op)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_UNSIGNED_SHIFT, Shl, <<)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_UNSIGNED_SHIFT, LShr, >>)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_SIGNED_SHIFT, AShr, >>)
+        #undef BLVM_SIGNED_SHIFT
+        #undef BLVM_UNSIGNED_SHIFT
+        #undef BLVM_SHIFT
+
+        #define BLVM_FLOATING_POINT_OPERATION(name, F, op) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = ToBits(FromBits<F>(r[pc->a]) op FromBits<F>(r[pc->b])); \
+                BLVM_NEXT(); \
+            }
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_OPERATION, FAdd, +)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_OPERATION, FSub, -)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_OPERATION, FMul, *)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_OPERATION, FDiv, /)
+        #undef BLVM_FLOATING_POINT_OPERATION
+
+        BLVM_HANDLER(FRemF32) {
+            r[pc->dest] = ToBits(std::fmod(ToFloat(r[pc->a]), ToFloat(r[pc->b])));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FRemF64) {
+            r[pc->dest] = ToBits(std::fmod(ToDouble(r[pc->a]), ToDouble(r[pc->b])));
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FNegF32) {
+            r[pc->dest] = r[pc->a] ^ (1ull << 31);
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(FNegF64) {
+            r[pc->dest] = r[pc->a] ^ (1ull << 63);
+            BLVM_NEXT();
+        }
+
+        #define BLVM_TRUNC(name, T) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = (T)r[pc->a]; \
+                BLVM_NEXT(); \
+            }
+        BLVM_TRUNC(TruncI8, uint8_t)
+        BLVM_TRUNC(TruncI16, uint16_t)
+        BLVM_TRUNC(TruncI32, uint32_t)
+        #undef BLVM_TRUNC
+
+        // from the signed type S to the unsigned type T
+        #define BLVM_SEXT(name, S, T) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = (T)(S)r[pc->a]; \
+                BLVM_NEXT(); \
+            }
+        BLVM_SEXT(SExtI8I16, int8_t, uint16_t)
+        BLVM_SEXT(SExtI8I32, int8_t, uint32_t)
+        BLVM_SEXT(SExtI8I64, int8_t, uint64_t)
+        BLVM_SEXT(SExtI16I32, int16_t, uint32_t)
+        BLVM_SEXT(SExtI16I64, int16_t, uint64_t)
+        BLVM_SEXT(SExtI32I64, int32_t, uint64_t)
+        #undef BLVM_SEXT
+
+        #define BLVM_FLOATING_POINT_TO_INTEGER(name, F, I) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = ConvertToNativeInteger<F, I>(r[pc->a]); \
+                BLVM_NEXT(); \
+            }
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToUIF32I32, float, uint32_t)
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToUIF32I64, float, uint64_t)
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToUIF64I32, double, uint32_t)
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToUIF64I64, double, uint64_t)
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToSIF32I32, float, int32_t)
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToSIF32I64, float, int64_t)
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToSIF64I32, double, int32_t)
+        BLVM_FLOATING_POINT_TO_INTEGER(FPToSIF64I64, double, int64_t)
+        #undef BLVM_FLOATING_POINT_TO_INTEGER
+
+        #define BLVM_INTEGER_TO_FLOATING_POINT(name, I, F) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = ToBits((F)(I)r[pc->a]); \
+                BLVM_NEXT(); \
+            }
+        BLVM_INTEGER_TO_FLOATING_POINT(UIToFPI32F32, uint32_t, float)
+        BLVM_INTEGER_TO_FLOATING_POINT(UIToFPI32F64, uint32_t, double)
+        BLVM_INTEGER_TO_FLOATING_POINT(UIToFPI64F32, uint64_t, float)
+        BLVM_INTEGER_TO_FLOATING_POINT(UIToFPI64F64, uint64_t, double)
+        BLVM_INTEGER_TO_FLOATING_POINT(SIToFPI32F32, int32_t, float)
+        BLVM_INTEGER_TO_FLOATING_POINT(SIToFPI32F64, int32_t, double)
+        BLVM_INTEGER_TO_FLOATING_POINT(SIToFPI64F32, int64_t, float)
+        BLVM_INTEGER_TO_FLOATING_POINT(SIToFPI64F64, int64_t, double)
+        #undef BLVM_INTEGER_TO_FLOATING_POINT
+
+        #define BLVM_UNSIGNED_COMPARISON(name, op) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = r[pc->a] op r[pc->b]; \
+                BLVM_NEXT(); \
+            }
+        BLVM_UNSIGNED_COMPARISON(ICmpEq, ==)
+        BLVM_UNSIGNED_COMPARISON(ICmpNe, !=)
+        BLVM_UNSIGNED_COMPARISON(ICmpUgt, >)
+        BLVM_UNSIGNED_COMPARISON(ICmpUge, >=)
+        BLVM_UNSIGNED_COMPARISON(ICmpUlt, <)
+        BLVM_UNSIGNED_COMPARISON(ICmpUle, <=)
+        #undef BLVM_UNSIGNED_COMPARISON
+
+        #define BLVM_SIGNED_COMPARISON(name, T, S, op) \
+            BLVM_HANDLER(name) { \
+                r[pc->dest] = (S)r[pc->a] op (S)r[pc->b]; \
+                BLVM_NEXT(); \
+            }
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_SIGNED_COMPARISON, ICmpSgt, >)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_SIGNED_COMPARISON, ICmpSge, >=)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_SIGNED_COMPARISON, ICmpSlt, <)
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_SIGNED_COMPARISON, ICmpSle, <=)
+        #undef BLVM_SIGNED_COMPARISON
+
+        // C++ comparisons are the ordered ones, false if an operand is NaN. Unordered is the negation of the
+        // opposite ordered comparison.
+        #define BLVM_FLOATING_POINT_COMPARISON(name, F, expression) \
+            BLVM_HANDLER(name) { \
+                F lhs = FromBits<F>(r[pc->a]); \
+                F rhs = FromBits<F>(r[pc->b]); \
+                r[pc->dest] = (expression); \
+                BLVM_NEXT(); \
+            }
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpOeq, lhs == rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpOgt, lhs > rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpOge, lhs >= rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpOlt, lhs < rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpOle, lhs <= rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpOne, lhs < rhs || lhs > rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpOrd, lhs == lhs && rhs == rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpUno, lhs != lhs || rhs != rhs)
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpUeq, !(lhs < rhs || lhs > rhs))
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpUgt, !(lhs <= rhs))
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpUge, !(lhs < rhs))
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpUlt, !(lhs >= rhs))
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpUle, !(lhs > rhs))
+        BLVM_FOR_FLOATING_POINT(BLVM_FLOATING_POINT_COMPARISON, FCmpUne, lhs != rhs)
+        #undef BLVM_FLOATING_POINT_COMPARISON
+
+        #define BLVM_LOAD(name, T, S, unused) \
+            BLVM_HANDLER(name) { \
+                T value; \
+                memcpy(&value, reinterpret_cast<const void*>(r[pc->a]), sizeof(value)); \
+                r[pc->dest] = value; \
+                BLVM_NEXT(); \
+            }
+        #define BLVM_STORE(name, T, S, unused) \
+            BLVM_HANDLER(name) { \
+                T value = (T)r[pc->b]; \
+                memcpy(reinterpret_cast<void*>(r[pc->a]), &value, sizeof(value)); \
+                BLVM_NEXT(); \
+            }
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_LOAD, Load, )
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_STORE, Store, )
+        #undef BLVM_STORE
+        #undef BLVM_LOAD
+
+        BLVM_HANDLER(PtrAddScaledI32) {
+            r[pc->dest] = r[pc->a] + (uint64_t)(int64_t)(int32_t)r[pc->b] * pc->c;
+            BLVM_NEXT();
+        }
+        BLVM_HANDLER(PtrAddScaledI64) {
+            r[pc->dest] = r[pc->a] + r[pc->b] * pc->c;
+            BLVM_NEXT();
+        }
+
+
+        // Superinstructions: pc[1] and pc[2] are the rest of the sequence, whose work they do in order.
+        #define BLVM_COMPARE_BRANCH(name, T, op) \
+            BLVM_HANDLER(name) { \
+                bool condition = (T)r[pc->a] op (T)r[pc->b]; \
+                r[pc->dest] = condition; \
+                pc = code + (condition ? pc[1].b : pc[1].c); \
+                BLVM_DISPATCH(); \
+            }
+        BLVM_COMPARE_BRANCH(ICmpEqCondBr, uint64_t, ==)
+        BLVM_COMPARE_BRANCH(ICmpNeCondBr, uint64_t, !=)
+        BLVM_COMPARE_BRANCH(ICmpUgtCondBr, uint64_t, >)
+        BLVM_COMPARE_BRANCH(ICmpUgeCondBr, uint64_t, >=)
+        BLVM_COMPARE_BRANCH(ICmpUltCondBr, uint64_t, <)
+        BLVM_COMPARE_BRANCH(ICmpUleCondBr, uint64_t, <=)
+        BLVM_COMPARE_BRANCH(ICmpSgtI32CondBr, int32_t, >)
+        BLVM_COMPARE_BRANCH(ICmpSgtI64CondBr, int64_t, >)
+        BLVM_COMPARE_BRANCH(ICmpSgeI32CondBr, int32_t, >=)
+        BLVM_COMPARE_BRANCH(ICmpSgeI64CondBr, int64_t, >=)
+        BLVM_COMPARE_BRANCH(ICmpSltI32CondBr, int32_t, <)
+        BLVM_COMPARE_BRANCH(ICmpSltI64CondBr, int64_t, <)
+        BLVM_COMPARE_BRANCH(ICmpSleI32CondBr, int32_t, <=)
+        BLVM_COMPARE_BRANCH(ICmpSleI64CondBr, int64_t, <=)
+        #undef BLVM_COMPARE_BRANCH
+
+        #define BLVM_ADDRESS_LOAD(name, T, S, unused) \
+            BLVM_HANDLER(name) { \
+                uint64_t address = r[pc->a] + r[pc->b] * pc->c; \
+                r[pc->dest] = address; \
+                T value; \
+                memcpy(&value, reinterpret_cast<const void*>(address), sizeof(value)); \
+                r[pc[1].dest] = value; \
+                pc += 2; \
+                BLVM_DISPATCH(); \
+            }
+        #define BLVM_ADDRESS_STORE(name, T, S, unused) \
+            BLVM_HANDLER(name) { \
+                uint64_t address = r[pc->a] + r[pc->b] * pc->c; \
+                r[pc->dest] = address; \
+                T value = (T)r[pc[1].b]; \
+                memcpy(reinterpret_cast<void*>(address), &value, sizeof(value)); \
+                pc += 2; \
+                BLVM_DISPATCH(); \
+            }
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_ADDRESS_LOAD, PtrAddScaledI64Load, )
+        BLVM_FOR_NATIVE_INTEGERS(BLVM_ADDRESS_STORE, PtrAddScaledI64Store, )
+        #undef BLVM_ADDRESS_STORE
+        #undef BLVM_ADDRESS_LOAD
+
+        #define BLVM_LOAD_ADD_STORE(name, T) \
+            BLVM_HANDLER(name) { \
+                void* address = reinterpret_cast<void*>(r[pc->a]); \
+                T value; \
+                memcpy(&value, address, sizeof(value)); \
+                r[pc->dest] = value; \
+                value = (T)(r[pc[1].a] + r[pc[1].b]); \
+                r[pc[1].dest] = value; \
+                memcpy(address, &value, sizeof(value)); \
+                pc += 3; \
+                BLVM_DISPATCH(); \
+            }
+        BLVM_LOAD_ADD_STORE(LoadAddStoreI32, uint32_t)
+        BLVM_LOAD_ADD_STORE(LoadAddStoreI64, uint64_t)
+        #undef BLVM_LOAD_ADD_STORE
+
+        BLVM_HANDLER(MoveBr) {
+            r[pc->dest] = r[pc->a];
+            pc = code + pc[1].a;
+            BLVM_DISPATCH();
+        }
+        BLVM_HANDLER(MoveMove) {
+            r[pc->dest] = r[pc->a];
+            r[pc[1].dest] = r[pc[1].a];
+            pc += 2;
+            BLVM_DISPATCH();
+        }
+
+        #undef BLVM_FOR_FLOATING_POINT
+        #undef BLVM_FOR_NATIVE_INTEGERS
+
+    #if !BLVM_THREADED_DISPATCH
+            default:
+                BLVM_TRAP("invalid opcode");
+        }
+    #endif
+
+    trapped:
+        error_ += " in @" + function->GetName().ToString();
+        return false;
+
+        #undef BLVM_HANDLER
+        #undef BLVM_DISPATCH
+        #undef BLVM_COUNT_DISPATCH
+        #undef BLVM_NEXT
+        #undef BLVM_TRAP
+    }
+
+}
+}
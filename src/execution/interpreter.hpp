@@ -0,0 +1,87 @@
+#ifndef _BLVM_EXECUTION_INTERPRETER_HPP
+#define _BLVM_EXECUTION_INTERPRETER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../base/noncopyable.hpp"
+#include "../core/core_fwd.hpp"
+#include "../core/instruction.hpp"
+#include "dispatch_stats.hpp"
+
+// Computed goto (a GCC and Clang extension) lets every handler jump straight to the next one, through the address
+// baked into the instruction. Build with -DBLVM_THREADED_DISPATCH=0 (CMake option BLVM_SWITCH_DISPATCH) for the
+// portable loop around a switch.
+#ifndef BLVM_THREADED_DISPATCH
+    #if defined(__GNUC__) || defined(__clang__)
+        #define BLVM_THREADED_DISPATCH 1
+    #else
+        #define BLVM_THREADED_DISPATCH 0
+    #endif
+#endif
+
+namespace blvm {
+namespace execution {
+
+    // Runs lowered function bodies (core::FunctionBody). Values are passed in register form: integers
+    // zero-extended to 64 bits, a float in the low 32 bits, pointers as host addresses.
+    //
+    // Calls do not recurse on the host stack: the register files and allocas of all active calls live on one
+    // interpreter stack, and the dispatch loop keeps running across calls and returns. Memory accesses are not
+    // checked, the program is trusted like native code.
+    //
+    // Not thread safe: bodies are threaded (handler addresses written into their code) on first call.
+    class Interpreter {
+    public:
+        static const size_t kDefaultStackSize = 8 << 20;
+        static const size_t kMaxCallDepth = 1 << 16;
+
+        explicit Interpreter(core::Module& module, size_t stack_size = kDefaultStackSize);
+        ~Interpreter();
+
+        // Runs function to completion, materializing bodies as they are called. Returns false if the program
+        // traps (unreachable, division by zero, stack overflow, a call to a function without a lowered body),
+        // see GetError(). A void function returns 0.
+        bool Execute(core::Function& function, const std::vector<uint64_t>& arguments, uint64_t* out_result);
+
+        const std::string& GetError() const {
+            return error_;
+        }
+
+        // Counts the opcodes dispatched from now on, if collection is compiled in. stats has to outlive the
+        // interpreter or be reset to nullptr.
+        void SetDispatchStats(DispatchStats* stats) {
+            dispatch_stats_ = stats;
+        }
+    private:
+        struct Frame {
+            core::Function* function;
+            const core::FunctionBody* body;
+            const core::Instruction* call;  // resumed after the callee returns
+            uint64_t* registers;
+        };
+
+        // The lowered body of function with this interpreter's handlers, nullptr if it has none.
+        core::FunctionBody* PrepareBody(core::Function& function);
+
+        // The dispatch loop, from the first instruction of function, whose frame is at the bottom of the stack.
+        // Without a function, only fills in handlers_.
+        bool Run(core::Function* function, uint64_t& out_result);
+    private:
+        core::Module& module_;
+        const void* const* handlers_;  // by core::Opcode
+        DispatchStats* dispatch_stats_;
+        std::unique_ptr<uint64_t[]> stack_;
+        size_t stack_size_;            // in bytes
+        std::vector<Frame> frames_;
+        std::string error_;
+
+        DISALLOW_COPY_AND_ASSIGN(Interpreter);
+    };
+
+}
+}
+
+#endif // _BLVM_EXECUTION_INTERPRETER_HPP
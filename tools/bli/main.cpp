@@ -1,11 +1,434 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../../src/base/thread_pool.hpp"
+#include "../../src/base/memory_buffer.hpp"
+#include "../../src/base/stream_input.hpp"
+#include "../../src/bitcode/bitcode_materializer.hpp"
+#include "../../src/bitcode/bitcode_parser.hpp"
+#include "../../src/bitcode/bitcode_reader.hpp"
+#include "../../src/bitcode/block_index.hpp"
+#include "../../src/bitcode/decode_stats.hpp"
+#include "../../src/bitcode/module_summary.hpp"
+#include "../../src/bitcode/parsing_context.hpp"
+#include "../../src/bitcode/parsing_exception.hpp"
+#include "../../src/bitcode/snapshot_loader.hpp"
+#include "../../src/bitcode/stream_loader.hpp"
+#include "../../src/bitcode/symbol_table.hpp"
+#include "../../src/core/blvm_context.hpp"
+#include "../../src/core/function.hpp"
+#include "../../src/core/function_body.hpp"
+#include "../../src/core/module.hpp"
+#include "../../src/core/type.hpp"
+#include "../../src/execution/interpreter.hpp"
 
 namespace blvm {
-    extern int dummy_parse(const char* filename);
+    extern int dummy_parse(const char* filename, const char* snapshot_filename, const char* block_index_filename,
+                           bitcode::DecodeStats* decode_stats);
+}
+
+namespace {
+
+    void PrintUsage() {
+        printf("usage: bli [--snapshot] [--block-index] [--stats | --stats-json] [file.bc]\n"
+               "       bli --stream [--stats | --stats-json] file.bc|-\n"
+               "       bli --summary [--threads N] file.bc...\n"
+               "       bli --symbols file.bc...\n"
+               "       bli --dump [--snapshot] [--block-index] file.bc|-\n"
+               "       bli --run [--snapshot] [--block-index] [--entry NAME] [--pairs] file.bc|- [args...]\n"
+               "  --snapshot  load through <file.bc>.snapshot, rebuilt whenever file.bc changes\n"
+               "  --block-index  seek to blocks by <file.bc>.blkidx, rebuilt whenever file.bc changes\n"
+               "  --stats     decode every function too and print per-block statistics, --stats-json as JSON\n"
+               "              (needs a build with BLVM_DECODE_STATS)\n"
+               "  --stream    read the file (- for stdin) as a pipe, decoding everything in one pass\n"
+               "  --summary   print triple, datalayout and functions of every file, without decoding IR\n"
+               "  --threads   files scanned in parallel, default: one per hardware thread\n"
+               "  --symbols   print the defined symbols of every file from its symbol table, nm style\n"
+               "  --dump      print the lowered instructions of every defined function\n"
+               "  --run       interpret NAME (default: main) and print what it returns. main(i32, ptr) gets\n"
+               "              argc and argv, other entry points one number per parameter\n"
+               "  --pairs     print the opcode pairs executed most often (needs a build with BLVM_DISPATCH_STATS)\n");
+    }
+
+    // T: code, D: data, W: weak. Files without a SYMTAB are reported, not parsed.
+    int RunSymbols(const std::vector<const char*>& filenames) {
+        using blvm::bitcode::IRSymbol;
+
+        int failures = 0;
+        for (const char* filename : filenames) {
+            blvm::base::MemoryBuffer buffer = blvm::base::MemoryBuffer::OpenFile(filename);
+            if (!buffer.IsValid()) {
+                printf("%s: error\n", filename);
+                failures++;
+                continue;
+            }
+
+            blvm::bitcode::ParsingContext parsing_context(std::move(buffer));
+            blvm::bitcode::SymbolTable symbol_table;
+            bool found = false;
+            try {
+                blvm::bitcode::BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
+                found = blvm::bitcode::ReadSymbolTable(parsing_context, reader, symbol_table);
+            } catch (blvm::bitcode::ReaderException&) {
+            } catch (blvm::bitcode::ParserException&) {
+            }
+            if (!found) {
+                printf("%s: no symbol table\n", filename);
+                failures++;
+                continue;
+            }
+
+            printf("%s:\n", filename);
+            for (const IRSymbol& symbol : symbol_table.GetSymbols()) {
+                if (symbol.IsUndefined())
+                    continue;
+                char kind = (symbol.flags & IRSymbol::kWeak) ? 'W' : symbol.IsExecutable() ? 'T' : 'D';
+                printf("%c %.*s\n", kind, (int)symbol.name.size(), symbol.name.data());
+            }
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    // The module is complete when the stream ends, peak is the most input held in memory at once.
+    int RunStream(const char* filename, blvm::bitcode::DecodeStats* decode_stats) {
+        std::unique_ptr<blvm::base::StreamInput> stream;
+        if (strcmp(filename, "-") == 0)
+            stream.reset(new blvm::base::StreamInput(0, false));
+        else
+            stream = blvm::base::StreamInput::OpenFile(filename);
+        if (!stream) {
+            printf("%s: error\n", filename);
+            return 1;
+        }
+
+        blvm::core::BLVMContext context;
+        blvm::core::Module module;
+        if (!blvm::bitcode::LoadModuleFromStream(context, module, *stream, decode_stats)) {
+            printf("%s: error\n", filename);
+            return 1;
+        }
+
+        size_t defined_count = 0;
+        size_t instruction_count = 0;
+        for (auto& function : module.function_list) {
+            if (function->IsDeclaration())
+                continue;
+            defined_count++;
+            instruction_count += function->GetInstructionCount();
+        }
+        printf("module_version: %d\n", module.module_version);
+        printf("target_triple: %s\n", module.target_triple.c_str());
+        printf("function_count: %d (%d defined, %zu instructions)\n", (int)module.function_list.size(),
+               (int)defined_count, instruction_count);
+        printf("peak input memory: %zu KB\n", stream->GetPeakResidentSize() / 1024);
+        return 0;
+    }
+
+    // With every body materialized unless lazily, through the snapshot and block index files that are not null.
+    // Standard input is decoded in one pass, which lowers the bodies before the STRTAB gives the callees their
+    // names, and has neither.
+    bool LoadModule(blvm::core::BLVMContext& context, blvm::core::Module& module, const char* filename,
+                    const char* snapshot_filename, const char* block_index_filename, bool lazily = false) {
+        if (strcmp(filename, "-") == 0) {
+            blvm::base::StreamInput stream(0, false);
+            return blvm::bitcode::LoadModuleFromStream(context, module, stream, nullptr);
+        }
+        if (snapshot_filename) {
+            if (!blvm::bitcode::LoadModuleWithSnapshot(context, module, filename, snapshot_filename, nullptr,
+                                                       block_index_filename))
+                return false;
+            return lazily || module.MaterializeAll();
+        }
+
+        blvm::base::MemoryBuffer buffer = blvm::base::MemoryBuffer::OpenFile(filename);
+        if (!buffer.IsValid())
+            return false;
+        blvm::base::RefPtr<blvm::bitcode::BitcodeMaterializer> materializer =
+                new blvm::bitcode::BitcodeMaterializer(context, module, std::move(buffer));
+        blvm::bitcode::ParsingContext& parsing_context = materializer->GetParsingContext();
+        if (block_index_filename) {
+            parsing_context.SetBlockIndex(
+                    blvm::bitcode::BlockIndex::LoadOrBuild(parsing_context, block_index_filename));
+        }
+        try {
+            blvm::bitcode::BitcodeReader reader(parsing_context, *parsing_context.GetBitcodeBuffer());
+            blvm::bitcode::BitcodeParser parser(context, parsing_context, reader, module);
+            parser.Parse();
+        } catch (blvm::bitcode::ReaderException&) {
+            return false;
+        } catch (blvm::bitcode::ParserException&) {
+            return false;
+        }
+        module.SetMaterializer(materializer);
+        return lazily || module.MaterializeAll();
+    }
+
+    // Functions the lowering does not cover are listed without a body.
+    int RunDump(const char* filename, const char* snapshot_filename, const char* block_index_filename) {
+        blvm::core::BLVMContext context;
+        blvm::core::Module module;
+        if (!LoadModule(context, module, filename, snapshot_filename, block_index_filename)) {
+            printf("%s: error\n", filename);
+            return 1;
+        }
+
+        for (auto& function : module.function_list) {
+            if (function->IsDeclaration())
+                continue;
+            blvm::base::StringPiece name = function->GetName();
+            printf("define @%.*s\n", (int)name.size(), name.data());
+            if (function->GetBody())
+                function->GetBody()->Dump(stdout);
+            else
+                printf("  ; not lowered\n");
+        }
+        return 0;
+    }
+
+    // Integer results are printed signed.
+    int RunProgram(const char* filename, const char* snapshot_filename, const char* block_index_filename,
+                   const char* entry_name, const std::vector<const char*>& arguments, bool print_pairs) {
+        using blvm::core::RegisterType;
+        using blvm::core::ValueType;
+
+        blvm::core::BLVMContext context;
+        blvm::core::Module module;
+        if (!LoadModule(context, module, filename, snapshot_filename, block_index_filename, true)) {
+            printf("%s: error\n", filename);
+            return 1;
+        }
+
+        blvm::base::StringPiece name(entry_name, strlen(entry_name));
+        blvm::core::Function* entry = nullptr;
+        for (auto& function : module.function_list) {
+            if (!function->IsDeclaration() && function->GetName() == name)
+                entry = function.Get();
+        }
+        if (entry == nullptr) {
+            printf("%s: no function @%s\n", filename, entry_name);
+            return 1;
+        }
+
+        auto function_type = static_cast<const blvm::core::FunctionType*>(entry->GetFunctionType());
+        blvm::core::TypeList param_types = function_type->GetParamTypes();
+        std::vector<RegisterType> types(param_types.size());
+        for (size_t i = 0; i < param_types.size(); i++) {
+            if (!blvm::core::GetRegisterType(param_types[i], types[i])) {
+                printf("@%s: unsupported parameter type\n", entry_name);
+                return 1;
+            }
+        }
+
+        std::vector<uint64_t> values;
+        std::vector<const char*> argv;
+        if (strcmp(entry_name, "main") == 0 && types.size() == 2 && types[0].type == ValueType::kI32 &&
+            types[1].type == ValueType::kPointer) {
+            argv.push_back(filename);
+            argv.insert(argv.end(), arguments.begin(), arguments.end());
+            values.push_back(argv.size());
+            argv.push_back(nullptr);
+            values.push_back(reinterpret_cast<uintptr_t>(argv.data()));
+        } else {
+            if (arguments.size() != types.size()) {
+                printf("@%s takes %zu arguments\n", entry_name, types.size());
+                return 1;
+            }
+            for (size_t i = 0; i < types.size(); i++) {
+                const RegisterType& type = types[i];
+                uint64_t value = 0;
+                if (type.type == ValueType::kFloat) {
+                    float number = strtof(arguments[i], nullptr);
+                    uint32_t bits;
+                    memcpy(&bits, &number, sizeof(bits));
+                    value = bits;
+                } else if (type.type == ValueType::kDouble) {
+                    double number = strtod(arguments[i], nullptr);
+                    memcpy(&value, &number, sizeof(value));
+                } else if (type.IsInteger()) {
+                    value = (uint64_t)strtoll(arguments[i], nullptr, 0);
+                    if (type.width < 64)
+                        value &= (1ull << type.width) - 1;
+                } else {
+                    printf("@%s: unsupported parameter type\n", entry_name);
+                    return 1;
+                }
+                values.push_back(value);
+            }
+        }
+
+        blvm::execution::Interpreter interpreter(module);
+        blvm::execution::DispatchStats dispatch_stats;
+        if (print_pairs)
+            interpreter.SetDispatchStats(&dispatch_stats);
+        uint64_t result = 0;
+        bool succeeded = interpreter.Execute(*entry, values, &result);
+        if (print_pairs) {
+            if (!blvm::execution::DispatchStats::IsEnabled())
+                printf("dispatch statistics are compiled out, configure with -DBLVM_DISPATCH_STATS=ON\n");
+            else
+                dispatch_stats.PrintPairs(stdout, 40);
+        }
+        if (!succeeded) {
+            printf("error: %s\n", interpreter.GetError().c_str());
+            return 1;
+        }
+
+        RegisterType return_type;
+        if (!blvm::core::GetRegisterType(function_type->GetReturnType(), return_type) ||
+            return_type.type == ValueType::kVoid)
+            return 0;
+        if (return_type.type == ValueType::kFloat) {
+            uint32_t bits = (uint32_t)result;
+            float number;
+            memcpy(&number, &bits, sizeof(number));
+            printf("ret = %g\n", number);
+        } else if (return_type.type == ValueType::kDouble) {
+            double number;
+            memcpy(&number, &result, sizeof(number));
+            printf("ret = %g\n", number);
+        } else if (return_type.type == ValueType::kPointer) {
+            printf("ret = 0x%llx\n", (unsigned long long)result);
+        } else {
+            int64_t number = (int64_t)result;
+            if (return_type.width < 64 && (result >> (return_type.width - 1)) != 0)
+                number = (int64_t)(result | ~((1ull << return_type.width) - 1));
+            printf("ret = %lld\n", (long long)number);
+        }
+        return 0;
+    }
+
+    int RunSummaries(const std::vector<const char*>& filenames, size_t thread_count) {
+        using blvm::bitcode::ModuleSummary;
+
+        std::vector<ModuleSummary> summaries(filenames.size());
+        std::vector<uint8_t> succeeded(filenames.size(), 0);
+        auto scan = [&](size_t, size_t index) {
+            succeeded[index] = blvm::bitcode::ScanModuleSummary(filenames[index], summaries[index]);
+        };
+
+        if (thread_count == 1 || filenames.size() == 1) {
+            for (size_t i = 0; i < filenames.size(); i++)
+                scan(0, i);
+        } else {
+            blvm::base::ThreadPool pool(thread_count);
+            pool.ParallelFor(filenames.size(), scan);
+        }
+
+        int failures = 0;
+        for (size_t i = 0; i < filenames.size(); i++) {
+            if (!succeeded[i]) {
+                printf("%s: error\n", filenames[i]);
+                failures++;
+                continue;
+            }
+
+            const ModuleSummary& summary = summaries[i];
+            printf("%s: version %d, triple \"%s\", datalayout \"%s\", %zu functions\n", filenames[i],
+                   summary.module_version, summary.target_triple.c_str(), summary.target_datalayout.c_str(),
+                   summary.functions.size());
+            for (const std::string& name : summary.section_names)
+                printf("  section %s\n", name.c_str());
+            for (const std::string& name : summary.gc_names)
+                printf("  gc %s\n", name.c_str());
+            for (const blvm::bitcode::FunctionSummary& function : summary.functions) {
+                printf("  %s linkage=%d %s\n", function.is_declaration ? "declare" : "define ",
+                       (int)function.linkage, function.name.c_str());
+            }
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
 }
 
 int main(int argc, char** argv) {
-    int ret = blvm::dummy_parse("test.bc");
-    printf("Hello world! ret = %d\n", ret);
-    return 0;
-}
\ No newline at end of file
+    const char* filename = "test.bc";
+    bool use_snapshot = false;
+    bool use_block_index = false;
+    bool summary_mode = false;
+    bool symbols_mode = false;
+    bool stream_mode = false;
+    bool dump_mode = false;
+    bool run_mode = false;
+    bool print_pairs = false;
+    const char* entry_name = "main";
+    const char* stats_format = nullptr;
+    size_t thread_count = 0;
+    std::vector<const char*> filenames;
+    std::vector<const char*> program_arguments;
+
+    for (int i = 1; i < argc; i++) {
+        if (run_mode && !filenames.empty()) {
+            program_arguments.push_back(argv[i]);
+        } else if (strcmp(argv[i], "--snapshot") == 0) {
+            use_snapshot = true;
+        } else if (strcmp(argv[i], "--block-index") == 0) {
+            use_block_index = true;
+        } else if (strcmp(argv[i], "--summary") == 0) {
+            summary_mode = true;
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats-json") == 0) {
+            stats_format = argv[i];
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream_mode = true;
+        } else if (strcmp(argv[i], "-") == 0) {
+            filenames.push_back(argv[i]);
+        } else if (strcmp(argv[i], "--dump") == 0) {
+            dump_mode = true;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run_mode = true;
+        } else if (strcmp(argv[i], "--pairs") == 0) {
+            print_pairs = true;
+        } else if (strcmp(argv[i], "--entry") == 0 && i + 1 < argc) {
+            entry_name = argv[++i];
+        } else if (strcmp(argv[i], "--symbols") == 0) {
+            symbols_mode = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = (size_t)strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] == '-') {
+            PrintUsage();
+            return 1;
+        } else {
+            filenames.push_back(argv[i]);
+        }
+    }
+
+    if (summary_mode || symbols_mode) {
+        if (filenames.empty()) {
+            PrintUsage();
+            return 1;
+        }
+        return summary_mode ? RunSummaries(filenames, thread_count) : RunSymbols(filenames);
+    }
+
+    if (!filenames.empty())
+        filename = filenames.back();
+    std::string snapshot_filename = std::string(filename) + ".snapshot";
+    std::string block_index_filename = std::string(filename) + ".blkidx";
+    const char* snapshot = use_snapshot ? snapshot_filename.c_str() : nullptr;
+    const char* block_index = use_block_index ? block_index_filename.c_str() : nullptr;
+    if (dump_mode)
+        return RunDump(filename, snapshot, block_index);
+    if (run_mode)
+        return RunProgram(filename, snapshot, block_index, entry_name, program_arguments, print_pairs);
+    blvm::bitcode::DecodeStats decode_stats;
+    int exit_code = 0;
+    if (stream_mode) {
+        exit_code = RunStream(filename, stats_format ? &decode_stats : nullptr);
+    } else {
+        int ret = blvm::dummy_parse(filename, snapshot, block_index, stats_format ? &decode_stats : nullptr);
+        printf("Hello world! ret = %d\n", ret);
+    }
+
+    if (stats_format) {
+        if (!blvm::bitcode::DecodeStats::IsEnabled())
+            printf("decode statistics are compiled out, configure with -DBLVM_DECODE_STATS=ON\n");
+        else if (strcmp(stats_format, "--stats-json") == 0)
+            decode_stats.PrintJson(stdout);
+        else
+            decode_stats.PrintTable(stdout);
+    }
+    return exit_code;
+}